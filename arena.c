@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <string.h>
+#include "utilities.h"
+#include "arena.h"
+
+// A chunk of memory from malloc, whose data follows its header
+struct arena_chunk_s {
+    struct arena_chunk_s *next;
+    size_t size;  // bytes of data
+    max_align_t data[];
+};
+
+// The alignment of all allocations
+#define ARENA_ALIGN (sizeof(max_align_t))
+
+// Initialize a as an empty arena; poisoning is on if the environment
+// variable PL0_ARENA_DEBUG is set
+void arena_init(arena *a)
+{
+    a->chunks = NULL;
+    a->next = NULL;
+    a->end = NULL;
+    a->poison = getenv("PL0_ARENA_DEBUG") != NULL;
+    memset(&a->stats, 0, sizeof(arena_stats));
+}
+
+// Set whether releasing a poisons its memory
+void arena_set_poison(arena *a, bool poison)
+{
+    a->poison = poison;
+}
+
+// Get a new chunk with at least size bytes of data for a
+// and make it the current chunk
+static void new_chunk(arena *a, size_t size)
+{
+    if (size < ARENA_CHUNK_SIZE) {
+	size = ARENA_CHUNK_SIZE;
+    }
+    arena_chunk *c = (arena_chunk *) malloc(sizeof(arena_chunk) + size);
+    if (c == NULL) {
+	bail_with_error("Cannot allocate a chunk of %zu bytes for an arena!",
+			size);
+    }
+    c->size = size;
+    c->next = a->chunks;
+    a->chunks = c;
+    a->next = (char *) c->data;
+    a->end = a->next + size;
+    a->stats.chunks++;
+    a->stats.reserved += size;
+    if (a->stats.reserved > a->stats.peak) {
+	a->stats.peak = a->stats.reserved;
+    }
+}
+
+// Return a pointer to size bytes from a, suitably aligned for any type
+void *arena_alloc(arena *a, size_t size)
+{
+    size_t rounded = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (rounded < size) {
+	bail_with_error("Cannot allocate %zu bytes in an arena!", size);
+    }
+    if (a->next == NULL || rounded > (size_t) (a->end - a->next)) {
+	new_chunk(a, rounded);
+    }
+    void *ret = a->next;
+    a->next += rounded;
+    a->stats.allocations++;
+    a->stats.bytes += size;
+    return ret;
+}
+
+// Return a copy of the string s allocated in a
+char *arena_strdup(arena *a, const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *ret = (char *) arena_alloc(a, len);
+    memcpy(ret, s, len);
+    return ret;
+}
+
+// Free all the memory allocated in a, leaving it empty
+void arena_release(arena *a)
+{
+    arena_chunk *c = a->chunks;
+    while (c != NULL) {
+	arena_chunk *next = c->next;
+	if (a->poison) {
+	    memset(c->data, ARENA_POISON_BYTE, c->size);
+	}
+	free(c);
+	c = next;
+    }
+    a->chunks = NULL;
+    a->next = NULL;
+    a->end = NULL;
+    a->stats.chunks = 0;
+    a->stats.reserved = 0;
+    a->stats.releases++;
+}
+
+// Return the statistics of a
+arena_stats arena_get_stats(const arena *a)
+{
+    return a->stats;
+}
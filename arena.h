@@ -0,0 +1,68 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+#include <stdbool.h>
+#include <stddef.h>
+
+// An arena is a region allocator: it hands out memory by bumping
+// a pointer through large chunks obtained from malloc, and frees
+// all of it at once when it is released. The ASTs of a compilation
+// unit are allocated in an arena (see ast_arena in ast.h), as
+// they are all built while parsing and all die together.
+
+// The size of the chunks an arena gets from malloc
+// (a larger request gets a chunk of its own)
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+// The byte that a debugging arena fills released memory with
+#define ARENA_POISON_BYTE 0xDD
+
+// The statistics of an arena, since it was initialized
+typedef struct {
+    size_t allocations;  // number of allocations
+    size_t bytes;        // bytes requested by allocations
+    size_t chunks;       // number of chunks now held
+    size_t reserved;     // bytes in the chunks now held
+    size_t peak;         // the most bytes ever held in chunks
+    size_t releases;     // number of releases
+} arena_stats;
+
+typedef struct arena_chunk_s arena_chunk;
+
+typedef struct {
+    arena_chunk *chunks;  // the chunks held, the current one first
+    char *next;           // where the next allocation can start
+    char *end;            // the end of the current chunk
+    bool poison;          // fill released memory with ARENA_POISON_BYTE?
+    arena_stats stats;
+} arena;
+
+// Requires: a != NULL
+// Initialize a as an empty arena (which allocates nothing from malloc
+// until it is first used); poisoning is on if the environment variable
+// PL0_ARENA_DEBUG is set
+extern void arena_init(arena *a);
+
+// Requires: a != NULL
+// Set whether releasing a fills its memory with ARENA_POISON_BYTE
+// before freeing it, so that uses of the released memory show up
+extern void arena_set_poison(arena *a, bool poison);
+
+// Requires: a != NULL
+// Return a pointer to size bytes from a, suitably aligned for any type;
+// the memory lasts until a is released
+extern void *arena_alloc(arena *a, size_t size);
+
+// Requires: a != NULL and s != NULL
+// Return a copy of the string s allocated in a
+extern char *arena_strdup(arena *a, const char *s);
+
+// Requires: a != NULL
+// Free all the memory allocated in a (poisoning it first if a is a
+// debugging arena), leaving a empty and ready for reuse
+extern void arena_release(arena *a);
+
+// Requires: a != NULL
+// Return the statistics of a
+extern arena_stats arena_get_stats(const arena *a);
+
+#endif
@@ -5,49 +5,68 @@
 #include "ast.h"
 #include "lexer.h"
 
+// The arena of the current compilation unit, in which all ASTs
+// (and their file locations and names) are allocated
+static arena unit_arena;
+static bool unit_arena_ready = false;
+
+// Return the arena in which ASTs are allocated
+arena *ast_arena()
+{
+    if (!unit_arena_ready) {
+	arena_init(&unit_arena);
+	unit_arena_ready = true;
+    }
+    return &unit_arena;
+}
+
+// Free all the ASTs of the current compilation unit at once
+void ast_release_unit()
+{
+    arena_release(ast_arena());
+}
+
 // macros used below
 
 #define ALLOCATE_AND_INIT_FIELD_PTR(TYPE, VALUE, FIELD) \
     { \
-	TYPE *p = (TYPE *) malloc(sizeof(TYPE));	\
-        if (p == NULL) {   \
-	    bail_with_error("Unable to allocate space for a %s!", "TYPE"); \
-	}							       \
+	TYPE *p = (TYPE *) arena_alloc(ast_arena(), sizeof(TYPE)); \
         *p = VALUE; \
 	ret.FIELD = p; \
     }
 
 
+// Append a fresh copy of VALUE to the list OBJECT, making ret that list;
+// its last field makes this take constant time, as the parser appends
+// each element of a list in turn
 #define ALLOCATE_AND_SPLICE_IN(TYPE, VALUE, FIELD, OBJECT) \
     { \
-	TYPE *p = (TYPE *) malloc(sizeof(TYPE)); \
-	if (p == NULL) {   \
-	    bail_with_error("Cannot allocate space for %s!", "TYPE"); \
-	}  \
+	TYPE *p = (TYPE *) arena_alloc(ast_arena(), sizeof(TYPE)); \
 	*p = VALUE; \
-	OBJECT.FIELD = p; \
-        TYPE *last = ast_last_list_elem(OBJECT.FIELD); \
-	if (last == NULL) {	\
-	    ret.FIELD = p;	\
-	} else {		\
-	    last->next = p;	\
+	p->next = NULL; \
+	if (OBJECT.last == NULL) { \
+	    ret.FIELD = p; \
+	} else { \
+	    ret.FIELD = OBJECT.FIELD; \
+	    OBJECT.last->next = p; \
 	} \
+	ret.last = p; \
     }
 
 
 // Return the file location from an AST
-file_location *ast_file_loc(AST t){
+file_location ast_file_loc(AST t){
     return t.generic.file_loc;
 }
 
 // Return the filename from the AST t
 const char *ast_filename(AST t){
-    return ast_file_loc(t)->filename;
+    return file_location_filename(ast_file_loc(t));
 }
 
 // Return the line number from the AST t
 unsigned int ast_line(AST t) {
-    return ast_file_loc(t)->line;
+    return ast_file_loc(t).line;
 }
 
 // Return the type tag of the AST t
@@ -56,16 +75,25 @@ AST_type ast_type_tag(AST t){
 }
 
 // Return a pointer to a fresh copy of t
-// that has been allocated on the heap
+// that has been allocated in the AST arena
 AST *ast_heap_copy(AST t){
-    AST *ret = (AST *)malloc(sizeof(AST));
-    if (ret == NULL) {
-	bail_with_error("Cannot allocate an AST heap copy!");
-    }
+    AST *ret = (AST *) arena_alloc(ast_arena(), sizeof(AST));
     *ret = t;
     return ret;
 }
 
+// Define ast_M_value for each member M of AST (of type T), which
+// returns a pointer to a copy of t allocated in the AST arena
+#define AST_DEFINE_VALUE(T, M) \
+    T *ast_##M##_value(T t) \
+    { \
+	T *ret = (T *) arena_alloc(ast_arena(), sizeof(T)); \
+	*ret = t; \
+	return ret; \
+    }
+
+AST_MEMBERS(AST_DEFINE_VALUE)
+
 // Return an AST for a block which contains the given ASTs.
 block_t ast_block(const_decls_t const_decls, var_decls_t var_decls, proc_decls_t proc_decls, stmt_t stmt){
     block_t ret;
@@ -83,6 +111,8 @@ extern const_decls_t ast_const_decls_empty(empty_t empty){
     const_decls_t ret;
     ret.file_loc = empty.file_loc;
     ret.type_tag = const_decls_ast;
+    ret.const_decls = NULL;
+    ret.last = NULL;
     return ret;
 }
 
@@ -118,6 +148,7 @@ extern const_defs_t ast_const_defs_singleton(const_def_t const_def)
     ret.file_loc = const_def.file_loc;
     ret.type_tag = const_defs_ast;
     ALLOCATE_AND_INIT_FIELD_PTR(const_def_t, const_def, const_defs);
+    ret.last = ret.const_defs;
     return ret;
 }
 
@@ -128,7 +159,7 @@ extern const_defs_t ast_const_defs(const_defs_t const_defs,
     const_defs_t ret;
     ret.file_loc = const_defs.file_loc;
     ret.type_tag = const_defs_ast;
-    ALLOCATE_AND_SPLICE_IN(const_def_t, const_def, const_defs, ret);
+    ALLOCATE_AND_SPLICE_IN(const_def_t, const_def, const_defs, const_defs);
     return ret;
 }
 
@@ -136,7 +167,7 @@ extern const_defs_t ast_const_defs(const_defs_t const_defs,
 const_def_t ast_const_def(ident_t ident, number_t number)
 {
     const_def_t ret;
-    ret.file_loc = file_location_copy(ident.file_loc);
+    ret.file_loc = ident.file_loc;
     ret.type_tag = const_def_ast;
     ret.next = NULL;
     ret.ident = ident;
@@ -152,6 +183,7 @@ var_decls_t ast_var_decls_empty(empty_t empty)
     ret.file_loc = empty.file_loc;
     ret.type_tag = var_decls_ast;
     ret.var_decls = NULL;
+    ret.last = NULL;
     return ret;
 }
 
@@ -161,7 +193,7 @@ var_decls_t ast_var_decls(var_decls_t var_decls, var_decl_t var_decl)
     var_decls_t ret;
     ret.file_loc = var_decls.file_loc;
     ret.type_tag = var_decls_ast;
-    ALLOCATE_AND_SPLICE_IN(var_decl_t, var_decl, var_decls, ret);
+    ALLOCATE_AND_SPLICE_IN(var_decl_t, var_decl, var_decls, var_decls);
     return ret;
 }
 
@@ -184,6 +216,7 @@ extern idents_t ast_idents_singleton(ident_t ident)
     ret.file_loc = ident.file_loc;
     ret.type_tag = idents_ast;
     ALLOCATE_AND_INIT_FIELD_PTR(ident_t, ident, idents);
+    ret.last = ret.idents;
     return ret;
 }
 
@@ -191,8 +224,9 @@ extern idents_t ast_idents_singleton(ident_t ident)
 extern idents_t ast_idents(idents_t idents, ident_t ident)
 {
     idents_t ret;
-    ret.file_loc = ident.file_loc;
+    ret.file_loc = idents.file_loc;
     ret.type_tag = idents_ast;
+    ALLOCATE_AND_SPLICE_IN(ident_t, ident, idents, idents);
     return ret;
 }
 
@@ -203,6 +237,7 @@ proc_decls_t ast_proc_decls_empty(empty_t empty)
     ret.file_loc = empty.file_loc;
     ret.type_tag = proc_decls_ast;
     ret.proc_decls = NULL;
+    ret.last = NULL;
     return ret;
 }
 
@@ -213,7 +248,7 @@ proc_decls_t ast_proc_decls(proc_decls_t proc_decls,
     proc_decls_t ret;
     ret.file_loc = proc_decls.file_loc;
     ret.type_tag = proc_decls_ast;
-    ALLOCATE_AND_INIT_FIELD_PTR(proc_decl_t, proc_decl, proc_decls);
+    ALLOCATE_AND_SPLICE_IN(proc_decl_t, proc_decl, proc_decls, proc_decls);
     return ret;
 }
 
@@ -221,7 +256,7 @@ proc_decls_t ast_proc_decls(proc_decls_t proc_decls,
 proc_decl_t ast_proc_decl(ident_t ident, block_t block)
 {
     proc_decl_t ret;
-    ret.file_loc = file_location_copy(ident.file_loc);
+    ret.file_loc = ident.file_loc;
     ret.type_tag = proc_decl_ast;
     ret.next = NULL;
     ret.name = ident.name;
@@ -230,7 +265,7 @@ proc_decl_t ast_proc_decl(ident_t ident, block_t block)
 }
 
 // Return an AST for a skip statement
-skip_stmt_t ast_skip_stmt(file_location *file_loc) {
+skip_stmt_t ast_skip_stmt(file_location file_loc) {
     skip_stmt_t ret;
     ret.file_loc = file_loc;
     ret.type_tag = skip_stmt_ast;
@@ -241,6 +276,7 @@ skip_stmt_t ast_skip_stmt(file_location *file_loc) {
 write_stmt_t ast_write_stmt(expr_t expr) {
     write_stmt_t ret;
     ret.file_loc = expr.file_loc;
+    ret.type_tag = write_stmt_ast;
     ret.expr = expr;
     return ret;
 }
@@ -248,7 +284,7 @@ write_stmt_t ast_write_stmt(expr_t expr) {
 // Return an AST for a read statement
 read_stmt_t ast_read_stmt(ident_t ident) {
     read_stmt_t ret;
-    ret.file_loc = file_location_copy(ident.file_loc);
+    ret.file_loc = ident.file_loc;
     ret.type_tag = read_stmt_ast;
     ret.name = ident.name;
     return ret;
@@ -293,7 +329,7 @@ begin_stmt_t ast_begin_stmt(stmts_t stmts)
  call_stmt_t ast_call_stmt(ident_t ident)
 {
     call_stmt_t ret;
-    ret.file_loc = file_location_copy(ident.file_loc);
+    ret.file_loc = ident.file_loc;
     ret.type_tag = call_stmt_ast;
     ret.name = ident.name;
     return ret;
@@ -303,7 +339,7 @@ begin_stmt_t ast_begin_stmt(stmts_t stmts)
 assign_stmt_t ast_assign_stmt(ident_t ident, expr_t expr)
 {
     assign_stmt_t ret;
-    ret.file_loc = file_location_copy(ident.file_loc);
+    ret.file_loc = ident.file_loc;
     ret.type_tag = assign_stmt_ast;
     ret.name = ident.name;
     ALLOCATE_AND_INIT_FIELD_PTR(expr_t, expr, expr);
@@ -316,6 +352,7 @@ stmts_t ast_stmts_singleton(stmt_t stmt) {
     ret.file_loc = stmt.file_loc;
     ret.type_tag = stmts_ast;
     ALLOCATE_AND_INIT_FIELD_PTR(stmt_t, stmt, stmts);
+    ret.last = ret.stmts;
     return ret;
 }
 
@@ -324,13 +361,7 @@ stmts_t ast_stmts(stmts_t stmts, stmt_t stmt) {
     stmts_t ret;
     ret.file_loc = stmts.file_loc;
     ret.type_tag = stmts_ast;
-    ret.stmts = stmts.stmts;
-    stmt_t *s = (stmt_t *) malloc(sizeof(stmt_t));
-    if (s == NULL) {
-	bail_with_error("Cannot allocate space for %s!", "stmt_t");
-    }
-    stmt_t *last = ast_last_list_elem(ret.stmts);
-    last->next = s;
+    ALLOCATE_AND_SPLICE_IN(stmt_t, stmt, stmts, stmts);
     return ret;
 }
 
@@ -425,6 +456,8 @@ stmt_t ast_stmt_skip(skip_stmt_t s)
     ret.file_loc = s.file_loc;
     ret.type_tag = stmt_ast;
     ret.next = NULL;
+    ret.stmt_kind = skip_stmt;
+    ret.stmt.skip_stmt = s;
     return ret;
 }
 
@@ -504,7 +537,7 @@ expr_t ast_expr_binary_op(binary_op_expr_t e)
 expr_t ast_expr_negated_number(token_t sign, number_t number)
 {
     expr_t ret;
-    ret.file_loc = file_location_copy(sign.file_loc);
+    ret.file_loc = sign.file_loc;
     ret.type_tag = expr_ast;
     ret.expr_kind = expr_number;
     ret.expr.number = number;
@@ -517,7 +550,7 @@ expr_t ast_expr_negated_number(token_t sign, number_t number)
 expr_t ast_expr_pos_number(token_t sign, number_t number)
 {
     expr_t ret;
-    ret.file_loc = file_location_copy(sign.file_loc);
+    ret.file_loc = sign.file_loc;
     ret.type_tag = expr_ast;
     ret.expr_kind = expr_number;
     ret.expr.number = number;
@@ -525,7 +558,7 @@ expr_t ast_expr_pos_number(token_t sign, number_t number)
 }
 
 // Return an AST for the given token
-token_t ast_token(file_location *file_loc, const char *text, int code)
+token_t ast_token(file_location file_loc, const char *text, int code)
 {
     token_t ret;
     ret.file_loc = file_loc;
@@ -539,18 +572,19 @@ token_t ast_token(file_location *file_loc, const char *text, int code)
 number_t ast_number(token_t sgn, word_type value)
 {
     number_t ret;
-    ret.file_loc = file_location_copy(sgn.file_loc);
+    ret.file_loc = sgn.file_loc;
     ret.type_tag = number_ast;
     ret.value = value;
     return ret;
 }
 
 // Return an AST for an identifier
-ident_t ast_ident(file_location *file_loc, const char *name)
+ident_t ast_ident(file_location file_loc, const char *name)
 {
     ident_t ret;
     ret.file_loc = file_loc;
     ret.type_tag = ident_ast;
+    ret.next = NULL;
     ret.name = name;
     return ret;
 }
@@ -589,7 +623,7 @@ expr_t ast_expr_number(number_t e)
 }
 
 // Return an AST for empty found in the given file location
-empty_t ast_empty(file_location *file_loc)
+empty_t ast_empty(file_location file_loc)
 {
     empty_t ret;
     ret.file_loc = file_loc;
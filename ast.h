@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include "machine_types.h"
 #include "file_location.h"
+#include "arena.h"
 
 // types of ASTs (type tags)
 typedef enum {
@@ -24,20 +25,20 @@ typedef enum {
 // The generic struct type (generic_t) has the fields that
 // should be in all alternatives for ASTs.
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag; // says what field of the union is active
     void *next; // for lists
 } generic_t;
 
 // empty ::=
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
 } empty_t;
 
 // label ::= ident
 typedef struct ident_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct ident_s *next; // for lists
     const char *name;
@@ -45,7 +46,7 @@ typedef struct ident_s {
 
 // (possibly signed) numbers
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *text;
     word_type value;
@@ -53,7 +54,7 @@ typedef struct {
 
 // tokens as ASTs
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *text;
     int code;
@@ -68,7 +69,7 @@ struct expr_s;
 // expr ::= expr arithOp expr
 // arithOp ::= + | - | * | /
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct expr_s *expr1;
     token_t arith_op;
@@ -77,7 +78,7 @@ typedef struct {
     
 // expr ::= expr arithOp expr | ident | number
 typedef struct expr_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     expr_kind_e expr_kind;
     union {
@@ -91,13 +92,13 @@ typedef struct expr_s {
 typedef enum { ck_odd, ck_rel } condition_kind_e;
 
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     expr_t expr;
 } odd_condition_t;
 
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     expr_t expr1;
     token_t rel_op;
@@ -106,7 +107,7 @@ typedef struct {
 
 // condition ::= odd expr | expr relOp expr
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     condition_kind_e cond_kind;
     union {
@@ -124,14 +125,15 @@ struct stmt_s;
 
 // stmts ::= { stmt }
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct stmt_s *stmts;
+    struct stmt_s *last; // the last element, for appends
 } stmts_t;
 
 // stmt ::= ident := expr
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *name;
     struct expr_s *expr;
@@ -139,21 +141,21 @@ typedef struct {
 
 // stmt ::= call ident
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *name;
 } call_stmt_t;
 
 // stmt ::= begin { stmt } end
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     stmts_t stmts;
 } begin_stmt_t;
 
 // stmt ::= if condition then stmt else stmt
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     condition_t condition;
     struct stmt_s *then_stmt;
@@ -162,7 +164,7 @@ typedef struct {
 
 // stmt ::= whhile condition stmt
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     condition_t condition;
     struct stmt_s *body;
@@ -170,28 +172,28 @@ typedef struct {
 
 // stmt ::= read ident
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const char *name;
 } read_stmt_t;
 
 // stmt ::= write expr
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     expr_t expr;
 } write_stmt_t;
 
 // stmt ::= skip
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
 } skip_stmt_t;
 
 // stmt ::= assignStmt | callStmt | beginStmt | ifStmt
 //        | whileStmt | readStmt | writeStmt | skip
 typedef struct stmt_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct stmt_s *next; // for lists
     stmt_kind_e stmt_kind;
@@ -212,7 +214,7 @@ struct block_s;
 
 // procDecl ::= procedure ident block
 typedef struct proc_decl_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct proc_decl_s *next; // for lists
     const char *name;
@@ -221,21 +223,23 @@ typedef struct proc_decl_s {
 
 // proc-decls ::= { proc-decl }
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     proc_decl_t *proc_decls;
+    proc_decl_t *last; // the last element, for appends
 } proc_decls_t;
 
 // idents ::= { ident }
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     ident_t *idents;
+    ident_t *last; // the last element, for appends
 } idents_t;
 
 // var-decl ::= var idents
 typedef struct var_decl_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct var_decl_s *next; // for lists
     idents_t idents;
@@ -243,14 +247,15 @@ typedef struct var_decl_s {
 
 // var-decls ::= { var-decl }
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     var_decl_t *var_decls;
+    var_decl_t *last; // the last element, for appends
 } var_decls_t;
 
 // constDef ::= ident = number
 typedef struct const_def_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct const_def_s *next; // for lists
     ident_t ident;
@@ -259,14 +264,15 @@ typedef struct const_def_s {
 
 // const-defs ::= const-def | const-defs , const-def
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const_def_t *const_defs;
+    const_def_t *last; // the last element, for appends
 } const_defs_t;
 
 // const-decl ::= const const-defs
 typedef struct const_decl_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     struct const_decl_s *next; // for lists
     const_defs_t const_defs;
@@ -274,14 +280,15 @@ typedef struct const_decl_s {
 
 // const-decls ::= { const-decl }
 typedef struct {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const_decl_t *const_decls;
+    const_decl_t *last; // the last element, for appends
 } const_decls_t;
 
 // block ::= const-decls var-decls proc-decls stmt
 typedef struct block_s {
-    file_location *file_loc;
+    file_location file_loc;
     AST_type type_tag;
     const_decls_t const_decls;
     var_decls_t var_decls;
@@ -291,42 +298,48 @@ typedef struct block_s {
 
 // program ::= block
 
-// The AST definition used by the parser generator (bison)
+// The members of AST, each as X(its type, its name)
+#define AST_MEMBERS(X) \
+    X(generic_t, generic) \
+    X(block_t, block) \
+    X(const_decls_t, const_decls) \
+    X(const_decl_t, const_decl) \
+    X(const_defs_t, const_defs) \
+    X(const_def_t, const_def) \
+    X(var_decls_t, var_decls) \
+    X(var_decl_t, var_decl) \
+    X(idents_t, idents) \
+    X(proc_decls_t, proc_decls) \
+    X(proc_decl_t, proc_decl) \
+    X(stmt_t, stmt) \
+    X(assign_stmt_t, assign_stmt) \
+    X(call_stmt_t, call_stmt) \
+    X(begin_stmt_t, begin_stmt) \
+    X(if_stmt_t, if_stmt) \
+    X(while_stmt_t, while_stmt) \
+    X(read_stmt_t, read_stmt) \
+    X(write_stmt_t, write_stmt) \
+    X(skip_stmt_t, skip_stmt) \
+    X(stmts_t, stmts) \
+    X(condition_t, condition) \
+    X(rel_op_condition_t, rel_op_condition) \
+    X(odd_condition_t, odd_condition) \
+    X(expr_t, expr) \
+    X(binary_op_expr_t, binary_op_expr) \
+    X(token_t, token) \
+    X(number_t, number) \
+    X(ident_t, ident) \
+    X(empty_t, empty)
+
+// The AST definition used by the parser generator (bison),
+// with a member for each of AST_MEMBERS
+#define AST_MEMBER(T, M) T M;
 typedef union AST_u {
-    generic_t generic;
-    block_t block;
-    const_decls_t const_decls;
-    const_decl_t const_decl;
-    const_defs_t const_defs;
-    const_def_t const_def;
-    var_decls_t var_decls;
-    var_decl_t var_decl;
-    idents_t idents;
-    proc_decls_t proc_decls;
-    proc_decl_t proc_decl;
-    stmt_t stmt;
-    assign_stmt_t assign_stmt;
-    call_stmt_t call_stmt;
-    begin_stmt_t begin_stmt;
-    if_stmt_t if_stmt;
-    while_stmt_t while_stmt;
-    read_stmt_t read_stmt;
-    write_stmt_t write_stmt;
-    skip_stmt_t skip_stmt;
-    stmts_t stmts;
-    condition_t condition;
-    rel_op_condition_t rel_op_condition;
-    odd_condition_t odd_condition;
-    expr_t expr;
-    binary_op_expr_t binary_op_expr;
-    token_t token;
-    number_t number;
-    ident_t ident;
-    empty_t empty;
+    AST_MEMBERS(AST_MEMBER)
 } AST;
 
 // Return the file location from an AST
-extern file_location *ast_file_loc(AST t);
+extern file_location ast_file_loc(AST t);
 
 // Return the filename from the AST t
 extern const char *ast_filename(AST t);
@@ -338,9 +351,26 @@ extern unsigned int ast_line(AST t);
 extern AST_type ast_type_tag(AST t);
 
 // Return a pointer to a fresh copy of t
-// that has been allocated on the heap
+// that has been allocated in the AST arena
 extern AST *ast_heap_copy(AST t);
 
+// For each member M of AST, of type T, the function
+//     T *ast_M_value(T t)
+// returns a pointer to a copy of t allocated in the AST arena
+// (for parse values, see AST_VALUE in parser_types.h)
+#define AST_DECLARE_VALUE(T, M) extern T *ast_##M##_value(T t);
+AST_MEMBERS(AST_DECLARE_VALUE)
+
+// Return the arena of the current compilation unit, in which every
+// AST constructor (and the lexer, for token values) allocates;
+// its statistics are given by arena_get_stats
+extern arena *ast_arena();
+
+// Free all the ASTs of the current compilation unit at once, with
+// their file locations and names (which must no longer be used);
+// the arena is then ready for the next unit
+extern void ast_release_unit();
+
 // Return an AST for a block which contains the given ASTs.
 extern block_t ast_block(const_decls_t const_decls, var_decls_t var_decls, proc_decls_t proc_decls, stmt_t stmt);
 
@@ -390,7 +420,7 @@ extern proc_decls_t ast_proc_decls(proc_decls_t proc_decls,
 extern proc_decl_t ast_proc_decl(ident_t ident, block_t block);
 
 // Return an AST for a skip statement
-extern skip_stmt_t ast_skip_stmt(file_location *file_loc); 
+extern skip_stmt_t ast_skip_stmt(file_location file_loc); 
 
 // Return an AST for a write statement
 extern write_stmt_t ast_write_stmt(expr_t expr); 
@@ -476,17 +506,17 @@ extern expr_t ast_expr_negated_number(token_t sign, number_t number);
 extern expr_t ast_expr_pos_number(token_t sign, number_t number);
 
 // Return an AST for the given token
-extern token_t ast_token(file_location *file_loc, const char *text, int code);
+extern token_t ast_token(file_location file_loc, const char *text, int code);
 
 // Return an AST for an identifier
 // found in the file named fn, on line ln, with the given name.
-extern ident_t ast_ident(file_location *file_loc, const char *name);
+extern ident_t ast_ident(file_location file_loc, const char *name);
 
 // Return an AST for a (signed) number with the given value
 extern number_t ast_number(token_t sgn, word_type value);
 
 // Return an AST for empty found in the given file location
-empty_t ast_empty(file_location *file_loc);
+empty_t ast_empty(file_location file_loc);
 
 // Requires: lst is a pointer to a non-circular 
 //           linked list with next pointers
@@ -0,0 +1,453 @@
+// A benchmark comparing the two forms of ASTs: the linked structs
+// of ast.h (built in the AST arena) and the AST store of ast_store.h.
+// It builds the same program in both forms, as the parser's actions
+// would, and reports the memory each takes and the time to build it
+// and to walk all its nodes (checking that both walks see the same
+// nodes). It also writes the linked form as an AST image (see
+// ast_image.h), and reports the time to write it and to load it
+// (without and with checking its nodes), walking the loaded image.
+// The program has procs procedures, and each block has
+// stmts statements of all kinds (with nested begins).
+//
+// Usage: ast_bench [procs [stmts]]
+#define _POSIX_C_SOURCE 200809L  // for clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ast.h"
+#include "ast_store.h"
+#include "ast_image.h"
+#include "pl0.tab.h"
+
+#define AST_BENCH_DEFAULT_PROCS 2000
+#define AST_BENCH_DEFAULT_STMTS 120
+#define AST_BENCH_WALKS 5
+
+static file_location loc;
+static size_t procs = AST_BENCH_DEFAULT_PROCS;
+static size_t stmts_per_block = AST_BENCH_DEFAULT_STMTS;
+
+// Return the current time in seconds
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// What a walk sees: the nodes (of the kinds both forms have)
+// and the sum of the numbers
+typedef struct {
+    size_t nodes;
+    long long sum;
+} tally;
+
+// The program as linked structs
+
+static ident_t p_ident(const char *name)
+{
+    return ast_ident(loc, arena_strdup(ast_arena(), name));
+}
+
+static token_t p_op(const char *text, int code)
+{
+    return ast_token(loc, text, code);
+}
+
+static expr_t p_number(word_type v)
+{
+    token_t sign = p_op("+", plussym);
+    return ast_expr_pos_number(sign, ast_number(sign, v));
+}
+
+static expr_t p_var(const char *name)
+{
+    return ast_expr_ident(p_ident(name));
+}
+
+static expr_t p_bin(expr_t e1, token_t op, expr_t e2)
+{
+    return ast_expr_binary_op(ast_binary_op_expr(e1, op, e2));
+}
+
+// Return statement i of a block (in the cycle of kinds)
+static stmt_t p_stmt(size_t i)
+{
+    switch (i % 6) {
+    case 0: // x := (x + 1) * y
+	return ast_stmt_assign(ast_assign_stmt(p_ident("x"),
+	    p_bin(p_bin(p_var("x"), p_op("+", plussym), p_number(1)),
+		  p_op("*", multsym), p_var("y"))));
+    case 1: // if x < 10 then write x else read y
+	return ast_stmt_if(ast_if_stmt(
+	    ast_condition_rel(ast_rel_op_condition(p_var("x"),
+		p_op("<", ltsym), p_number(10))),
+	    ast_stmt_write(ast_write_stmt(p_var("x"))),
+	    ast_stmt_read(ast_read_stmt(p_ident("y")))));
+    case 2: // while odd x do x := x - 1
+	return ast_stmt_while(ast_while_stmt(
+	    ast_condition_odd(ast_odd_condition(p_var("x"))),
+	    ast_stmt_assign(ast_assign_stmt(p_ident("x"),
+		p_bin(p_var("x"), p_op("-", minussym), p_number(1))))));
+    case 3: // call p
+	return ast_stmt_call(ast_call_stmt(p_ident("p")));
+    case 4: // skip
+	return ast_stmt_skip(ast_skip_stmt(loc));
+    }
+    // begin x := 3; write y end
+    stmts_t l = ast_stmts_singleton(ast_stmt_assign(
+	ast_assign_stmt(p_ident("x"), p_number(3))));
+    l = ast_stmts(l, ast_stmt_write(ast_write_stmt(p_var("y"))));
+    return ast_stmt_begin(ast_begin_stmt(l));
+}
+
+// Return a block: const c = 1, d = 2; var x, y, z; procs; begin ... end
+static block_t p_block(proc_decls_t proc_decls)
+{
+    empty_t e = ast_empty(loc);
+    const_defs_t defs = ast_const_defs_singleton(
+	ast_const_def(p_ident("c"), ast_number(p_op("+", plussym), 1)));
+    defs = ast_const_defs(defs,
+	ast_const_def(p_ident("d"), ast_number(p_op("+", plussym), 2)));
+    const_decls_t consts = ast_const_decls(ast_const_decls_empty(e),
+					   ast_const_decl(defs));
+    idents_t ids = ast_idents_singleton(p_ident("x"));
+    ids = ast_idents(ids, p_ident("y"));
+    ids = ast_idents(ids, p_ident("z"));
+    var_decls_t vars = ast_var_decls(ast_var_decls_empty(e),
+				     ast_var_decl(ids));
+    stmts_t l = ast_stmts_singleton(p_stmt(0));
+    for (size_t i = 1; i < stmts_per_block; i++) {
+	l = ast_stmts(l, p_stmt(i));
+    }
+    return ast_block(consts, vars, proc_decls,
+		     ast_stmt_begin(ast_begin_stmt(l)));
+}
+
+static block_t p_program()
+{
+    proc_decls_t ps = ast_proc_decls_empty(ast_empty(loc));
+    for (size_t i = 0; i < procs; i++) {
+	ps = ast_proc_decls(ps, ast_proc_decl(p_ident("p"),
+	    p_block(ast_proc_decls_empty(ast_empty(loc)))));
+    }
+    return p_block(ps);
+}
+
+static void p_walk_stmt(const stmt_t *s, tally *t);
+
+static void p_walk_expr(const expr_t *e, tally *t)
+{
+    t->nodes++;
+    switch (e->expr_kind) {
+    case expr_bin:
+	p_walk_expr(e->expr.binary.expr1, t);
+	p_walk_expr(e->expr.binary.expr2, t);
+	break;
+    case expr_number:
+	t->sum += e->expr.number.value;
+	break;
+    default:
+	break;
+    }
+}
+
+static void p_walk_condition(const condition_t *c, tally *t)
+{
+    t->nodes++;
+    if (c->cond_kind == ck_odd) {
+	p_walk_expr(&c->condition.odd_cond.expr, t);
+    } else {
+	p_walk_expr(&c->condition.rel_op_cond.expr1, t);
+	p_walk_expr(&c->condition.rel_op_cond.expr2, t);
+    }
+}
+
+static void p_walk_block(const block_t *b, tally *t)
+{
+    t->nodes++;
+    for (const_decl_t *cd = b->const_decls.const_decls; cd != NULL;
+	 cd = cd->next) {
+	t->nodes++;
+	for (const_def_t *d = cd->const_defs.const_defs; d != NULL;
+	     d = d->next) {
+	    t->nodes++;
+	    t->sum += d->number.value;
+	}
+    }
+    for (var_decl_t *vd = b->var_decls.var_decls; vd != NULL;
+	 vd = vd->next) {
+	t->nodes++;
+	for (ident_t *id = vd->idents.idents; id != NULL; id = id->next) {
+	    t->nodes++;
+	}
+    }
+    for (proc_decl_t *pd = b->proc_decls.proc_decls; pd != NULL;
+	 pd = pd->next) {
+	t->nodes++;
+	p_walk_block(pd->block, t);
+    }
+    p_walk_stmt(&b->stmt, t);
+}
+
+static void p_walk_stmt(const stmt_t *s, tally *t)
+{
+    t->nodes++;
+    switch (s->stmt_kind) {
+    case assign_stmt:
+	p_walk_expr(s->stmt.assign_stmt.expr, t);
+	break;
+    case begin_stmt:
+	for (stmt_t *b = s->stmt.begin_stmt.stmts.stmts; b != NULL;
+	     b = b->next) {
+	    p_walk_stmt(b, t);
+	}
+	break;
+    case if_stmt:
+	p_walk_condition(&s->stmt.if_stmt.condition, t);
+	p_walk_stmt(s->stmt.if_stmt.then_stmt, t);
+	p_walk_stmt(s->stmt.if_stmt.else_stmt, t);
+	break;
+    case while_stmt:
+	p_walk_condition(&s->stmt.while_stmt.condition, t);
+	p_walk_stmt(s->stmt.while_stmt.body, t);
+	break;
+    case write_stmt:
+	p_walk_expr(&s->stmt.write_stmt.expr, t);
+	break;
+    default:
+	break;
+    }
+}
+
+// The program in an AST store
+
+static ast_store store;
+
+static ast_ref s_ident(const char *name)
+{
+    return ast_store_ident(&store, loc, ast_store_name(&store, name));
+}
+
+static ast_ref s_var(const char *name)
+{
+    return ast_store_ident_expr(&store, loc, ast_store_name(&store, name));
+}
+
+static ast_ref s_number(word_type v)
+{
+    return ast_store_number_expr(&store, loc, v);
+}
+
+// Return statement i of a block (in the cycle of kinds)
+static ast_ref s_stmt(size_t i)
+{
+    ast_store *s = &store;
+    switch (i % 6) {
+    case 0:
+	return ast_store_assign_stmt(s, loc, ast_store_name(s, "x"),
+	    ast_store_binary_op_expr(s, loc,
+		ast_store_binary_op_expr(s, loc, s_var("x"), plussym,
+					 s_number(1)),
+		multsym, s_var("y")));
+    case 1:
+	return ast_store_if_stmt(s, loc,
+	    ast_store_rel_op_condition(s, loc, s_var("x"), ltsym,
+				       s_number(10)),
+	    ast_store_write_stmt(s, loc, s_var("x")),
+	    ast_store_read_stmt(s, loc, ast_store_name(s, "y")));
+    case 2:
+	return ast_store_while_stmt(s, loc,
+	    ast_store_odd_condition(s, loc, s_var("x")),
+	    ast_store_assign_stmt(s, loc, ast_store_name(s, "x"),
+		ast_store_binary_op_expr(s, loc, s_var("x"), minussym,
+					 s_number(1))));
+    case 3:
+	return ast_store_call_stmt(s, loc, ast_store_name(s, "p"));
+    case 4:
+	return ast_store_skip_stmt(s, loc);
+    }
+    ast_list_mark l = ast_store_list_start(s);
+    ast_store_list_add(s, ast_store_assign_stmt(s, loc,
+	ast_store_name(s, "x"), s_number(3)));
+    ast_store_list_add(s, ast_store_write_stmt(s, loc, s_var("y")));
+    return ast_store_begin_stmt(s, loc, l);
+}
+
+// Return a block whose proc decls list (with the given mark) is built
+static ast_ref s_block_end(ast_list_mark consts, ast_list_mark vars,
+			   ast_list_mark ps)
+{
+    ast_store *s = &store;
+    ast_list_mark l = ast_store_list_start(s);
+    for (size_t i = 0; i < stmts_per_block; i++) {
+	ast_store_list_add(s, s_stmt(i));
+    }
+    ast_ref body = ast_store_begin_stmt(s, loc, l);
+    return ast_store_block(s, loc, consts, vars, ps, body);
+}
+
+// Build the declarations of a block, setting the marks of their lists
+static void s_block_start(ast_list_mark *consts, ast_list_mark *vars)
+{
+    ast_store *s = &store;
+    *consts = ast_store_list_start(s);
+    ast_list_mark defs = ast_store_list_start(s);
+    ast_store_list_add(s, ast_store_const_def(s, loc,
+					      ast_store_name(s, "c"), 1));
+    ast_store_list_add(s, ast_store_const_def(s, loc,
+					      ast_store_name(s, "d"), 2));
+    ast_store_list_add(s, ast_store_const_decl(s, loc, defs));
+    *vars = ast_store_list_start(s);
+    ast_list_mark ids = ast_store_list_start(s);
+    ast_store_list_add(s, s_ident("x"));
+    ast_store_list_add(s, s_ident("y"));
+    ast_store_list_add(s, s_ident("z"));
+    ast_store_list_add(s, ast_store_var_decl(s, loc, ids));
+}
+
+static ast_ref s_program()
+{
+    ast_store *s = &store;
+    ast_list_mark consts, vars;
+    s_block_start(&consts, &vars);
+    ast_list_mark ps = ast_store_list_start(s);
+    for (size_t i = 0; i < procs; i++) {
+	ast_list_mark c, v;
+	s_block_start(&c, &v);
+	ast_ref b = s_block_end(c, v, ast_store_list_start(s));
+	ast_store_list_add(s, ast_store_proc_decl(s, loc,
+	    ast_store_name(s, "p"), b));
+    }
+    return s_block_end(consts, vars, ps);
+}
+
+// The visitor of the store's walk: count the node and add up the numbers
+static bool s_visit(void *arg, const ast_store *s, ast_store_kind kind,
+		    ast_ref r)
+{
+    tally *t = (tally *) arg;
+    t->nodes++;
+    if (kind == expr_node
+	&& AST_STORE_TAG(s, kind, r) == expr_number) {
+	t->sum += (word_type) AST_STORE_FIELD(s, kind, r, AST_EXPR_VALUE);
+    } else if (kind == const_def_node) {
+	t->sum += (word_type) AST_STORE_FIELD(s, kind, r,
+					      AST_CONST_DEF_VALUE);
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1) {
+	procs = strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+	stmts_per_block = strtoul(argv[2], NULL, 10);
+    }
+    if (stmts_per_block == 0) {
+	stmts_per_block = 1;
+    }
+    loc = file_location_make("ast_bench", 1);
+
+    double start = now();
+    block_t prog = p_program();
+    double p_build = now() - start;
+    arena_stats stats = arena_get_stats(ast_arena());
+
+    ast_store_init(&store);
+    start = now();
+    ast_ref root = s_program();
+    double s_build = now() - start;
+
+    tally pt = { 0, 0 }, st = { 0, 0 };
+    double p_walk = 0.0, s_walk = 0.0;
+    for (int i = 0; i < AST_BENCH_WALKS; i++) {
+	pt = (tally) { 0, 0 };
+	start = now();
+	p_walk_block(&prog, &pt);
+	double t = now() - start;
+	if (i == 0 || t < p_walk) {
+	    p_walk = t;
+	}
+	st = (tally) { 0, 0 };
+	start = now();
+	ast_store_walk(&store, block_node, root, s_visit, &st);
+	t = now() - start;
+	if (i == 0 || t < s_walk) {
+	    s_walk = t;
+	}
+    }
+    if (pt.nodes != st.nodes || pt.sum != st.sum) {
+	fprintf(stderr, "ast_bench: the walks differ: %zu nodes (sum %lld)"
+		" versus %zu nodes (sum %lld)!\n",
+		pt.nodes, pt.sum, st.nodes, st.sum);
+	return EXIT_FAILURE;
+    }
+
+    // write the image of the linked form, then load and walk it
+    const char *image_name = "ast_bench.pl0ast";
+    error_status status;
+    start = now();
+    if (!ast_image_write(image_name, &prog, &status)) {
+	exit_with_error(&status);
+    }
+    double i_write = now() - start;
+    double i_load = 0.0, i_check = 0.0;
+    ast_image img;
+    tally it = { 0, 0 };
+    for (int i = 0; i < AST_BENCH_WALKS; i++) {
+	start = now();
+	bool ok = ast_image_load(image_name, true, &img, &status);
+	double t = now() - start;
+	if (!ok) {
+	    exit_with_error(&status);
+	}
+	ast_image_unload(&img);
+	if (i == 0 || t < i_check) {
+	    i_check = t;
+	}
+	start = now();
+	ok = ast_image_load(image_name, false, &img, &status);
+	t = now() - start;
+	if (!ok) {
+	    exit_with_error(&status);
+	}
+	if (i == 0 || t < i_load) {
+	    i_load = t;
+	}
+	it = (tally) { 0, 0 };
+	ast_store_walk(&img.store, block_node, img.root, s_visit, &it);
+	if (i < AST_BENCH_WALKS - 1) {
+	    ast_image_unload(&img);
+	}
+    }
+    size_t image_bytes = img.file.len;
+    ast_image_unload(&img);
+    remove(image_name);
+    if (pt.nodes != it.nodes || pt.sum != it.sum) {
+	fprintf(stderr, "ast_bench: the image's walk differs: %zu nodes"
+		" (sum %lld) versus %zu nodes (sum %lld)!\n",
+		pt.nodes, pt.sum, it.nodes, it.sum);
+	return EXIT_FAILURE;
+    }
+
+    printf("%zu procedures of %zu statements: %zu nodes\n",
+	   procs, stmts_per_block, pt.nodes);
+    printf("%-14s %12s %12s %10s %10s\n", "form", "bytes", "bytes/node",
+	   "build ms", "walk ms");
+    printf("%-14s %12zu %12.1f %10.2f %10.2f\n", "linked structs",
+	   stats.bytes, (double) stats.bytes / pt.nodes,
+	   p_build * 1e3, p_walk * 1e3);
+    printf("%-14s %12zu %12.1f %10.2f %10.2f\n", "AST store",
+	   ast_store_bytes(&store),
+	   (double) ast_store_bytes(&store) / st.nodes,
+	   s_build * 1e3, s_walk * 1e3);
+    printf("AST image: %zu bytes, written in %.2f ms, loaded in %.1f us"
+	   " (%.2f ms checking its nodes)\n", image_bytes, i_write * 1e3,
+	   i_load * 1e6, i_check * 1e3);
+    ast_store_free(&store);
+    ast_release_unit();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,413 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "file_location.h"
+#include "ast_image.h"
+
+// Return n rounded up to a multiple of 8
+static uint64_t align8(uint64_t n)
+{
+    return (n + 7) & ~(uint64_t) 7;
+}
+
+// Set arrays to the addresses of the pointers to the arrays of an image
+// of s (whose file names are at *file_offsets and *file_names)
+// and sizes to their sizes in bytes, in the order of the image's
+// sections, and return their number
+static uint32_t sections(ast_store *s, uint32_t **file_offsets,
+			 char **file_names, uint32_t file_count,
+			 uint32_t files_size, void **arrays[], uint64_t sizes[])
+{
+    uint32_t n = 0;
+    for (int k = 0; k < AST_STORE_KINDS; k++) {
+	ast_store_table *t = &s->tables[k];
+	if (ast_store_has_tag(k)) {
+	    arrays[n] = (void **) &t->tag;
+	    sizes[n++] = (uint64_t) t->count * sizeof(uint8_t);
+	}
+	arrays[n] = (void **) &t->loc;
+	sizes[n++] = (uint64_t) t->count * sizeof(file_location);
+	for (int i = 0; i < ast_store_field_count(k); i++) {
+	    arrays[n] = (void **) &t->field[i];
+	    sizes[n++] = (uint64_t) t->count * sizeof(uint32_t);
+	}
+    }
+    arrays[n] = (void **) &s->lists;
+    sizes[n++] = (uint64_t) s->list_count * sizeof(ast_ref);
+    arrays[n] = (void **) &s->names;
+    sizes[n++] = s->names_size;
+    arrays[n] = (void **) file_offsets;
+    sizes[n++] = (uint64_t) file_count * sizeof(uint32_t);
+    arrays[n] = (void **) file_names;
+    sizes[n++] = files_size;
+    return n;
+}
+
+// Write the image of the program whose block is root in s to the file
+// named fname and return true; but if it cannot be written,
+// fill in *status and return false
+bool ast_image_write_store(const char *fname, const ast_store *s,
+			   ast_ref root, error_status *status)
+{
+    // number the files named in the locations in the order they appear
+    size_t table_size = file_table_size();
+    uint32_t *local = (uint32_t *) malloc((table_size + 1) * sizeof(uint32_t));
+    uint32_t *file_offsets = (uint32_t *)
+	malloc((table_size + 1) * sizeof(uint32_t));
+    if (local == NULL || file_offsets == NULL) {
+	bail_with_error("Cannot allocate space to write an AST image!");
+    }
+    memset(local, 0xFF, (table_size + 1) * sizeof(uint32_t));
+    uint32_t file_count = 0;
+    size_t files_size = 0;
+    for (int k = 0; k < AST_STORE_KINDS; k++) {
+	const ast_store_table *t = &s->tables[k];
+	for (uint32_t i = 0; i < t->count; i++) {
+	    file_id f = t->loc[i].file;
+	    if (local[f] == UINT32_MAX) {
+		local[f] = file_count;
+		file_offsets[file_count++] = (uint32_t) files_size;
+		files_size += strlen(file_table_name(f)) + 1;
+	    }
+	}
+    }
+    char *file_names = (char *) malloc(files_size + 1);
+    if (file_names == NULL) {
+	bail_with_error("Cannot allocate space to write an AST image!");
+    }
+    for (size_t f = 0; f < table_size; f++) {
+	if (local[f] != UINT32_MAX) {
+	    strcpy(file_names + file_offsets[local[f]],
+		   file_table_name((file_id) f));
+	}
+    }
+
+    // lay out the header and the sections
+    ast_store w = *s;
+    void **arrays[AST_IMAGE_MAX_SECTIONS];
+    uint64_t sizes[AST_IMAGE_MAX_SECTIONS];
+    ast_image_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, AST_IMAGE_MAGIC, sizeof(h.magic));
+    h.version = AST_IMAGE_VERSION;
+    h.byte_order = AST_IMAGE_BYTE_ORDER;
+    h.root = root;
+    for (int k = 0; k < AST_STORE_KINDS; k++) {
+	h.counts[k] = s->tables[k].count;
+    }
+    h.list_count = s->list_count;
+    h.names_size = s->names_size;
+    h.file_count = file_count;
+    h.files_size = (uint32_t) files_size;
+    h.section_count = sections(&w, &file_offsets, &file_names, file_count,
+			       h.files_size, arrays, sizes);
+    uint64_t offset = align8(sizeof(ast_image_header));
+    for (uint32_t i = 0; i < h.section_count; i++) {
+	h.sections[i].offset = offset;
+	h.sections[i].size = sizes[i];
+	offset = align8(offset + sizes[i]);
+    }
+    h.size = offset;
+
+    // build the image in memory, with the locations renumbered
+    char *image = (char *) calloc(1, h.size);
+    if (image == NULL) {
+	bail_with_error("Cannot allocate space to write an AST image!");
+    }
+    memcpy(image, &h, sizeof(h));
+    for (uint32_t i = 0; i < h.section_count; i++) {
+	if (sizes[i] > 0) {
+	    memcpy(image + h.sections[i].offset, *arrays[i], sizes[i]);
+	}
+	for (int k = 0; k < AST_STORE_KINDS; k++) {
+	    if (arrays[i] == (void **) &w.tables[k].loc) {
+		file_location *locs = (file_location *)
+		    (image + h.sections[i].offset);
+		for (uint32_t j = 0; j < h.counts[k]; j++) {
+		    locs[j].file = local[locs[j].file];
+		}
+	    }
+	}
+    }
+    free(local);
+    free(file_offsets);
+    free(file_names);
+
+    errno = 0;
+    FILE *out = fopen(fname, "wb");
+    if (out == NULL) {
+	free(image);
+	return fail_with_error(status, "Cannot open %s", fname);
+    }
+    size_t written = fwrite(image, 1, h.size, out);
+    int rc = fclose(out);
+    free(image);
+    if (written != h.size || rc == EOF) {
+	return fail_with_error(status, "Cannot write %s", fname);
+    }
+    return true;
+}
+
+// Write the image of the program whose linked AST is prog to the file
+// named fname and return true; but if it cannot be written,
+// fill in *status and return false
+bool ast_image_write(const char *fname, const block_t *prog,
+		     error_status *status)
+{
+    ast_store s;
+    ast_store_init(&s);
+    ast_ref root = ast_store_add_block(&s, prog);
+    bool ret = ast_image_write_store(fname, &s, root, status);
+    ast_store_free(&s);
+    return ret;
+}
+
+// Is the range of the list in fields i and i+1 of node r of the given
+// kind in the image's list array, with handles of nodes of kind elem
+// (which are less than limit)?
+static bool good_range(const ast_store *s, ast_store_kind kind, ast_ref r,
+		       int i, ast_store_kind elem, uint32_t limit)
+{
+    ast_range range = ast_store_range(s, kind, r, i);
+    if ((uint64_t) range.first + range.count > s->list_count) {
+	return false;
+    }
+    const ast_ref *elems = ast_store_list(s, range);
+    for (uint32_t j = 0; j < range.count; j++) {
+	if (elems[j] >= limit || elems[j] >= s->tables[elem].count) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+// Is the handle in field i of node r of the given kind that of a node
+// of kind child (and less than limit)?
+static bool good_ref(const ast_store *s, ast_store_kind kind, ast_ref r,
+		     int i, ast_store_kind child, uint32_t limit)
+{
+    ast_ref c = AST_STORE_FIELD(s, kind, r, i);
+    return c < limit && c < s->tables[child].count;
+}
+
+// Is the name in field i of node r of the given kind in the names?
+static bool good_name(const ast_store *s, ast_store_kind kind, ast_ref r,
+		      int i)
+{
+    return AST_STORE_FIELD(s, kind, r, i) < s->names_size;
+}
+
+// Is node r of the given kind in the image img well formed? Its
+// handles must be in range, and those of nodes of its own kind must
+// be less than r (as they are built first), so no node is its own
+// descendant; that also holds for the blocks of its procedures
+static bool good_node(const ast_image *img, ast_store_kind kind, ast_ref r)
+{
+    const ast_store *s = &img->store;
+    if (AST_STORE_LOC(s, kind, r).file >= img->file_count) {
+	return false;
+    }
+    switch (kind) {
+    case block_node: {
+	if (!good_range(s, kind, r, AST_BLOCK_CONST_DECLS, const_decl_node,
+			UINT32_MAX)
+	    || !good_range(s, kind, r, AST_BLOCK_VAR_DECLS, var_decl_node,
+			   UINT32_MAX)
+	    || !good_range(s, kind, r, AST_BLOCK_PROC_DECLS, proc_decl_node,
+			   UINT32_MAX)
+	    || !good_ref(s, kind, r, AST_BLOCK_STMT, stmt_node, UINT32_MAX)) {
+	    return false;
+	}
+	ast_range procs = ast_store_range(s, kind, r, AST_BLOCK_PROC_DECLS);
+	const ast_ref *elems = ast_store_list(s, procs);
+	for (uint32_t j = 0; j < procs.count; j++) {
+	    if (!good_ref(s, proc_decl_node, elems[j], AST_PROC_DECL_BLOCK,
+			  block_node, r)) {
+		return false;
+	    }
+	}
+	return true;
+    }
+    case const_decl_node:
+	return good_range(s, kind, r, AST_CONST_DECL_DEFS, const_def_node,
+			  UINT32_MAX);
+    case const_def_node:
+	return good_name(s, kind, r, AST_CONST_DEF_NAME);
+    case var_decl_node:
+	return good_range(s, kind, r, AST_VAR_DECL_IDENTS, ident_node,
+			  UINT32_MAX);
+    case ident_node:
+	return good_name(s, kind, r, AST_IDENT_NAME);
+    case proc_decl_node:
+	return good_name(s, kind, r, AST_PROC_DECL_NAME)
+	    && good_ref(s, kind, r, AST_PROC_DECL_BLOCK, block_node,
+			UINT32_MAX);
+    case stmt_node:
+	switch (AST_STORE_TAG(s, kind, r)) {
+	case assign_stmt:
+	    return good_name(s, kind, r, AST_STMT_NAME)
+		&& good_ref(s, kind, r, AST_STMT_EXPR, expr_node, UINT32_MAX);
+	case call_stmt: case read_stmt:
+	    return good_name(s, kind, r, AST_STMT_NAME);
+	case begin_stmt:
+	    return good_range(s, kind, r, AST_STMT_STMTS, stmt_node, r);
+	case if_stmt:
+	    return good_ref(s, kind, r, AST_STMT_CONDITION, condition_node,
+			    UINT32_MAX)
+		&& good_ref(s, kind, r, AST_STMT_THEN, stmt_node, r)
+		&& good_ref(s, kind, r, AST_STMT_ELSE, stmt_node, r);
+	case while_stmt:
+	    return good_ref(s, kind, r, AST_STMT_CONDITION, condition_node,
+			    UINT32_MAX)
+		&& good_ref(s, kind, r, AST_STMT_BODY, stmt_node, r);
+	case write_stmt:
+	    return good_ref(s, kind, r, AST_WRITE_STMT_EXPR, expr_node,
+			    UINT32_MAX);
+	case skip_stmt:
+	    return true;
+	default:
+	    return false;
+	}
+    case condition_node:
+	switch (AST_STORE_TAG(s, kind, r)) {
+	case ck_odd:
+	    return good_ref(s, kind, r, AST_EXPR1, expr_node, UINT32_MAX);
+	case ck_rel:
+	    return good_ref(s, kind, r, AST_EXPR1, expr_node, UINT32_MAX)
+		&& good_ref(s, kind, r, AST_EXPR2, expr_node, UINT32_MAX);
+	default:
+	    return false;
+	}
+    case expr_node:
+	switch (AST_STORE_TAG(s, kind, r)) {
+	case expr_bin:
+	    return good_ref(s, kind, r, AST_EXPR1, expr_node, r)
+		&& good_ref(s, kind, r, AST_EXPR2, expr_node, r);
+	case expr_ident:
+	    return good_name(s, kind, r, AST_EXPR_NAME);
+	case expr_number:
+	    return true;
+	default:
+	    return false;
+	}
+    default:
+	return false;
+    }
+}
+
+// Fill in *status with the message that the file named fname
+// is not a valid image (because of what) and return false
+static bool invalid(error_status *status, const char *fname,
+		    const char *what)
+{
+    errno = 0;
+    return fail_with_error(status, "%s is not a valid AST image: %s",
+			   fname, what);
+}
+
+// Check the header and layout of the image in img->file, setting up
+// img to use it in place, and return true; but if it is not a valid
+// image, fill in *status and return false
+static bool load_header(const char *fname, ast_image *img,
+			error_status *status)
+{
+    const char *base = img->file.text;
+    size_t len = img->file.len;
+    if (len < sizeof(ast_image_header)
+	|| memcmp(base, AST_IMAGE_MAGIC, 8) != 0) {
+	return invalid(status, fname, "it does not start with its header");
+    }
+    const ast_image_header *h = (const ast_image_header *) base;
+    if (h->version != AST_IMAGE_VERSION) {
+	errno = 0;
+	return fail_with_error(status, "%s is an AST image of version %u,"
+			       " not %d", fname, (unsigned int) h->version,
+			       AST_IMAGE_VERSION);
+    }
+    if (h->byte_order != AST_IMAGE_BYTE_ORDER) {
+	return invalid(status, fname, "it has the wrong byte order");
+    }
+    if (h->size != len) {
+	return invalid(status, fname, "its size is wrong");
+    }
+
+    ast_store *s = &img->store;
+    memset(s, 0, sizeof(ast_store));
+    for (int k = 0; k < AST_STORE_KINDS; k++) {
+	s->tables[k].count = s->tables[k].capacity = h->counts[k];
+    }
+    s->list_count = s->list_capacity = h->list_count;
+    s->names_size = s->names_capacity = h->names_size;
+    img->file_count = h->file_count;
+    void **arrays[AST_IMAGE_MAX_SECTIONS];
+    uint64_t sizes[AST_IMAGE_MAX_SECTIONS];
+    uint32_t n = sections(s, (uint32_t **) &img->file_offsets,
+			  (char **) &img->file_names, h->file_count,
+			  h->files_size, arrays, sizes);
+    if (h->section_count != n) {
+	return invalid(status, fname, "it has the wrong number of sections");
+    }
+    for (uint32_t i = 0; i < n; i++) {
+	const ast_image_section *sec = &h->sections[i];
+	if (sec->size != sizes[i] || sec->offset % 8 != 0
+	    || sec->offset < sizeof(ast_image_header)
+	    || sec->offset > len || sec->size > len - sec->offset) {
+	    return invalid(status, fname, "a section is out of place");
+	}
+	*arrays[i] = (void *) (base + sec->offset);
+    }
+    if (h->root >= h->counts[block_node]) {
+	return invalid(status, fname, "it has no program");
+    }
+    img->root = h->root;
+    if ((s->names_size > 0 && s->names[s->names_size - 1] != '\0')
+	|| (h->files_size > 0 && img->file_names[h->files_size - 1] != '\0')) {
+	return invalid(status, fname, "a name is not terminated");
+    }
+    for (uint32_t f = 0; f < h->file_count; f++) {
+	if (img->file_offsets[f] >= h->files_size) {
+	    return invalid(status, fname, "a file name is out of place");
+	}
+    }
+    return true;
+}
+
+// Load the image in the file named fname into *img, checking its
+// header and layout, and its nodes if check_nodes is true, and return
+// true; but if it cannot be read or is not a valid image,
+// fill in *status and return false
+bool ast_image_load(const char *fname, bool check_nodes, ast_image *img,
+		    error_status *status)
+{
+    if (!input_file_map(fname, &img->file, status)) {
+	return false;
+    }
+    bool ok = load_header(fname, img, status);
+    for (int k = 0; ok && check_nodes && k < AST_STORE_KINDS; k++) {
+	for (ast_ref r = 0; r < img->store.tables[k].count; r++) {
+	    if (!good_node(img, k, r)) {
+		ok = invalid(status, fname, "a node is malformed");
+		break;
+	    }
+	}
+    }
+    if (!ok) {
+	input_file_unmap(&img->file);
+    }
+    return ok;
+}
+
+// Return the name of the file numbered file in the locations of img
+const char *ast_image_file_name(const ast_image *img, file_id file)
+{
+    return img->file_names + img->file_offsets[file];
+}
+
+// Unmap the image img
+void ast_image_unload(ast_image *img)
+{
+    input_file_unmap(&img->file);
+    memset(&img->store, 0, sizeof(ast_store));
+    img->file_count = 0;
+}
@@ -0,0 +1,109 @@
+#ifndef _AST_IMAGE_H
+#define _AST_IMAGE_H
+#include <stdbool.h>
+#include <stdint.h>
+#include "ast.h"
+#include "ast_store.h"
+#include "input_file.h"
+#include "utilities.h"
+
+// An AST image is a program's AST saved in a file, so that later
+// stages of a pipeline can use it without parsing the program again.
+// It holds the arrays of an AST store (see ast_store.h), so it has no
+// pointers: its nodes refer to each other by handles, and its arrays
+// are found by their offsets from the start of the file. So an image
+// is loaded by mapping its file into memory and is used in place.
+//
+// An image starts with a header, which gives its version, the byte
+// order of the machine that wrote it (which must be that of the
+// reader), and the offset and size of each of its arrays. Loading
+// an image checks the header and the layout of the arrays, which
+// takes the same short time for any size of program. Checking its
+// nodes (that their handles, names, files and tags are in range,
+// and that no node is its own descendant) takes time in proportion
+// to its size, and is only done if asked for.
+
+// The first 8 bytes of an image
+#define AST_IMAGE_MAGIC "PL0AST\r\n"
+
+// The version of the image format that is written and read
+#define AST_IMAGE_VERSION 1
+
+// The byte order marker, as written by the machine that wrote an image
+#define AST_IMAGE_BYTE_ORDER 0x01020304u
+
+// The most arrays (sections) in an image
+#define AST_IMAGE_MAX_SECTIONS 64
+
+// An array in an image: size bytes at offset bytes from its start
+// (a multiple of 8)
+typedef struct {
+    uint64_t offset;
+    uint64_t size;
+} ast_image_section;
+
+// The header at the start of an image. Its sections are, in order:
+// for each kind of node (in the order of ast_store_kind), its tags
+// (if it has them), its locations and each of its fields; then the
+// list array, the names, the offsets of the file names (one uint32_t
+// for each file) and the file names (each null-terminated).
+// In the locations of an image, a file is named by its number
+// in the image's list of file names.
+typedef struct {
+    char magic[8];                      // AST_IMAGE_MAGIC
+    uint32_t version;                   // AST_IMAGE_VERSION
+    uint32_t byte_order;                // AST_IMAGE_BYTE_ORDER
+    uint64_t size;                      // bytes in the whole image
+    uint32_t root;                      // the handle of the program's block
+    uint32_t counts[AST_STORE_KINDS];   // nodes of each kind
+    uint32_t list_count;                // handles in the list array
+    uint32_t names_size;                // bytes of names
+    uint32_t file_count;                // number of file names
+    uint32_t files_size;                // bytes of file names
+    uint32_t section_count;
+    uint32_t reserved;                  // 0
+    ast_image_section sections[AST_IMAGE_MAX_SECTIONS];
+} ast_image_header;
+
+// A loaded image
+typedef struct {
+    input_file file;           // the mapped file
+    ast_store store;           // its nodes, read-only, in the mapped file
+    ast_ref root;              // the handle of the program's block
+    uint32_t file_count;       // the number of files its locations name
+    const uint32_t *file_offsets;
+    const char *file_names;
+} ast_image;
+
+// Requires: fname != NULL and s != NULL and status != NULL,
+//           and root is the handle of a block in s
+// Write the image of the program whose block is root in s to the file
+// named fname and return true; but if it cannot be written,
+// fill in *status and return false
+extern bool ast_image_write_store(const char *fname, const ast_store *s,
+				  ast_ref root, error_status *status);
+
+// Requires: fname != NULL and prog != NULL and status != NULL
+// Write the image of the program whose linked AST is prog to the file
+// named fname and return true; but if it cannot be written,
+// fill in *status and return false
+extern bool ast_image_write(const char *fname, const block_t *prog,
+			    error_status *status);
+
+// Requires: fname != NULL and img != NULL and status != NULL
+// Load the image in the file named fname into *img, checking its
+// header and layout, and its nodes if check_nodes is true, and return
+// true; but if it cannot be read or is not a valid image,
+// fill in *status and return false
+extern bool ast_image_load(const char *fname, bool check_nodes,
+			   ast_image *img, error_status *status);
+
+// Requires: img was filled in by ast_image_load
+// Return the name of the file numbered file in the locations of img
+extern const char *ast_image_file_name(const ast_image *img, file_id file);
+
+// Requires: img was filled in by ast_image_load
+// Unmap the image img (after which its nodes can no longer be used)
+extern void ast_image_unload(ast_image *img);
+
+#endif
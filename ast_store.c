@@ -0,0 +1,694 @@
+#include <stdlib.h>
+#include <string.h>
+#include "utilities.h"
+#include "ast_store.h"
+
+// The number of fields of each kind of node
+static const int field_counts[AST_STORE_KINDS] = {
+    [block_node] = 7, [const_decl_node] = 2,
+    [const_def_node] = 2, [var_decl_node] = 2,
+    [ident_node] = 1, [proc_decl_node] = 2,
+    [stmt_node] = 3, [condition_node] = 3, [expr_node] = 3
+};
+
+// Does each kind of node have a tag?
+static const bool has_tag[AST_STORE_KINDS] = {
+    [stmt_node] = true, [condition_node] = true,
+    [expr_node] = true
+};
+
+// Initialize s as an empty store
+void ast_store_init(ast_store *s)
+{
+    memset(s, 0, sizeof(ast_store));
+}
+
+// Free all the memory of s, leaving it empty
+void ast_store_free(ast_store *s)
+{
+    for (int k = 0; k < AST_STORE_KINDS; k++) {
+	ast_store_table *t = &s->tables[k];
+	free(t->tag);
+	free(t->loc);
+	for (int i = 0; i < field_counts[k]; i++) {
+	    free(t->field[i]);
+	}
+    }
+    free(s->lists);
+    free(s->pending);
+    free(s->names);
+    free(s->name_slots);
+    ast_store_init(s);
+}
+
+// Return the number of bytes of memory that s holds
+size_t ast_store_bytes(const ast_store *s)
+{
+    size_t bytes = sizeof(ast_store);
+    for (int k = 0; k < AST_STORE_KINDS; k++) {
+	size_t node = sizeof(file_location)
+	    + field_counts[k] * sizeof(uint32_t) + (has_tag[k] ? 1 : 0);
+	bytes += s->tables[k].capacity * node;
+    }
+    bytes += (size_t) s->list_capacity * sizeof(ast_ref);
+    bytes += (size_t) s->pending_capacity * sizeof(ast_ref);
+    bytes += s->names_capacity;
+    bytes += (size_t) s->name_slot_count * sizeof(uint32_t);
+    return bytes;
+}
+
+// Return the number of nodes in s
+size_t ast_store_node_count(const ast_store *s)
+{
+    size_t n = 0;
+    for (int k = 0; k < AST_STORE_KINDS; k++) {
+	n += s->tables[k].count;
+    }
+    return n;
+}
+
+// Return the number of nodes of the given kind in s
+uint32_t ast_store_count(const ast_store *s, ast_store_kind kind)
+{
+    return s->tables[kind].count;
+}
+
+// Return the number of fields of the given kind of node
+int ast_store_field_count(ast_store_kind kind)
+{
+    return field_counts[kind];
+}
+
+// Do the nodes of the given kind have tags?
+bool ast_store_has_tag(ast_store_kind kind)
+{
+    return has_tag[kind];
+}
+
+// Return the range held in fields i and i+1 of node r of the given kind
+ast_range ast_store_range(const ast_store *s, ast_store_kind kind,
+			  ast_ref r, int i)
+{
+    ast_range ret;
+    ret.first = AST_STORE_FIELD(s, kind, r, i);
+    ret.count = AST_STORE_FIELD(s, kind, r, i + 1);
+    return ret;
+}
+
+// Return a pointer to the range.count handles of the list range
+const ast_ref *ast_store_list(const ast_store *s, ast_range range)
+{
+    return s->lists + range.first;
+}
+
+// Return the text of name
+const char *ast_store_name_text(const ast_store *s, ast_name name)
+{
+    return s->names + name;
+}
+
+// Return a copy of p (an array of capacity elements of the given size)
+// with room for new_capacity elements
+static void *grow(void *p, size_t new_capacity, size_t size)
+{
+    if (new_capacity > UINT32_MAX) {
+	bail_with_error("Too many nodes for an AST store!");
+    }
+    p = realloc(p, new_capacity * size);
+    if (p == NULL) {
+	bail_with_error("Cannot allocate space for an AST store!");
+    }
+    return p;
+}
+
+// Return the new capacity of an array (with the given capacity)
+// that needs room for one more element (which grow checks)
+static size_t next_capacity(size_t capacity)
+{
+    return (capacity == 0) ? 64 : 2 * capacity;
+}
+
+// Add a node of the given kind to s, with location loc and tag tag,
+// and return its handle; its fields are then to be set
+static ast_ref add_node(ast_store *s, ast_store_kind kind,
+			file_location loc, int tag)
+{
+    ast_store_table *t = &s->tables[kind];
+    if (t->count == t->capacity) {
+	size_t cap = next_capacity(t->capacity);
+	if (has_tag[kind]) {
+	    t->tag = grow(t->tag, cap, sizeof(uint8_t));
+	}
+	t->loc = grow(t->loc, cap, sizeof(file_location));
+	for (int i = 0; i < field_counts[kind]; i++) {
+	    t->field[i] = grow(t->field[i], cap, sizeof(uint32_t));
+	}
+	t->capacity = (uint32_t) cap;
+    }
+    ast_ref r = t->count++;
+    if (has_tag[kind]) {
+	t->tag[r] = (uint8_t) tag;
+    }
+    t->loc[r] = loc;
+    return r;
+}
+
+// Set field i of node r of the given kind in s to v
+static void set(ast_store *s, ast_store_kind kind, ast_ref r, int i,
+		uint32_t v)
+{
+    s->tables[kind].field[i][r] = v;
+}
+
+// Set fields i and i+1 of node r of the given kind in s
+// to the range of the list with the given mark, ending that list
+static void set_list(ast_store *s, ast_store_kind kind, ast_ref r, int i,
+		     ast_list_mark mark)
+{
+    ast_range range = ast_store_list_end(s, mark);
+    set(s, kind, r, i, range.first);
+    set(s, kind, r, i + 1, range.count);
+}
+
+// Return the FNV-1a hash of the string s
+static uint32_t hash_name(const char *s)
+{
+    uint32_t h = 2166136261u;
+    for (; *s != '\0'; s++) {
+	h = (h ^ (unsigned char) *s) * 16777619u;
+    }
+    return h;
+}
+
+// Make the hash table of the names of s twice as big (or start it)
+// and refill it
+static void grow_name_slots(ast_store *s)
+{
+    size_t count = (s->name_slot_count == 0) ? 256
+	: 2 * (size_t) s->name_slot_count;
+    if (count > UINT32_MAX) {
+	bail_with_error("Too many names for an AST store!");
+    }
+    free(s->name_slots);
+    s->name_slots = (uint32_t *) calloc(count, sizeof(uint32_t));
+    if (s->name_slots == NULL) {
+	bail_with_error("Cannot allocate space for an AST store!");
+    }
+    s->name_slot_count = (uint32_t) count;
+    uint32_t mask = s->name_slot_count - 1;
+    for (uint32_t n = 0; n < s->names_size;
+	 n += (uint32_t) strlen(s->names + n) + 1) {
+	uint32_t i = hash_name(s->names + n) & mask;
+	while (s->name_slots[i] != 0) {
+	    i = (i + 1) & mask;
+	}
+	s->name_slots[i] = n + 1;
+    }
+}
+
+// Return the handle of the text name in s,
+// adding a copy of it to s if it is not already there
+ast_name ast_store_name(ast_store *s, const char *name)
+{
+    if (2 * ((size_t) s->name_count + 1) > s->name_slot_count) {
+	grow_name_slots(s);
+    }
+    uint32_t mask = s->name_slot_count - 1;
+    uint32_t slot = hash_name(name) & mask;
+    for (; s->name_slots[slot] != 0; slot = (slot + 1) & mask) {
+	if (strcmp(s->names + s->name_slots[slot] - 1, name) == 0) {
+	    return s->name_slots[slot] - 1;
+	}
+    }
+    size_t len = strlen(name) + 1;
+    if (len > s->names_capacity - s->names_size) {
+	size_t cap = (s->names_capacity == 0) ? 4096 : s->names_capacity;
+	while (len > cap - s->names_size) {
+	    cap *= 2;
+	}
+	s->names = grow(s->names, cap, 1);
+	s->names_capacity = (uint32_t) cap;
+    }
+    ast_name ret = s->names_size;
+    memcpy(s->names + ret, name, len);
+    s->names_size += (uint32_t) len;
+    s->name_slots[slot] = ret + 1;
+    s->name_count++;
+    return ret;
+}
+
+// Start a new list in s and return its mark
+ast_list_mark ast_store_list_start(ast_store *s)
+{
+    return s->pending_count;
+}
+
+// Add the node r to the list of s that was started last
+void ast_store_list_add(ast_store *s, ast_ref r)
+{
+    if (s->pending_count == s->pending_capacity) {
+	size_t cap = next_capacity(s->pending_capacity);
+	s->pending = grow(s->pending, cap, sizeof(ast_ref));
+	s->pending_capacity = (uint32_t) cap;
+    }
+    s->pending[s->pending_count++] = r;
+}
+
+// End the list with the given mark, moving its elements
+// to the list array, and return their range
+ast_range ast_store_list_end(ast_store *s, ast_list_mark mark)
+{
+    ast_range ret;
+    ret.first = s->list_count;
+    ret.count = s->pending_count - mark;
+    if (ret.count > s->list_capacity - s->list_count) {
+	size_t cap = next_capacity(s->list_capacity);
+	while (ret.count > cap - s->list_count) {
+	    cap *= 2;
+	}
+	s->lists = grow(s->lists, cap, sizeof(ast_ref));
+	s->list_capacity = (uint32_t) cap;
+    }
+    memcpy(s->lists + ret.first, s->pending + mark,
+	   ret.count * sizeof(ast_ref));
+    s->list_count += ret.count;
+    s->pending_count = mark;
+    return ret;
+}
+
+// Add a block to s, ending its lists (the last started first)
+ast_ref ast_store_block(ast_store *s, file_location loc,
+			ast_list_mark const_decls, ast_list_mark var_decls,
+			ast_list_mark proc_decls, ast_ref stmt)
+{
+    ast_ref r = add_node(s, block_node, loc, 0);
+    set_list(s, block_node, r, AST_BLOCK_PROC_DECLS, proc_decls);
+    set_list(s, block_node, r, AST_BLOCK_VAR_DECLS, var_decls);
+    set_list(s, block_node, r, AST_BLOCK_CONST_DECLS, const_decls);
+    set(s, block_node, r, AST_BLOCK_STMT, stmt);
+    return r;
+}
+
+// Add a const decl to s
+ast_ref ast_store_const_decl(ast_store *s, file_location loc,
+			     ast_list_mark const_defs)
+{
+    ast_ref r = add_node(s, const_decl_node, loc, 0);
+    set_list(s, const_decl_node, r, AST_CONST_DECL_DEFS, const_defs);
+    return r;
+}
+
+// Add a const def to s
+ast_ref ast_store_const_def(ast_store *s, file_location loc,
+			    ast_name name, word_type value)
+{
+    ast_ref r = add_node(s, const_def_node, loc, 0);
+    set(s, const_def_node, r, AST_CONST_DEF_NAME, name);
+    set(s, const_def_node, r, AST_CONST_DEF_VALUE, (uint32_t) value);
+    return r;
+}
+
+// Add a var decl to s
+ast_ref ast_store_var_decl(ast_store *s, file_location loc,
+			   ast_list_mark idents)
+{
+    ast_ref r = add_node(s, var_decl_node, loc, 0);
+    set_list(s, var_decl_node, r, AST_VAR_DECL_IDENTS, idents);
+    return r;
+}
+
+// Add an ident to s
+ast_ref ast_store_ident(ast_store *s, file_location loc, ast_name name)
+{
+    ast_ref r = add_node(s, ident_node, loc, 0);
+    set(s, ident_node, r, AST_IDENT_NAME, name);
+    return r;
+}
+
+// Add a proc decl to s
+ast_ref ast_store_proc_decl(ast_store *s, file_location loc,
+			    ast_name name, ast_ref block)
+{
+    ast_ref r = add_node(s, proc_decl_node, loc, 0);
+    set(s, proc_decl_node, r, AST_PROC_DECL_NAME, name);
+    set(s, proc_decl_node, r, AST_PROC_DECL_BLOCK, block);
+    return r;
+}
+
+// Add an assignment statement to s
+ast_ref ast_store_assign_stmt(ast_store *s, file_location loc,
+			      ast_name name, ast_ref expr)
+{
+    ast_ref r = add_node(s, stmt_node, loc, assign_stmt);
+    set(s, stmt_node, r, AST_STMT_NAME, name);
+    set(s, stmt_node, r, AST_STMT_EXPR, expr);
+    return r;
+}
+
+// Add a call statement to s
+ast_ref ast_store_call_stmt(ast_store *s, file_location loc, ast_name name)
+{
+    ast_ref r = add_node(s, stmt_node, loc, call_stmt);
+    set(s, stmt_node, r, AST_STMT_NAME, name);
+    return r;
+}
+
+// Add a begin statement to s
+ast_ref ast_store_begin_stmt(ast_store *s, file_location loc,
+			     ast_list_mark stmts)
+{
+    ast_ref r = add_node(s, stmt_node, loc, begin_stmt);
+    set_list(s, stmt_node, r, AST_STMT_STMTS, stmts);
+    return r;
+}
+
+// Add an if statement to s
+ast_ref ast_store_if_stmt(ast_store *s, file_location loc,
+			  ast_ref condition, ast_ref then_stmt,
+			  ast_ref else_stmt)
+{
+    ast_ref r = add_node(s, stmt_node, loc, if_stmt);
+    set(s, stmt_node, r, AST_STMT_CONDITION, condition);
+    set(s, stmt_node, r, AST_STMT_THEN, then_stmt);
+    set(s, stmt_node, r, AST_STMT_ELSE, else_stmt);
+    return r;
+}
+
+// Add a while statement to s
+ast_ref ast_store_while_stmt(ast_store *s, file_location loc,
+			     ast_ref condition, ast_ref body)
+{
+    ast_ref r = add_node(s, stmt_node, loc, while_stmt);
+    set(s, stmt_node, r, AST_STMT_CONDITION, condition);
+    set(s, stmt_node, r, AST_STMT_BODY, body);
+    return r;
+}
+
+// Add a read statement to s
+ast_ref ast_store_read_stmt(ast_store *s, file_location loc, ast_name name)
+{
+    ast_ref r = add_node(s, stmt_node, loc, read_stmt);
+    set(s, stmt_node, r, AST_STMT_NAME, name);
+    return r;
+}
+
+// Add a write statement to s
+ast_ref ast_store_write_stmt(ast_store *s, file_location loc, ast_ref expr)
+{
+    ast_ref r = add_node(s, stmt_node, loc, write_stmt);
+    set(s, stmt_node, r, AST_WRITE_STMT_EXPR, expr);
+    return r;
+}
+
+// Add a skip statement to s
+ast_ref ast_store_skip_stmt(ast_store *s, file_location loc)
+{
+    return add_node(s, stmt_node, loc, skip_stmt);
+}
+
+// Add an odd condition to s
+ast_ref ast_store_odd_condition(ast_store *s, file_location loc,
+				ast_ref expr)
+{
+    ast_ref r = add_node(s, condition_node, loc, ck_odd);
+    set(s, condition_node, r, AST_EXPR1, expr);
+    return r;
+}
+
+// Add a relational condition to s
+ast_ref ast_store_rel_op_condition(ast_store *s, file_location loc,
+				   ast_ref expr1, int rel_op, ast_ref expr2)
+{
+    ast_ref r = add_node(s, condition_node, loc, ck_rel);
+    set(s, condition_node, r, AST_EXPR1, expr1);
+    set(s, condition_node, r, AST_OP, (uint32_t) rel_op);
+    set(s, condition_node, r, AST_EXPR2, expr2);
+    return r;
+}
+
+// Add a binary operator expression to s
+ast_ref ast_store_binary_op_expr(ast_store *s, file_location loc,
+				 ast_ref expr1, int arith_op, ast_ref expr2)
+{
+    ast_ref r = add_node(s, expr_node, loc, expr_bin);
+    set(s, expr_node, r, AST_EXPR1, expr1);
+    set(s, expr_node, r, AST_OP, (uint32_t) arith_op);
+    set(s, expr_node, r, AST_EXPR2, expr2);
+    return r;
+}
+
+// Add an identifier expression to s
+ast_ref ast_store_ident_expr(ast_store *s, file_location loc,
+			     ast_name name)
+{
+    ast_ref r = add_node(s, expr_node, loc, expr_ident);
+    set(s, expr_node, r, AST_EXPR_NAME, name);
+    return r;
+}
+
+// Add a number expression to s
+ast_ref ast_store_number_expr(ast_store *s, file_location loc,
+			      word_type value)
+{
+    ast_ref r = add_node(s, expr_node, loc, expr_number);
+    set(s, expr_node, r, AST_EXPR_VALUE, (uint32_t) value);
+    return r;
+}
+
+static ast_ref add_stmt(ast_store *s, const stmt_t *st);
+
+// Add (a copy of) the linked AST of the expression e to s
+static ast_ref add_expr(ast_store *s, const expr_t *e)
+{
+    switch (e->expr_kind) {
+    case expr_bin: {
+	ast_ref e1 = add_expr(s, e->expr.binary.expr1);
+	ast_ref e2 = add_expr(s, e->expr.binary.expr2);
+	return ast_store_binary_op_expr(s, e->file_loc, e1,
+					e->expr.binary.arith_op.code, e2);
+    }
+    case expr_ident:
+	return ast_store_ident_expr(s, e->file_loc,
+				    ast_store_name(s, e->expr.ident.name));
+    default:
+	return ast_store_number_expr(s, e->file_loc, e->expr.number.value);
+    }
+}
+
+// Add (a copy of) the linked AST of the condition c to s
+static ast_ref add_condition(ast_store *s, const condition_t *c)
+{
+    if (c->cond_kind == ck_odd) {
+	return ast_store_odd_condition(s, c->file_loc,
+				       add_expr(s, &c->condition.odd_cond.expr));
+    }
+    const rel_op_condition_t *r = &c->condition.rel_op_cond;
+    ast_ref e1 = add_expr(s, &r->expr1);
+    ast_ref e2 = add_expr(s, &r->expr2);
+    return ast_store_rel_op_condition(s, c->file_loc, e1, r->rel_op.code, e2);
+}
+
+// Add (a copy of) the linked AST of the statement st to s
+static ast_ref add_stmt(ast_store *s, const stmt_t *st)
+{
+    switch (st->stmt_kind) {
+    case assign_stmt:
+	return ast_store_assign_stmt(s, st->file_loc,
+	    ast_store_name(s, st->stmt.assign_stmt.name),
+	    add_expr(s, st->stmt.assign_stmt.expr));
+    case call_stmt:
+	return ast_store_call_stmt(s, st->file_loc,
+				   ast_store_name(s, st->stmt.call_stmt.name));
+    case begin_stmt: {
+	ast_list_mark l = ast_store_list_start(s);
+	for (const stmt_t *b = st->stmt.begin_stmt.stmts.stmts; b != NULL;
+	     b = b->next) {
+	    ast_store_list_add(s, add_stmt(s, b));
+	}
+	return ast_store_begin_stmt(s, st->file_loc, l);
+    }
+    case if_stmt: {
+	ast_ref c = add_condition(s, &st->stmt.if_stmt.condition);
+	ast_ref t = add_stmt(s, st->stmt.if_stmt.then_stmt);
+	ast_ref e = add_stmt(s, st->stmt.if_stmt.else_stmt);
+	return ast_store_if_stmt(s, st->file_loc, c, t, e);
+    }
+    case while_stmt: {
+	ast_ref c = add_condition(s, &st->stmt.while_stmt.condition);
+	ast_ref b = add_stmt(s, st->stmt.while_stmt.body);
+	return ast_store_while_stmt(s, st->file_loc, c, b);
+    }
+    case read_stmt:
+	return ast_store_read_stmt(s, st->file_loc,
+				   ast_store_name(s, st->stmt.read_stmt.name));
+    case write_stmt:
+	return ast_store_write_stmt(s, st->file_loc,
+				    add_expr(s, &st->stmt.write_stmt.expr));
+    default:
+	return ast_store_skip_stmt(s, st->file_loc);
+    }
+}
+
+// Add (a copy of) the linked AST of the block b to s,
+// returning the handle of the block
+ast_ref ast_store_add_block(ast_store *s, const block_t *b)
+{
+    ast_list_mark consts = ast_store_list_start(s);
+    for (const const_decl_t *cd = b->const_decls.const_decls; cd != NULL;
+	 cd = cd->next) {
+	ast_list_mark defs = ast_store_list_start(s);
+	for (const const_def_t *d = cd->const_defs.const_defs; d != NULL;
+	     d = d->next) {
+	    ast_store_list_add(s, ast_store_const_def(s, d->file_loc,
+		ast_store_name(s, d->ident.name), d->number.value));
+	}
+	ast_store_list_add(s, ast_store_const_decl(s, cd->file_loc, defs));
+    }
+    ast_list_mark vars = ast_store_list_start(s);
+    for (const var_decl_t *vd = b->var_decls.var_decls; vd != NULL;
+	 vd = vd->next) {
+	ast_list_mark ids = ast_store_list_start(s);
+	for (const ident_t *id = vd->idents.idents; id != NULL;
+	     id = id->next) {
+	    ast_store_list_add(s, ast_store_ident(s, id->file_loc,
+						  ast_store_name(s, id->name)));
+	}
+	ast_store_list_add(s, ast_store_var_decl(s, vd->file_loc, ids));
+    }
+    ast_list_mark procs = ast_store_list_start(s);
+    for (const proc_decl_t *pd = b->proc_decls.proc_decls; pd != NULL;
+	 pd = pd->next) {
+	ast_ref block = ast_store_add_block(s, pd->block);
+	ast_store_list_add(s, ast_store_proc_decl(s, pd->file_loc,
+	    ast_store_name(s, pd->name), block));
+    }
+    ast_ref stmt = add_stmt(s, &b->stmt);
+    return ast_store_block(s, b->file_loc, consts, vars, procs, stmt);
+}
+
+// A node waiting to be visited in a walk
+typedef struct {
+    ast_store_kind kind;
+    ast_ref ref;
+} pending_node;
+
+// The nodes waiting to be visited in a walk, the next one last
+typedef struct {
+    pending_node *nodes;
+    size_t count;
+    size_t capacity;
+} walk_stack;
+
+// Push the node r of the given kind onto the stack w
+static void push(walk_stack *w, ast_store_kind kind, ast_ref r)
+{
+    if (w->count == w->capacity) {
+	w->capacity = (w->capacity == 0) ? 256 : 2 * w->capacity;
+	w->nodes = realloc(w->nodes, w->capacity * sizeof(pending_node));
+	if (w->nodes == NULL) {
+	    bail_with_error("Cannot allocate space to walk an AST store!");
+	}
+    }
+    w->nodes[w->count].kind = kind;
+    w->nodes[w->count].ref = r;
+    w->count++;
+}
+
+// Push the nodes of the given kind in the list range onto w,
+// the last first (so that the first is visited first)
+static void push_list(walk_stack *w, const ast_store *s,
+		      ast_store_kind kind, ast_range range)
+{
+    const ast_ref *elems = ast_store_list(s, range);
+    for (uint32_t i = range.count; i > 0; i--) {
+	push(w, kind, elems[i - 1]);
+    }
+}
+
+// Push the children of the node r of the given kind onto w,
+// the last first
+static void push_children(walk_stack *w, const ast_store *s,
+			  ast_store_kind kind, ast_ref r)
+{
+    switch (kind) {
+    case block_node:
+	push(w, stmt_node, AST_STORE_FIELD(s, kind, r, AST_BLOCK_STMT));
+	push_list(w, s, proc_decl_node,
+		  ast_store_range(s, kind, r, AST_BLOCK_PROC_DECLS));
+	push_list(w, s, var_decl_node,
+		  ast_store_range(s, kind, r, AST_BLOCK_VAR_DECLS));
+	push_list(w, s, const_decl_node,
+		  ast_store_range(s, kind, r, AST_BLOCK_CONST_DECLS));
+	break;
+    case const_decl_node:
+	push_list(w, s, const_def_node,
+		  ast_store_range(s, kind, r, AST_CONST_DECL_DEFS));
+	break;
+    case var_decl_node:
+	push_list(w, s, ident_node,
+		  ast_store_range(s, kind, r, AST_VAR_DECL_IDENTS));
+	break;
+    case proc_decl_node:
+	push(w, block_node,
+	     AST_STORE_FIELD(s, kind, r, AST_PROC_DECL_BLOCK));
+	break;
+    case stmt_node:
+	switch (AST_STORE_TAG(s, kind, r)) {
+	case assign_stmt:
+	    push(w, expr_node, AST_STORE_FIELD(s, kind, r, AST_STMT_EXPR));
+	    break;
+	case begin_stmt:
+	    push_list(w, s, stmt_node,
+		      ast_store_range(s, kind, r, AST_STMT_STMTS));
+	    break;
+	case if_stmt:
+	    push(w, stmt_node, AST_STORE_FIELD(s, kind, r, AST_STMT_ELSE));
+	    push(w, stmt_node, AST_STORE_FIELD(s, kind, r, AST_STMT_THEN));
+	    push(w, condition_node,
+		 AST_STORE_FIELD(s, kind, r, AST_STMT_CONDITION));
+	    break;
+	case while_stmt:
+	    push(w, stmt_node, AST_STORE_FIELD(s, kind, r, AST_STMT_BODY));
+	    push(w, condition_node,
+		 AST_STORE_FIELD(s, kind, r, AST_STMT_CONDITION));
+	    break;
+	case write_stmt:
+	    push(w, expr_node,
+		 AST_STORE_FIELD(s, kind, r, AST_WRITE_STMT_EXPR));
+	    break;
+	default:
+	    break;
+	}
+	break;
+    case condition_node:
+	if (AST_STORE_TAG(s, kind, r) == ck_rel) {
+	    push(w, expr_node, AST_STORE_FIELD(s, kind, r, AST_EXPR2));
+	}
+	push(w, expr_node, AST_STORE_FIELD(s, kind, r, AST_EXPR1));
+	break;
+    case expr_node:
+	if (AST_STORE_TAG(s, kind, r) == expr_bin) {
+	    push(w, expr_node, AST_STORE_FIELD(s, kind, r, AST_EXPR2));
+	    push(w, expr_node, AST_STORE_FIELD(s, kind, r, AST_EXPR1));
+	}
+	break;
+    default:
+	break;
+    }
+}
+
+// Visit the node r of the given kind and (unless the visitor says not
+// to) all its descendants, in preorder
+void ast_store_walk(const ast_store *s, ast_store_kind kind, ast_ref r,
+		    ast_store_visitor visit, void *arg)
+{
+    walk_stack w = { NULL, 0, 0 };
+    push(&w, kind, r);
+    while (w.count > 0) {
+	pending_node n = w.nodes[--w.count];
+	if (visit(arg, s, n.kind, n.ref)) {
+	    push_children(&w, s, n.kind, n.ref);
+	}
+    }
+    free(w.nodes);
+}
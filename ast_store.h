@@ -0,0 +1,244 @@
+#ifndef _AST_STORE_H
+#define _AST_STORE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ast.h"
+
+// An AST store holds a program's ASTs in a compact form, as an
+// alternative to the linked structs of ast.h for passes that walk
+// the program many times. The nodes of each kind are kept in arrays,
+// one array for each field (structure of arrays), so a node is named
+// by a 32-bit handle, its index in its kind's arrays. A node's
+// children are handles, or, for lists, ranges of handles that are
+// contiguous in the store's list array. Names are kept once each,
+// in the store's name text, and named by their offsets in it.
+//
+// The builder functions build the nodes bottom-up, in the order in
+// which the parser's actions reduce them, and so can be called from
+// those actions instead of the ast_ constructors. A list is built by
+// starting it (which gives its mark), adding each element, and then
+// passing its mark to the function that makes the node holding it
+// (which ends the list). Elements are always added to the list that
+// was started last and is not yet ended, and a node holding several
+// lists (a block) ends them all; so lists must be started in the
+// order that the grammar gives their elements, as the parser does.
+
+// A handle of a node of a given kind (its index in that kind's arrays)
+typedef uint32_t ast_ref;
+
+// The handle of no node
+#define AST_REF_NONE UINT32_MAX
+
+// A handle of a name (the offset of its text in the store's names)
+typedef uint32_t ast_name;
+
+// The mark of a list being built (see above)
+typedef uint32_t ast_list_mark;
+
+// The handles of the elements of a list,
+// which are count handles at first in the store's list array
+typedef struct {
+    uint32_t first;
+    uint32_t count;
+} ast_range;
+
+// The kinds of nodes, each kept in its own arrays
+typedef enum {
+    block_node, const_decl_node, const_def_node,
+    var_decl_node, ident_node, proc_decl_node,
+    stmt_node, condition_node, expr_node
+} ast_store_kind;
+
+// The number of kinds of nodes
+#define AST_STORE_KINDS 9
+
+// The fields of each kind of node, by index; a range takes two
+// fields (its first and count) and a token is kept as its code.
+// Statements, conditions and expressions also have a tag,
+// which is their stmt_kind_e, condition_kind_e or expr_kind_e.
+#define AST_STORE_MAX_FIELDS 7
+// block: the const decls, var decls and proc decls (ranges) and stmt
+#define AST_BLOCK_CONST_DECLS 0
+#define AST_BLOCK_VAR_DECLS 2
+#define AST_BLOCK_PROC_DECLS 4
+#define AST_BLOCK_STMT 6
+// const decl: its const defs (a range)
+#define AST_CONST_DECL_DEFS 0
+// const def: the name and the value (a word_type)
+#define AST_CONST_DEF_NAME 0
+#define AST_CONST_DEF_VALUE 1
+// var decl: its idents (a range)
+#define AST_VAR_DECL_IDENTS 0
+// ident: the name
+#define AST_IDENT_NAME 0
+// proc decl: the name and the block
+#define AST_PROC_DECL_NAME 0
+#define AST_PROC_DECL_BLOCK 1
+// statements: assign (name, expr), call (name), begin (stmts, a range),
+// if (condition, then stmt, else stmt), while (condition, body),
+// read (name), write (expr), skip (none)
+#define AST_STMT_NAME 0
+#define AST_STMT_EXPR 1
+#define AST_STMT_STMTS 0
+#define AST_STMT_CONDITION 0
+#define AST_STMT_THEN 1
+#define AST_STMT_ELSE 2
+#define AST_STMT_BODY 1
+#define AST_WRITE_STMT_EXPR 0
+// conditions: odd (expr), rel (expr1, rel op, expr2)
+// expressions: bin (expr1, arith op, expr2), ident (name),
+// number (value, a word_type)
+#define AST_EXPR1 0
+#define AST_OP 1
+#define AST_EXPR2 2
+#define AST_EXPR_NAME 0
+#define AST_EXPR_VALUE 0
+
+// The nodes of one kind: for each field used by the kind, an array
+// of that field of each node
+typedef struct {
+    uint32_t count;
+    uint32_t capacity;
+    uint8_t *tag;
+    file_location *loc;
+    uint32_t *field[AST_STORE_MAX_FIELDS];
+} ast_store_table;
+
+typedef struct {
+    ast_store_table tables[AST_STORE_KINDS];
+    ast_ref *lists;        // the elements of all ended lists
+    uint32_t list_count;
+    uint32_t list_capacity;
+    ast_ref *pending;      // the elements of the lists being built
+    uint32_t pending_count;
+    uint32_t pending_capacity;
+    char *names;           // the names, each null-terminated
+    uint32_t names_size;
+    uint32_t names_capacity;
+    uint32_t *name_slots;  // open-addressing hash table of the names'
+    uint32_t name_count;   // handles (plus one, so 0 marks an empty slot),
+    uint32_t name_slot_count;  // whose size is a power of 2
+} ast_store;
+
+// Access the fields of the node r of the given kind in the store s
+// (these are macros, as the walks of analysis passes use them most)
+#define AST_STORE_FIELD(s, kind, r, i) ((s)->tables[kind].field[i][r])
+#define AST_STORE_TAG(s, kind, r) ((s)->tables[kind].tag[r])
+#define AST_STORE_LOC(s, kind, r) ((s)->tables[kind].loc[r])
+
+// Requires: s != NULL
+// Initialize s as an empty store
+extern void ast_store_init(ast_store *s);
+
+// Requires: s was initialized by ast_store_init
+// Free all the memory of s, leaving it empty
+extern void ast_store_free(ast_store *s);
+
+// Return the number of bytes of memory that s holds
+extern size_t ast_store_bytes(const ast_store *s);
+
+// Return the number of nodes in s
+extern size_t ast_store_node_count(const ast_store *s);
+
+// Return the number of nodes of the given kind in s
+extern uint32_t ast_store_count(const ast_store *s, ast_store_kind kind);
+
+// Return the number of fields of the given kind of node
+extern int ast_store_field_count(ast_store_kind kind);
+
+// Do the nodes of the given kind have tags?
+extern bool ast_store_has_tag(ast_store_kind kind);
+
+// Return the range held in fields i and i+1 of node r of the given kind
+extern ast_range ast_store_range(const ast_store *s, ast_store_kind kind,
+				 ast_ref r, int i);
+
+// Return a pointer to the range.count handles of the list range
+extern const ast_ref *ast_store_list(const ast_store *s, ast_range range);
+
+// Requires: name was returned by ast_store_name for s
+// Return the text of name
+extern const char *ast_store_name_text(const ast_store *s, ast_name name);
+
+// Return the handle of the text name in s,
+// adding a copy of it to s if it is not already there
+extern ast_name ast_store_name(ast_store *s, const char *name);
+
+// Start a new list in s and return its mark
+extern ast_list_mark ast_store_list_start(ast_store *s);
+
+// Add the node r to the list of s that was started last
+extern void ast_store_list_add(ast_store *s, ast_ref r);
+
+// Requires: mark is that of the list started last that is not ended
+// End that list, moving its elements to the list array
+// (from which they are never removed), and return their range
+extern ast_range ast_store_list_end(ast_store *s, ast_list_mark mark);
+
+// The builder functions: each adds a node of the given kind to s
+// and returns its handle; a mark is that of a list, which is ended
+
+extern ast_ref ast_store_block(ast_store *s, file_location loc,
+			       ast_list_mark const_decls,
+			       ast_list_mark var_decls,
+			       ast_list_mark proc_decls, ast_ref stmt);
+extern ast_ref ast_store_const_decl(ast_store *s, file_location loc,
+				    ast_list_mark const_defs);
+extern ast_ref ast_store_const_def(ast_store *s, file_location loc,
+				   ast_name name, word_type value);
+extern ast_ref ast_store_var_decl(ast_store *s, file_location loc,
+				  ast_list_mark idents);
+extern ast_ref ast_store_ident(ast_store *s, file_location loc,
+			       ast_name name);
+extern ast_ref ast_store_proc_decl(ast_store *s, file_location loc,
+				   ast_name name, ast_ref block);
+
+extern ast_ref ast_store_assign_stmt(ast_store *s, file_location loc,
+				     ast_name name, ast_ref expr);
+extern ast_ref ast_store_call_stmt(ast_store *s, file_location loc,
+				   ast_name name);
+extern ast_ref ast_store_begin_stmt(ast_store *s, file_location loc,
+				    ast_list_mark stmts);
+extern ast_ref ast_store_if_stmt(ast_store *s, file_location loc,
+				 ast_ref condition, ast_ref then_stmt,
+				 ast_ref else_stmt);
+extern ast_ref ast_store_while_stmt(ast_store *s, file_location loc,
+				    ast_ref condition, ast_ref body);
+extern ast_ref ast_store_read_stmt(ast_store *s, file_location loc,
+				   ast_name name);
+extern ast_ref ast_store_write_stmt(ast_store *s, file_location loc,
+				    ast_ref expr);
+extern ast_ref ast_store_skip_stmt(ast_store *s, file_location loc);
+
+extern ast_ref ast_store_odd_condition(ast_store *s, file_location loc,
+				       ast_ref expr);
+extern ast_ref ast_store_rel_op_condition(ast_store *s, file_location loc,
+					  ast_ref expr1, int rel_op,
+					  ast_ref expr2);
+
+extern ast_ref ast_store_binary_op_expr(ast_store *s, file_location loc,
+					ast_ref expr1, int arith_op,
+					ast_ref expr2);
+extern ast_ref ast_store_ident_expr(ast_store *s, file_location loc,
+				    ast_name name);
+extern ast_ref ast_store_number_expr(ast_store *s, file_location loc,
+				     word_type value);
+
+// Requires: b != NULL, and no list of s is being built
+// Add (a copy of) the linked AST of the block b to s,
+// returning the handle of the block
+extern ast_ref ast_store_add_block(ast_store *s, const block_t *b);
+
+// A function called for each node of a walk, with the walk's arg;
+// it returns whether the walk goes on into the node's children
+typedef bool (*ast_store_visitor)(void *arg, const ast_store *s,
+				  ast_store_kind kind, ast_ref r);
+
+// Visit the node r of the given kind and (unless the visitor says not
+// to) all its descendants, in preorder, each node before its children
+// and children in the order of the program's text
+extern void ast_store_walk(const ast_store *s, ast_store_kind kind,
+			   ast_ref r, ast_store_visitor visit, void *arg);
+
+#endif
@@ -0,0 +1,189 @@
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "utilities.h"
+#include "compressor.h"
+
+// the size of the buffer for compressed output
+#define OUT_SIZE (1 << 16)
+
+// the window bits for deflateInit2 that ask for a gzip wrapper
+#define GZIP_WINDOW_BITS (15 + 16)
+
+static pthread_t thread;
+static bool running = false;
+
+// lock protects the fields below it, and changed is signalled
+// whenever one of them changes
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t changed = PTHREAD_COND_INITIALIZER;
+static const char *pending = NULL;  // the block being compressed (or NULL)
+static size_t pending_len = 0;
+static bool finishing = false;      // are no more blocks coming?
+static const char *failure = NULL;  // why the compressor stopped (or NULL)
+static int failure_errno = 0;
+
+// used only by the compressor thread
+static z_stream stream;
+static int out_fd;
+static unsigned char out[OUT_SIZE];
+
+// Write the len bytes at s to out_fd, retrying after
+// partial writes and interrupts, and return NULL
+// or a message saying why they could not be written
+static const char *write_out(const unsigned char *s, size_t len)
+{
+    while (len > 0) {
+	ssize_t n = write(out_fd, s, len);
+	if (n < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    return "Cannot write the compressed output!";
+	}
+	s += n;
+	len -= (size_t) n;
+    }
+    return NULL;
+}
+
+// Compress the len chars at s, with the given deflate flush mode,
+// writing out the compressed output as it is made, and return NULL
+// or a message saying why that could not be done
+static const char *compress_block(const char *s, size_t len, int flush)
+{
+    stream.next_in = (Bytef *) s;
+    stream.avail_in = (uInt) len;
+    int ret;
+    do {
+	stream.next_out = out;
+	stream.avail_out = OUT_SIZE;
+	ret = deflate(&stream, flush);
+	if (ret == Z_STREAM_ERROR) {
+	    return "Cannot compress the output!";
+	}
+	const char *msg = write_out(out, OUT_SIZE - stream.avail_out);
+	if (msg != NULL) {
+	    return msg;
+	}
+    } while (stream.avail_out == 0
+	     || (flush == Z_FINISH && ret != Z_STREAM_END));
+    return NULL;
+}
+
+// Requires: lock is held
+// Note that the compressor failed for the reason msg (if not NULL),
+// when errno was err, so it takes no more blocks
+static void note_failure(const char *msg, int err)
+{
+    if (msg != NULL && failure == NULL) {
+	failure = msg;
+	failure_errno = err;
+	pending = NULL;
+	pthread_cond_broadcast(&changed);
+    }
+}
+
+// Requires: the compressor thread has failed
+// Report why it failed and exit
+static void bail_with_failure()
+{
+    running = false;
+    errno = failure_errno;
+    bail_with_error("%s", failure);
+}
+
+// The compressor thread: compress each block given until finishing
+static void *compress_blocks(void *arg)
+{
+    pthread_mutex_lock(&lock);
+    for (;;) {
+	while (pending == NULL && !finishing) {
+	    pthread_cond_wait(&changed, &lock);
+	}
+	if (pending == NULL) {
+	    break;
+	}
+	const char *block = pending;
+	size_t len = pending_len;
+	pthread_mutex_unlock(&lock);
+	const char *msg = compress_block(block, len, Z_NO_FLUSH);
+	int err = errno;
+	pthread_mutex_lock(&lock);
+	if (msg != NULL) {
+	    note_failure(msg, err);
+	    pthread_mutex_unlock(&lock);
+	    deflateEnd(&stream);
+	    return NULL;
+	}
+	pending = NULL;
+	pthread_cond_broadcast(&changed);
+    }
+    pthread_mutex_unlock(&lock);
+    const char *msg = compress_block(NULL, 0, Z_FINISH);
+    int err = errno;
+    deflateEnd(&stream);
+    pthread_mutex_lock(&lock);
+    note_failure(msg, err);
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+// Start the compressor thread, writing to fd at the given level
+void compressor_start(int fd, int level)
+{
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    if (deflateInit2(&stream, level, Z_DEFLATED, GZIP_WINDOW_BITS,
+		     8, Z_DEFAULT_STRATEGY) != Z_OK) {
+	bail_with_error("Cannot start compressing the output!");
+    }
+    out_fd = fd;
+    pending = NULL;
+    finishing = false;
+    failure = NULL;
+    if (pthread_create(&thread, NULL, compress_blocks, NULL) != 0) {
+	bail_with_error("Cannot start the compressor thread!");
+    }
+    running = true;
+}
+
+// Is the compressor running?
+bool compressor_running()
+{
+    return running;
+}
+
+// Give the len chars at block to the compressor
+void compressor_submit(const char *block, size_t len)
+{
+    pthread_mutex_lock(&lock);
+    while (pending != NULL && failure == NULL) {
+	pthread_cond_wait(&changed, &lock);
+    }
+    if (failure != NULL) {
+	pthread_mutex_unlock(&lock);
+	bail_with_failure();
+    }
+    pending = block;
+    pending_len = len;
+    pthread_cond_broadcast(&changed);
+    pthread_mutex_unlock(&lock);
+}
+
+// Compress the rest, end the gzip stream and stop the thread
+void compressor_finish()
+{
+    pthread_mutex_lock(&lock);
+    finishing = true;
+    pthread_cond_broadcast(&changed);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+    running = false;
+    if (failure != NULL) {
+	bail_with_failure();
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef _COMPRESSOR_H
+#define _COMPRESSOR_H
+#include <stdbool.h>
+#include <stddef.h>
+
+// The compressor gzips blocks of output on a thread of its own
+// and writes the result to a file descriptor.
+// It holds at most one block: submitting a block waits only
+// while the compressor is still working on the previous one,
+// so a producer that alternates between two buffers is only held up
+// when both are full.
+
+// The least and greatest compression levels (as for gzip)
+#define COMPRESSOR_MIN_LEVEL 0
+#define COMPRESSOR_MAX_LEVEL 9
+
+// Requires: COMPRESSOR_MIN_LEVEL <= level <= COMPRESSOR_MAX_LEVEL
+//           and the compressor is not running
+// Start the compressor thread, which writes a gzip stream
+// compressed at the given level to the file descriptor fd
+extern void compressor_start(int fd, int level);
+
+// Is the compressor running?
+extern bool compressor_running();
+
+// Requires: the compressor is running and block has len chars
+// Give the block to the compressor, first waiting until it is done
+// with the block given before; block must not change until the next
+// call of compressor_submit or compressor_finish returns
+extern void compressor_submit(const char *block, size_t len);
+
+// Requires: the compressor is running
+// Compress the blocks given so far, end the gzip stream
+// and stop the compressor thread
+extern void compressor_finish();
+
+#endif
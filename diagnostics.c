@@ -0,0 +1,525 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "utilities.h"
+#include "lexer.h"
+#include "token_writer.h"
+#include "diagnostics.h"
+
+// the message that takes the place of those beyond the limit
+#define TOO_MANY "too many errors, the rest are not shown"
+
+// the version of SARIF written
+#define SARIF_VERSION "2.1.0"
+#define SARIF_SCHEMA "https://json.schemastore.org/sarif-2.1.0.json"
+
+// The code, name and description of each kind of error
+static const struct {
+    const char *code;
+    const char *name;
+    const char *description;
+} kinds[] = {
+    [diagnostic_other] = { "PL0000", "Error",
+	"An error not found by the lexer's own checks" },
+    [diagnostic_invalid_char] = { "PL0001", "InvalidCharacter",
+	"An ASCII character that cannot start a token" },
+    [diagnostic_invalid_utf8] = { "PL0002", "InvalidUtf8",
+	"A malformed UTF-8 byte sequence" },
+    [diagnostic_non_ascii] = { "PL0003", "NonAsciiCharacter",
+	"Non-ASCII characters outside a comment" },
+    [diagnostic_number_too_large] = { "PL0004", "NumberTooLarge",
+	"A number too large to be represented" },
+    [diagnostic_identifier_too_long] = { "PL0005", "IdentifierTooLong",
+	"An identifier longer than the lexeme limit" },
+    [diagnostic_number_too_long] = { "PL0006", "NumberTooLong",
+	"A number longer than the lexeme limit" },
+};
+
+// the number of kinds of errors
+#define KINDS (sizeof(kinds) / sizeof(kinds[0]))
+
+// A message kept in memory; its texts are in the arena
+typedef struct {
+    size_t position;    // in the token writer's output
+    size_t start;       // of its "file:line: message" line (text format)
+    size_t len;         // or of its message (SARIF and JSON formats)
+    size_t text_start;  // of the text it is about (SARIF and JSON formats)
+    size_t text_len;
+    size_t file;        // its file's number
+    unsigned int line;
+    size_t offset;
+    diagnostic_kind kind;
+} diagnostic;
+
+// the texts of the messages kept, one after another
+static char *arena = NULL;
+static size_t arena_used = 0;
+static size_t arena_capacity = 0;
+
+// the messages kept
+static diagnostic *kept = NULL;
+static size_t kept_count = 0;
+static size_t kept_capacity = 0;
+
+static size_t max_per_file = 0;
+static bool deduplicate = false;
+static bool sorted = false;
+static diagnostics_format format = diagnostics_text;
+
+// are the messages held until diagnostics_finish?
+static bool held = false;
+
+// the names of the files seen, in order; messages are for the last one
+static char **files = NULL;
+static size_t file_count = 0;
+static size_t file_capacity = 0;
+static size_t file_messages = 0;  // count of messages for the last file
+
+// the hashes of the messages seen (for dropping duplicates),
+// in an open addressing table whose size is a power of 2 (0: empty)
+static uint64_t *seen = NULL;
+static size_t seen_count = 0;
+static size_t seen_slots = 0;
+
+// Return the stable code of the kind of error
+const char *diagnostic_code(diagnostic_kind kind)
+{
+    return kinds[kind].code;
+}
+
+// Note whether the messages are held, writing them out at exit if so
+static void set_held()
+{
+    bool hold = format == diagnostics_sarif || format == diagnostics_json
+	|| (sorted && format == diagnostics_text);
+    if (hold && !held) {
+	atexit(diagnostics_finish);
+    }
+    held = hold;
+}
+
+// Set how errors are reported
+void diagnostics_configure(size_t max, bool dedup, bool sort)
+{
+    max_per_file = max;
+    deduplicate = dedup;
+    sorted = sort;
+    set_held();
+}
+
+// Set the form in which the messages are written
+void diagnostics_set_format(diagnostics_format f)
+{
+    format = f;
+    set_held();
+}
+
+// Note that the file named fname is being lexed
+void diagnostics_begin_file(const char *fname)
+{
+    assert(fname != NULL);
+    if (format == diagnostics_none) {
+	return;
+    }
+    if (file_count > 0 && strcmp(files[file_count-1], fname) == 0) {
+	return;
+    }
+    if (file_count == file_capacity) {
+	file_capacity = (file_capacity == 0) ? 16 : 2 * file_capacity;
+	files = realloc(files, file_capacity * sizeof(char *));
+	if (files == NULL) {
+	    bail_with_error("Cannot allocate space for error messages!");
+	}
+    }
+    files[file_count] = strdup(fname);
+    if (files[file_count] == NULL) {
+	bail_with_error("Cannot allocate space for error messages!");
+    }
+    file_count++;
+    file_messages = 0;
+}
+
+// Return the 64-bit FNV-1a hash of the len chars at p,
+// continuing from the hash h of the chars before them
+static uint64_t hash_chars(uint64_t h, const void *p, size_t len)
+{
+    const unsigned char *s = p;
+    for (size_t i = 0; i < len; i++) {
+	h = (h ^ s[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Add h to the table of messages seen, returning false
+// if it was already there
+static bool note_seen(uint64_t h)
+{
+    if (h == 0) {
+	h = 1;
+    }
+    if (2 * (seen_count + 1) > seen_slots) {
+	size_t slots = (seen_slots == 0) ? 256 : 2 * seen_slots;
+	uint64_t *table = calloc(slots, sizeof(uint64_t));
+	if (table == NULL) {
+	    bail_with_error("Cannot allocate space for error messages!");
+	}
+	for (size_t i = 0; i < seen_slots; i++) {
+	    if (seen[i] != 0) {
+		size_t j = (size_t) seen[i] & (slots - 1);
+		while (table[j] != 0) {
+		    j = (j + 1) & (slots - 1);
+		}
+		table[j] = seen[i];
+	    }
+	}
+	free(seen);
+	seen = table;
+	seen_slots = slots;
+    }
+    size_t j = (size_t) h & (seen_slots - 1);
+    while (seen[j] != 0) {
+	if (seen[j] == h) {
+	    return false;
+	}
+	j = (j + 1) & (seen_slots - 1);
+    }
+    seen[j] = h;
+    seen_count++;
+    return true;
+}
+
+// Make the arena have room for at least n more chars
+static void arena_reserve(size_t n)
+{
+    if (arena_used + n <= arena_capacity) {
+	return;
+    }
+    size_t cap = (arena_capacity == 0) ? 4096 : 2 * arena_capacity;
+    while (cap < arena_used + n) {
+	cap *= 2;
+    }
+    arena = realloc(arena, cap);
+    if (arena == NULL) {
+	bail_with_error("Cannot allocate space for error messages!");
+    }
+    arena_capacity = cap;
+}
+
+// Add the len chars at s to the arena, returning where they start
+static size_t arena_add(const char *s, size_t len)
+{
+    arena_reserve(len);
+    size_t start = arena_used;
+    memcpy(arena + start, s, len);
+    arena_used += len;
+    return start;
+}
+
+// Keep the message msg (of the given kind) about the len chars at text,
+// at the given line and offset of the last file
+static void keep(diagnostic_kind kind, unsigned int line, size_t offset,
+		 const char *text, size_t len, const char *msg)
+{
+    if (kept_count == kept_capacity) {
+	kept_capacity = (kept_capacity == 0) ? 64 : 2 * kept_capacity;
+	kept = realloc(kept, kept_capacity * sizeof(diagnostic));
+	if (kept == NULL) {
+	    bail_with_error("Cannot allocate space for error messages!");
+	}
+    }
+    diagnostic *d = &kept[kept_count++];
+    d->position = token_writer_position();
+    d->file = file_count - 1;
+    d->line = line;
+    d->offset = offset;
+    d->kind = kind;
+    if (format == diagnostics_text) {
+	const char *fname = files[d->file];
+	int n = snprintf(NULL, 0, "%s:%u: %s\n", fname, line, msg);
+	arena_reserve((size_t) n + 1);
+	snprintf(arena + arena_used, (size_t) n + 1, "%s:%u: %s\n",
+		 fname, line, msg);
+	d->start = arena_used;
+	d->len = (size_t) n;
+	arena_used += (size_t) n;
+	d->text_start = d->text_len = 0;
+    } else {
+	d->len = strlen(msg);
+	d->start = arena_add(msg, d->len);
+	d->text_len = len;
+	d->text_start = arena_add(text, len);
+    }
+}
+
+// Note the error message msg about the text at the given line
+// and offset of fname
+void diagnostics_report(diagnostic_kind kind, const char *fname,
+			unsigned int line, size_t offset,
+			const char *text, size_t len, const char *msg)
+{
+    assert(fname != NULL && msg != NULL);
+    if (format == diagnostics_none) {
+	return;
+    }
+    diagnostics_begin_file(fname);
+    if (deduplicate) {
+	size_t file = file_count - 1;
+	uint64_t h = hash_chars(0xcbf29ce484222325ULL, &file, sizeof(file));
+	h = hash_chars(h, &line, sizeof(line));
+	if (!note_seen(hash_chars(h, msg, strlen(msg)))) {
+	    return;
+	}
+    }
+    if (max_per_file != 0 && file_messages >= max_per_file) {
+	if (file_messages == max_per_file) {
+	    keep(diagnostic_other, line, offset, NULL, 0, TOO_MANY);
+	    file_messages++;
+	}
+	return;
+    }
+    file_messages++;
+    keep(kind, line, offset, text, len, msg);
+}
+
+// Return the number of messages waiting to be written with the output
+size_t diagnostics_pending()
+{
+    return held ? 0 : kept_count;
+}
+
+// Return waiting message number i, setting *len and *position
+const char *diagnostics_pending_message(size_t i, size_t *len,
+				       size_t *position)
+{
+    *len = kept[i].len;
+    *position = kept[i].position;
+    return arena + kept[i].start;
+}
+
+// Return all the waiting messages, setting *len to their length
+const char *diagnostics_pending_text(size_t *len)
+{
+    *len = arena_used;
+    return arena;
+}
+
+// Forget the messages waiting
+void diagnostics_clear_pending()
+{
+    kept_count = 0;
+    arena_used = 0;
+}
+
+// Order diagnostics by file, then (if sorting) line and offset,
+// then when they were reported (for qsort)
+static int compare_diagnostics(const void *a, const void *b)
+{
+    const diagnostic *x = a;
+    const diagnostic *y = b;
+    if (x->file != y->file) {
+	return (x->file > y->file) - (x->file < y->file);
+    }
+    if (sorted && x->line != y->line) {
+	return (x->line > y->line) - (x->line < y->line);
+    }
+    if (sorted && x->offset != y->offset) {
+	return (x->offset > y->offset) - (x->offset < y->offset);
+    }
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+// The output being built by diagnostics_finish
+static char *out = NULL;
+static size_t out_used = 0;
+static size_t out_capacity = 0;
+
+// Make out have room for at least n more chars
+static void out_reserve(size_t n)
+{
+    if (out_used + n <= out_capacity) {
+	return;
+    }
+    size_t cap = (out_capacity == 0) ? 4096 : 2 * out_capacity;
+    while (cap < out_used + n) {
+	cap *= 2;
+    }
+    out = realloc(out, cap);
+    if (out == NULL) {
+	bail_with_error("Cannot allocate space for error messages!");
+    }
+    out_capacity = cap;
+}
+
+// Add the len chars at s to out
+static void out_put(const char *s, size_t len)
+{
+    out_reserve(len);
+    memcpy(out + out_used, s, len);
+    out_used += len;
+}
+
+// Add the string s to out
+static void out_puts(const char *s)
+{
+    out_put(s, strlen(s));
+}
+
+// Add the decimal form of n to out
+static void out_uint(size_t n)
+{
+    char digits[24];
+    out_put(digits, (size_t) snprintf(digits, sizeof(digits), "%zu", n));
+}
+
+// Add the len chars at s to out as a JSON string
+static void out_json(const char *s, size_t len)
+{
+    out_reserve(TOKEN_WRITER_MAX_ESCAPE * len + 2);
+    out[out_used++] = '"';
+    out_used = (size_t) (token_writer_json_escape(out + out_used, s, len)
+			 - out);
+    out[out_used++] = '"';
+}
+
+// Add the message d to out as a compact JSON object
+static void out_json_diagnostic(const diagnostic *d)
+{
+    out_puts("{\"code\":\"");
+    out_puts(kinds[d->kind].code);
+    out_puts("\",\"line\":");
+    out_uint(d->line);
+    out_puts(",\"offset\":");
+    out_uint(d->offset);
+    out_puts(",\"length\":");
+    out_uint(d->text_len);
+    out_puts(",\"text\":");
+    out_json(arena + d->text_start, d->text_len);
+    out_puts(",\"message\":");
+    out_json(arena + d->start, d->len);
+    out_puts("}");
+}
+
+// Add the messages kept to out as a compact JSON document:
+// {"files":[{"file":name,"diagnostics":[...]},...]}
+static void out_json_document()
+{
+    out_puts("{\"files\":[");
+    size_t i = 0;
+    for (size_t f = 0; f < file_count; f++) {
+	out_puts((f == 0) ? "{\"file\":" : ",{\"file\":");
+	out_json(files[f], strlen(files[f]));
+	out_puts(",\"diagnostics\":[");
+	for (bool first = true; i < kept_count && kept[i].file == f; i++) {
+	    if (!first) {
+		out_puts(",");
+	    }
+	    out_json_diagnostic(&kept[i]);
+	    first = false;
+	}
+	out_puts("]}");
+    }
+    out_puts("]}\n");
+}
+
+// Add the message d to out as a SARIF result
+static void out_sarif_result(const diagnostic *d)
+{
+    out_puts("{\"ruleId\":\"");
+    out_puts(kinds[d->kind].code);
+    out_puts("\",\"ruleIndex\":");
+    out_uint(d->kind);
+    out_puts(",\"level\":\"error\",\"message\":{\"text\":");
+    out_json(arena + d->start, d->len);
+    out_puts("},\"locations\":[{\"physicalLocation\":"
+	     "{\"artifactLocation\":{\"uri\":");
+    out_json(files[d->file], strlen(files[d->file]));
+    out_puts(",\"index\":");
+    out_uint(d->file);
+    out_puts("},\"region\":{\"startLine\":");
+    out_uint(d->line);
+    out_puts(",\"byteOffset\":");
+    out_uint(d->offset);
+    if (d->text_len > 0) {
+	out_puts(",\"byteLength\":");
+	out_uint(d->text_len);
+	out_puts(",\"snippet\":{\"text\":");
+	out_json(arena + d->text_start, d->text_len);
+	out_puts("}");
+    }
+    out_puts("}}}]}");
+}
+
+// Add the messages kept to out as a SARIF log with one run
+static void out_sarif_log()
+{
+    out_puts("{\"version\":\"" SARIF_VERSION "\",\"$schema\":\""
+	     SARIF_SCHEMA "\",\"runs\":[{\"tool\":{\"driver\":"
+	     "{\"name\":\"pl0-lexer\",\"version\":");
+    out_json(LEXER_SCANNER_VERSION, strlen(LEXER_SCANNER_VERSION));
+    out_puts(",\"rules\":[");
+    for (size_t k = 0; k < KINDS; k++) {
+	out_puts((k == 0) ? "{\"id\":\"" : ",{\"id\":\"");
+	out_puts(kinds[k].code);
+	out_puts("\",\"name\":\"");
+	out_puts(kinds[k].name);
+	out_puts("\",\"shortDescription\":{\"text\":");
+	out_json(kinds[k].description, strlen(kinds[k].description));
+	out_puts("}}");
+    }
+    out_puts("]}},\"artifacts\":[");
+    for (size_t f = 0; f < file_count; f++) {
+	out_puts((f == 0) ? "{\"location\":{\"uri\":"
+		 : ",{\"location\":{\"uri\":");
+	out_json(files[f], strlen(files[f]));
+	out_puts("}}");
+    }
+    out_puts("],\"results\":[");
+    for (size_t i = 0; i < kept_count; i++) {
+	if (i > 0) {
+	    out_puts(",");
+	}
+	out_sarif_result(&kept[i]);
+    }
+    out_puts("]}]}\n");
+}
+
+// Write out the messages held for sorting or for the SARIF or JSON output
+void diagnostics_finish()
+{
+    token_writer_flush();
+    if (!held || (format == diagnostics_text && kept_count == 0)) {
+	return;
+    }
+    qsort(kept, kept_count, sizeof(diagnostic), compare_diagnostics);
+    // gather the whole output, so it is written at once
+    out_used = 0;
+    if (format == diagnostics_sarif) {
+	out_sarif_log();
+    } else if (format == diagnostics_json) {
+	out_json_document();
+    } else {
+	for (size_t i = 0; i < kept_count; i++) {
+	    out_put(arena + kept[i].start, kept[i].len);
+	}
+    }
+    diagnostics_clear_pending();
+    held = false;  // (so a second call writes nothing)
+    const char *p = out;
+    size_t len = out_used;
+    while (len > 0) {
+	ssize_t n = write(STDERR_FILENO, p, len);
+	if (n < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    break;
+	}
+	p += n;
+	len -= (size_t) n;
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef _DIAGNOSTICS_H
+#define _DIAGNOSTICS_H
+#include <stdbool.h>
+#include <stddef.h>
+
+// The diagnostics sink keeps the error messages reported
+// (as "file:line: message" lines) in memory instead of writing each
+// to stderr at once. Each is noted with the position in the token
+// writer's output at which it was reported, and when the token writer
+// flushes its output it writes the messages with it: if stdout and
+// stderr are the same file (as with 2>&1 or a terminal), each message
+// goes into the output at its position, all in one system call,
+// otherwise all the messages go to stderr in one write.
+// So the output looks as if each error had been written when reported.
+// The messages can instead be written as one SARIF log or compact JSON
+// document, grouped by file, on stderr when the program ends.
+
+// The kinds of errors, each with a stable code (see diagnostic_code)
+typedef enum {
+    diagnostic_other,               // PL0000: e.g., from the parser
+    diagnostic_invalid_char,        // PL0001: an ASCII char
+    diagnostic_invalid_utf8,        // PL0002: a malformed UTF-8 sequence
+    diagnostic_non_ascii,           // PL0003: non-ASCII chars
+    diagnostic_number_too_large,    // PL0004
+    diagnostic_identifier_too_long, // PL0005
+    diagnostic_number_too_long      // PL0006
+} diagnostic_kind;
+
+// How the messages are written
+typedef enum {
+    diagnostics_text,   // "file:line: message" lines, with the output
+    diagnostics_sarif,  // a SARIF 2.1.0 log, at the end
+    diagnostics_json,   // a compact JSON document, at the end
+    diagnostics_none    // not at all (only the lexer's error hook sees them)
+} diagnostics_format;
+
+// Return the stable code of the kind of error (e.g., "PL0001")
+extern const char *diagnostic_code(diagnostic_kind kind);
+
+// Set the form in which the messages are written
+// (diagnostics_text unless this is called)
+extern void diagnostics_set_format(diagnostics_format format);
+
+// Requires: fname != NULL (asserted)
+// Note that the file named fname is being lexed, so it is listed
+// in the SARIF or JSON output even if it has no errors
+extern void diagnostics_begin_file(const char *fname);
+
+// Set how errors are reported: at most max_per_file messages are kept
+// for each file (0 for no limit), after which one message says
+// the rest are not shown; if deduplicate is true, a message that is
+// the same as an earlier one for the same file and line is dropped;
+// if sort is true, the messages are held until the program ends
+// and then written after the output, sorted by file, line and offset
+// (the SARIF and JSON output is always sorted by file)
+extern void diagnostics_configure(size_t max_per_file, bool deduplicate,
+				  bool sort);
+
+// Requires: fname != NULL and msg != NULL (both are asserted);
+//           text has len chars (text may be NULL if len is 0)
+// Note the error message msg, of the given kind, about the text
+// at the given line and byte offset of the file named fname
+// (whose first len chars are at text, if it is known).
+// The lexer forgets its file name at the end of the input,
+// so a caller reporting there must have saved the name before.
+extern void diagnostics_report(diagnostic_kind kind, const char *fname,
+			       unsigned int line, size_t offset,
+			       const char *text, size_t len,
+			       const char *msg);
+
+// Return the number of messages waiting to be written with the output
+extern size_t diagnostics_pending();
+
+// Requires: i < diagnostics_pending()
+// Return message number i of those waiting (with its newline),
+// setting *len to its length and *position to its position
+// in the token writer's output
+extern const char *diagnostics_pending_message(size_t i, size_t *len,
+					       size_t *position);
+
+// Return all the messages waiting (one after another),
+// setting *len to their total length
+extern const char *diagnostics_pending_text(size_t *len);
+
+// Forget the messages waiting, which have been written
+extern void diagnostics_clear_pending();
+
+// Write out the messages held for sorting or for the SARIF or JSON
+// output (if any), after flushing the token writer's output
+extern void diagnostics_finish();
+
+#endif
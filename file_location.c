@@ -1,31 +1,104 @@
 /* $Id: file_location.c,v 1.1 2023/10/04 03:43:15 leavens Exp $ */
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #include "file_location.h"
 #include "utilities.h"
 
-// Requires: filename != NULL
-// Return a (pointer to a) fresh file_location with the given
-// information
-file_location *file_location_make(const char *filename,
-					 unsigned int line)
+// The file table: the names, in the order they were interned,
+// and an open-addressing hash table of their numbers (plus one,
+// so that 0 marks an empty slot), whose size is a power of 2
+static char **names = NULL;
+static size_t name_count = 0;
+static size_t name_capacity = 0;
+static file_id *slots = NULL;
+static size_t slot_count = 0;
+
+// Return the FNV-1a hash of the string s
+static uint32_t hash_name(const char *s)
 {
-    file_location *ret = (file_location *) malloc(sizeof(file_location));
-    if (ret == NULL) {
-	bail_with_error("Could not allocate space for a file_location!");
+    uint32_t h = 2166136261u;
+    for (; *s != '\0'; s++) {
+	h = (h ^ (unsigned char) *s) * 16777619u;
     }
-    return ret;
+    return h;
 }
 
-// Requires: fl != NULL
-// Return a (pointer to a) fresh copy of fl
-file_location *file_location_copy(file_location *fl)
+// Make the hash table twice as big (or start it) and refill it
+static void grow_slots()
 {
-    file_location *ret = (file_location *) malloc(sizeof(file_location));
-    if (ret == NULL) {
-	bail_with_error("Could not allocate space for a file_location!");
+    slot_count = (slot_count == 0) ? 64 : 2 * slot_count;
+    free(slots);
+    slots = (file_id *) calloc(slot_count, sizeof(file_id));
+    if (slots == NULL) {
+	bail_with_error("Cannot allocate space for the file table!");
+    }
+    for (size_t i = 0; i < name_count; i++) {
+	size_t s = hash_name(names[i]) & (slot_count - 1);
+	while (slots[s] != 0) {
+	    s = (s + 1) & (slot_count - 1);
+	}
+	slots[s] = (file_id) (i + 1);
     }
-    ret->filename = fl->filename;
-    ret->line = fl->line;
+}
+
+// Requires: filename != NULL
+// Return the number of the file named filename in the file table,
+// adding (a copy of) the name to the table if it is not already there
+file_id file_table_intern(const char *filename)
+{
+    if (2 * (name_count + 1) > slot_count) {
+	grow_slots();
+    }
+    size_t s = hash_name(filename) & (slot_count - 1);
+    for (; slots[s] != 0; s = (s + 1) & (slot_count - 1)) {
+	if (strcmp(names[slots[s] - 1], filename) == 0) {
+	    return slots[s] - 1;
+	}
+    }
+    if (name_count == name_capacity) {
+	name_capacity = (name_capacity == 0) ? 16 : 2 * name_capacity;
+	names = (char **) realloc(names, name_capacity * sizeof(char *));
+	if (names == NULL) {
+	    bail_with_error("Cannot allocate space for the file table!");
+	}
+    }
+    size_t len = strlen(filename) + 1;
+    char *copy = (char *) malloc(len);
+    if (copy == NULL) {
+	bail_with_error("Cannot allocate space for the file table!");
+    }
+    memcpy(copy, filename, len);
+    names[name_count] = copy;
+    slots[s] = (file_id) (name_count + 1);
+    return (file_id) name_count++;
+}
+
+// Requires: id was returned by file_table_intern
+// Return the name of the file numbered id
+const char *file_table_name(file_id id)
+{
+    return names[id];
+}
+
+// Return the number of files in the file table
+size_t file_table_size()
+{
+    return name_count;
+}
+
+// Requires: filename != NULL
+// Return a file_location with the given information
+file_location file_location_make(const char *filename, unsigned int line)
+{
+    file_location ret;
+    ret.file = file_table_intern(filename);
+    ret.line = line;
     return ret;
 }
+
+// Return the name of the file of fl
+const char *file_location_filename(file_location fl)
+{
+    return file_table_name(fl.file);
+}
@@ -1,21 +1,38 @@
 /* $Id: file_location.h,v 1.1 2023/10/04 03:43:15 leavens Exp $ */
 #ifndef _FILE_LOCATION_H
 #define _FILE_LOCATION_H
+#include <stddef.h>
+#include <stdint.h>
 
-// location in a source file (useful for error messages)
+// The number of a file in the file table, which holds each file name
+// (interned) once
+typedef uint32_t file_id;
+
+// location in a source file (useful for error messages),
+// packed into 64 bits and kept by value in the ASTs
 typedef struct {
-    const char *filename;
+    file_id file;      // the file's number in the file table
     unsigned int line; // of first token
 } file_location;
 
 // Requires: filename != NULL
-// Return a (pointer to a) fresh file_location with the given
-// information
-extern file_location *file_location_make(const char *filename,
-					 unsigned int line);
-
-// Requires: fl != NULL
-// Return a (pointer to a) fresh copy of fl
-extern file_location *file_location_copy(file_location *fl);
+// Return the number of the file named filename in the file table,
+// adding (a copy of) the name to the table if it is not already there
+extern file_id file_table_intern(const char *filename);
+
+// Requires: id was returned by file_table_intern
+// Return the name of the file numbered id
+extern const char *file_table_name(file_id id);
+
+// Return the number of files in the file table
+extern size_t file_table_size();
+
+// Requires: filename != NULL
+// Return a file_location with the given information
+extern file_location file_location_make(const char *filename,
+					unsigned int line);
+
+// Return the name of the file of fl
+extern const char *file_location_filename(file_location fl);
 
 #endif
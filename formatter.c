@@ -0,0 +1,352 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utilities.h"
+#include "lexer.h"
+#include "pl0.tab.h"
+#include "input_file.h"
+#include "token_writer.h"
+#include "formatter.h"
+
+// The constructs that indent the lines inside them
+typedef enum {
+    frame_begin,      // the statements of a begin ... end
+    frame_then,       // the body of a then
+    frame_else,       // the body of an else
+    frame_do,         // the body of a while's do
+    frame_procedure   // the block of a procedure
+} frame_kind;
+
+// A construct that the formatter is inside
+typedef struct {
+    frame_kind kind;
+    unsigned int indent;  // the levels of indentation it adds (0 or 1)
+    bool body_started;    // (procedures) has its statement started?
+} frame;
+
+// The state of the formatter as it goes through a file's tokens.
+// In check mode, what would be written is instead compared
+// with the input, and nothing more is done after the first difference.
+typedef struct {
+    const char *text;     // the input
+    size_t len;
+    bool check;
+    size_t pos;           // (check mode) how much of the input matches
+    bool differs;         // (check mode) has a difference been found?
+    char *out;            // (otherwise) the output
+    size_t used;
+    size_t capacity;
+    frame *frames;        // the constructs it is inside, innermost last
+    size_t frame_count;
+    size_t frame_capacity;
+    unsigned int depth;   // the sum of the frames' indents
+    int prev;             // the last token's code (0 if none)
+    bool prev_sign;       // was the last token a sign?
+    bool started;         // has anything been written?
+    bool newline;         // does the next token start a new line?
+    bool blank;           // is there a blank line before that line?
+    bool in_decl;         // in a const, var or procedure declaration?
+    bool heading;         // in a procedure's heading?
+    bool body_next;       // does the body of a then, else or do start next?
+} formatter;
+
+// Add the len chars at s to the output (or compare them with the input)
+static void put(formatter *fm, const char *s, size_t len)
+{
+    if (fm->check) {
+	if (!fm->differs && (len > fm->len - fm->pos
+			     || memcmp(fm->text + fm->pos, s, len) != 0)) {
+	    fm->differs = true;
+	}
+	fm->pos += len;
+	return;
+    }
+    if (len > fm->capacity - fm->used) {
+	size_t cap = 2 * fm->capacity;
+	while (len > cap - fm->used) {
+	    cap *= 2;
+	}
+	fm->out = realloc(fm->out, cap);
+	if (fm->out == NULL) {
+	    bail_with_error("Cannot allocate space for formatted output!");
+	}
+	fm->capacity = cap;
+    }
+    memcpy(fm->out + fm->used, s, len);
+    fm->used += len;
+}
+
+// Add n spaces to the output
+static void put_spaces(formatter *fm, size_t n)
+{
+    static const char spaces[] = "                                ";
+    while (n > 0) {
+	size_t k = (n < sizeof(spaces) - 1) ? n : sizeof(spaces) - 1;
+	put(fm, spaces, k);
+	n -= k;
+    }
+}
+
+// Add the len chars at s to the output, on a new line if one is due,
+// otherwise after a space if space is true
+static void put_item(formatter *fm, const char *s, size_t len, bool space)
+{
+    if (fm->newline) {
+	if (fm->started) {
+	    put(fm, "\n\n", fm->blank ? 2 : 1);
+	}
+	put_spaces(fm, (size_t) fm->depth * FORMATTER_INDENT);
+	fm->newline = false;
+	fm->blank = false;
+    } else if (space && fm->started) {
+	put(fm, " ", 1);
+    }
+    put(fm, s, len);
+    fm->started = true;
+}
+
+// Enter a construct of the given kind
+static void push(formatter *fm, frame_kind kind)
+{
+    if (fm->frame_count == fm->frame_capacity) {
+	fm->frame_capacity = (fm->frame_capacity == 0)
+	    ? 32 : 2 * fm->frame_capacity;
+	fm->frames = realloc(fm->frames, fm->frame_capacity * sizeof(frame));
+	if (fm->frames == NULL) {
+	    bail_with_error("Cannot allocate space for formatting!");
+	}
+    }
+    fm->frames[fm->frame_count++] = (frame) { kind, 1, false };
+    fm->depth++;
+}
+
+// Return the innermost construct (NULL if there is none)
+static frame *top(formatter *fm)
+{
+    return (fm->frame_count == 0) ? NULL : &fm->frames[fm->frame_count - 1];
+}
+
+// Leave the innermost construct
+static void pop(formatter *fm)
+{
+    fm->depth -= fm->frames[--fm->frame_count].indent;
+}
+
+// Leave the bodies of thens, elses and dos that a statement ends
+static void pop_bodies(formatter *fm)
+{
+    for (frame *f = top(fm); f != NULL && f->kind != frame_begin
+	     && f->kind != frame_procedure; f = top(fm)) {
+	pop(fm);
+    }
+}
+
+// Does a token with code c start a statement?
+static bool starts_statement(int c)
+{
+    return c == identsym || c == callsym || c == beginsym || c == ifsym
+	|| c == whilesym || c == readsym || c == writesym || c == skipsym;
+}
+
+// Write the comments in the input from start up to end (which holds
+// no tokens) and return the number of line ends after the last of them
+static unsigned int put_comments(formatter *fm, size_t start, size_t end)
+{
+    unsigned int newlines = 0;
+    for (size_t i = start; i < end; i++) {
+	if (fm->text[i] == '\n') {
+	    newlines++;
+	    continue;
+	} else if (fm->text[i] != '#') {
+	    continue;
+	}
+	const char *nl = memchr(fm->text + i, '\n', end - i);
+	size_t e = (nl == NULL) ? end : (size_t) (nl - fm->text);
+	size_t n = e;
+	while (n > i && (fm->text[n-1] == ' ' || fm->text[n-1] == '\t'
+			 || fm->text[n-1] == '\r')) {
+	    n--;
+	}
+	if (newlines == 0 && fm->started) {
+	    // it follows a token on its line, so it stays there
+	    put(fm, " ", 1);
+	    put(fm, fm->text + i, n - i);
+	} else {
+	    fm->newline = true;
+	    fm->blank = fm->blank || newlines >= 2;
+	    put_item(fm, fm->text + i, n - i, false);
+	}
+	fm->newline = true;
+	newlines = 0;
+	i = e - 1;  // (its line end is counted next)
+    }
+    return newlines;
+}
+
+// Add the token with code c and the len chars of text at s,
+// which followed newlines line ends (after any comments), to the output
+static void put_token(formatter *fm, int c, const char *s, size_t len,
+		      unsigned int newlines)
+{
+    bool space = !fm->prev_sign && fm->prev != lparensym;
+    switch (c) {
+    case endsym:
+	pop_bodies(fm);
+	if (top(fm) != NULL && top(fm)->kind == frame_begin) {
+	    pop(fm);
+	}
+	fm->newline = true;
+	break;
+    case elsesym:
+	while (top(fm) != NULL && (top(fm)->kind == frame_else
+				   || top(fm)->kind == frame_do)) {
+	    pop(fm);
+	}
+	if (top(fm) != NULL && top(fm)->kind == frame_then) {
+	    pop(fm);
+	}
+	fm->newline = true;
+	break;
+    case commasym: case semisym: case periodsym: case rparensym:
+	space = false;
+	break;
+    }
+    if (fm->body_next) {
+	// a begin stays on the line of its then, else or do
+	fm->body_next = false;
+	if (c == beginsym) {
+	    top(fm)->indent = 0;
+	    fm->depth--;
+	} else {
+	    fm->newline = true;
+	}
+    }
+    frame *f = top(fm);
+    if (f != NULL && f->kind == frame_procedure && !fm->in_decl
+	&& starts_statement(c)) {
+	f->body_started = true;
+    }
+    if (fm->newline && newlines >= 2) {
+	fm->blank = true;
+    }
+    put_item(fm, s, len, space);
+
+    switch (c) {
+    case constsym: case varsym:
+	fm->in_decl = true;
+	break;
+    case proceduresym:
+	fm->in_decl = true;
+	fm->heading = true;
+	break;
+    case semisym:
+	if (fm->heading) {
+	    push(fm, frame_procedure);
+	} else if (!fm->in_decl) {
+	    pop_bodies(fm);
+	    f = top(fm);
+	    if (f != NULL && f->kind == frame_procedure && f->body_started) {
+		pop(fm);
+	    }
+	}
+	fm->heading = false;
+	fm->in_decl = false;
+	fm->newline = true;
+	break;
+    case beginsym:
+	push(fm, frame_begin);
+	fm->newline = true;
+	break;
+    case thensym: case elsesym: case dosym:
+	push(fm, (c == thensym) ? frame_then
+	     : (c == elsesym) ? frame_else : frame_do);
+	fm->body_next = true;
+	break;
+    case periodsym:
+	while (top(fm) != NULL) {
+	    pop(fm);
+	}
+	fm->newline = true;
+	break;
+    }
+    fm->prev_sign = (c == plussym || c == minussym)
+	&& fm->prev != identsym && fm->prev != numbersym
+	&& fm->prev != rparensym;
+    fm->prev = c;
+}
+
+// Format the input of fm, the file named fname
+static void format(formatter *fm, const char *fname)
+{
+    bool values = lexer_token_values();
+    lexer_set_token_values(false);
+    lexer_init_buffer(fname, fm->text, fm->len, 1, 0);
+    size_t gap_start = 0;
+    lexer_token tok;
+    while (!fm->differs && lexer_next_token(&tok)) {
+	unsigned int newlines = put_comments(fm, gap_start, tok.offset);
+	put_token(fm, tok.code, fm->text + tok.offset, tok.length, newlines);
+	gap_start = tok.offset + tok.length;
+    }
+    if (!fm->differs) {
+	put_comments(fm, gap_start, fm->len);
+	if (fm->started) {
+	    put(fm, "\n", 1);
+	}
+    }
+    if (fm->check && fm->pos != fm->len) {
+	fm->differs = true;
+    }
+    lexer_set_token_values(values);
+    free(fm->frames);
+}
+
+// Print the formatted text of the file named fname on standard output
+// and return true; but if the file cannot be read or has lexical errors
+// (which are reported), fill in *status and return false
+bool formatter_output(const char *fname, error_status *status)
+{
+    input_file f;
+    if (!input_file_map(fname, &f, status)) {
+	return false;
+    }
+    // the output is built in one buffer, a little bigger than the input
+    formatter fm = { .text = f.text, .len = f.len };
+    fm.capacity = f.len + f.len / 4 + 256;
+    fm.out = malloc(fm.capacity);
+    if (fm.out == NULL) {
+	bail_with_error("Cannot allocate space for formatted output!");
+    }
+    format(&fm, fname);
+    bool ok = !errors_noted;
+    if (ok) {
+	token_writer_put(fm.out, fm.used);
+    }
+    token_writer_flush();
+    free(fm.out);
+    input_file_unmap(&f);
+    if (!ok) {
+	errno = 0;
+	return fail_with_error(status, "%s is not formatted,"
+			       " as it has lexical errors", fname);
+    }
+    return true;
+}
+
+// Set *formatted to whether the file named fname is already formatted
+// (without writing any output, and stopping at the first difference;
+// a file with lexical errors is not formatted) and return true; but if the file cannot be read,
+// fill in *status and return false
+bool formatter_check(const char *fname, bool *formatted,
+		     error_status *status)
+{
+    input_file f;
+    if (!input_file_map(fname, &f, status)) {
+	return false;
+    }
+    formatter fm = { .text = f.text, .len = f.len, .check = true };
+    format(&fm, fname);
+    *formatted = !fm.differs && !errors_noted;
+    input_file_unmap(&f);
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef _FORMATTER_H
+#define _FORMATTER_H
+#include <stdbool.h>
+#include "utilities.h"
+
+// The formatter writes a PL/0 program in a canonical layout,
+// in one pass over the lexer's tokens:
+//   - each declaration and each statement ending with ";" is on
+//     a line of its own, and a procedure's block is indented;
+//   - the statements between "begin" and "end" are indented,
+//     as is the body of a "then", "else" or "do" that is not a
+//     "begin" (which stays on the same line);
+//   - tokens on a line are separated by single spaces, except before
+//     ",", ";", "." and ")", after "(" and after a sign;
+//   - comments are kept, at the end of a line or on lines of their own,
+//     as are single blank lines between lines.
+// Formatting a formatted program does not change it.
+// A program with lexical errors is not formatted (as the text the lexer
+// rejects is not between tokens where the formatter can keep it),
+// and is never taken to be formatted.
+
+// The number of spaces for each level of indentation
+#define FORMATTER_INDENT 4
+
+// Requires: fname != NULL and status != NULL
+// Print the formatted text of the file named fname on standard output
+// and return true; but if the file cannot be read or has lexical errors
+// (which are reported), fill in *status and return false
+extern bool formatter_output(const char *fname, error_status *status);
+
+// Requires: fname != NULL and formatted != NULL and status != NULL
+// Set *formatted to whether the file named fname is already formatted
+// (without writing any output, and stopping at the first difference;
+// a file with lexical errors is not formatted) and return true; but if the file cannot be read,
+// fill in *status and return false
+extern bool formatter_check(const char *fname, bool *formatted,
+			    error_status *status);
+
+#endif
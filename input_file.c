@@ -0,0 +1,43 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "input_file.h"
+
+// Map the file named fname into memory, filling in *f and returning
+// true; but if it cannot be read, fill in *status and return false
+bool input_file_map(const char *fname, input_file *f, error_status *status)
+{
+    errno = 0;
+    int fd = open(fname, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+	if (fd >= 0) {
+	    close(fd);
+	}
+	return fail_with_error(status, "Cannot open %s", fname);
+    }
+    f->len = (size_t) st.st_size;
+    f->text = "";
+    if (f->len > 0) {
+	void *base = mmap(NULL, f->len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (base == MAP_FAILED) {
+	    close(fd);
+	    return fail_with_error(status, "Cannot read %s", fname);
+	}
+	f->text = (const char *) base;
+    }
+    close(fd);
+    return true;
+}
+
+// Unmap the file f
+void input_file_unmap(input_file *f)
+{
+    if (f->len > 0) {
+	munmap((void *) f->text, f->len);
+    }
+    f->text = "";
+    f->len = 0;
+}
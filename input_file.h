@@ -0,0 +1,24 @@
+#ifndef _INPUT_FILE_H
+#define _INPUT_FILE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include "utilities.h"
+
+// An input file mapped into memory (read-only), for the tools that
+// write out or look at the text of the input around its tokens
+typedef struct {
+    const char *text;  // the file's contents (not null-terminated)
+    size_t len;        // the file's length in bytes
+} input_file;
+
+// Requires: fname != NULL and f != NULL and status != NULL
+// Map the file named fname into memory, filling in *f and returning
+// true; but if it cannot be read, fill in *status and return false
+extern bool input_file_map(const char *fname, input_file *f,
+			   error_status *status);
+
+// Requires: f was filled in by input_file_map
+// Unmap the file f
+extern void input_file_unmap(input_file *f);
+
+#endif
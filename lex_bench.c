@@ -0,0 +1,121 @@
+// A benchmark of the lexer on operator-dense code: it makes a program
+// of statements whose expressions are deeply parenthesized chains of
+// arithmetic and comparison operators (so most tokens are one- or
+// two-char operators and punctuation), lexes it from memory with
+// lexer_next_token, with token values on (as for the parser) and off
+// (as for the tools), and reports the best time per token of its runs.
+//
+// Usage: lex_bench [megabytes]
+#define _POSIX_C_SOURCE 200809L  // for clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ast.h"
+#include "lexer.h"
+
+#define LEX_BENCH_DEFAULT_MEGABYTES 8
+#define LEX_BENCH_RUNS 3
+
+// Return the current time in seconds
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// a small linear congruential generator, so the program is the same
+// in every run
+static unsigned long seed = 3;
+
+// Return a pseudo-random number less than n
+static unsigned int pick(unsigned int n)
+{
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    return (unsigned int) ((seed >> 33) % n);
+}
+
+// Return a program of at least size chars (setting *len to its length)
+static char *make_program(size_t size, size_t *len)
+{
+    static const char *operands[] = { "a", "b", "c", "x", "y", "z1", "n",
+				      "1", "42" };
+    static const char *ops[] = { "+", "-", "*", "/" };
+    static const char *stmts[] = { "x := %s;\n", "if %s <= a then skip;\n",
+				   "if %s <> b then skip;\n",
+				   "while %s >= c do skip;\n", "write %s;\n" };
+    char *prog = (char *) malloc(size + 1024);
+    char expr[512];
+    if (prog == NULL) {
+	bail_with_error("Cannot allocate the program for lex_bench!");
+    }
+    size_t n = 0;
+    while (n < size) {
+	int depth = 2 + (int) pick(7);
+	size_t e = 0;
+	for (int i = 0; i < depth; i++) {
+	    expr[e++] = '(';
+	}
+	e += (size_t) sprintf(expr + e, "%s", operands[pick(7)]);
+	for (int i = 0; i < depth; i++) {
+	    e += (size_t) sprintf(expr + e, "%s%s)", ops[pick(4)],
+				  operands[pick(9)]);
+	}
+	n += (size_t) sprintf(prog + n, stmts[pick(5)], expr);
+    }
+    *len = n;
+    return prog;
+}
+
+// Lex the len chars at prog, returning the number of tokens
+// (and setting *secs to the best time of the runs)
+static size_t lex(const char *prog, size_t len, bool values, double *secs)
+{
+    size_t tokens = 0;
+    lexer_set_token_values(values);
+    for (int i = 0; i < LEX_BENCH_RUNS; i++) {
+	tokens = 0;
+	double start = now();
+	lexer_init_buffer("lex_bench", prog, len, 1, 0);
+	lexer_token tok;
+	while (lexer_next_token(&tok)) {
+	    tokens++;
+	}
+	double t = now() - start;
+	if (i == 0 || t < *secs) {
+	    *secs = t;
+	}
+	ast_release_unit();
+    }
+    return tokens;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t megabytes = LEX_BENCH_DEFAULT_MEGABYTES;
+    if (argc > 1) {
+	megabytes = strtoul(argv[1], NULL, 10);
+    }
+    if (megabytes == 0) {
+	megabytes = 1;
+    }
+    size_t len;
+    char *prog = make_program(megabytes << 20, &len);
+
+    double on = 0.0, off = 0.0;
+    size_t tokens = lex(prog, len, true, &on);
+    if (lex(prog, len, false, &off) != tokens || errors_noted) {
+	fprintf(stderr, "lex_bench: the runs differ or found errors!\n");
+	return EXIT_FAILURE;
+    }
+    printf("%zu bytes of operator-dense code: %zu tokens\n", len, tokens);
+    printf("%-18s %10s %10s %10s\n", "token values", "ms", "ns/token",
+	   "MB/s");
+    printf("%-18s %10.1f %10.1f %10.1f\n", "on", on * 1e3,
+	   on * 1e9 / tokens, len / on / (1 << 20));
+    printf("%-18s %10.1f %10.1f %10.1f\n", "off", off * 1e3,
+	   off * 1e9 / tokens, len / off / (1 << 20));
+    free(prog);
+    return EXIT_SUCCESS;
+}
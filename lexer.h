@@ -2,22 +2,122 @@
 #ifndef _LEXER_H
 #define _LEXER_H
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "utilities.h"
+#include "file_location.h"
 
 // Have any error messages been printed?
 extern bool errors_noted;
 
+// A token as found in the input by the lexer
+typedef struct {
+    int code;            // token code, from pl0.tab.h
+    unsigned int line;   // line number of the token
+    size_t offset;       // byte offset of the token's text in the input
+    size_t length;       // length of the token's text in bytes
+} lexer_token;
+
+// The version of the scanner; change this whenever the tokens or
+// errors it produces for some input change (this keys token caches)
+#define LEXER_SCANNER_VERSION "pl0-lexer 3"
+
 // Requires: fname != NULL
 // Requires: fname is the name of a readable file
 // Initialize the lexer and start it reading
 // from the given file name
 extern void lexer_init(char *fname);
 
+// Requires: fname != NULL and status != NULL
+// Initialize the lexer and start it reading from the given file name,
+// returning true; but if the file cannot be opened, fill in *status
+// and return false (and the lexer must not be used until it is
+// initialized again).
+// Unlike with lexer_init, a failure to read or close the file
+// does not end the program: the input just ends there,
+// and lexer_input_status reports the failure.
+extern bool lexer_open(char *fname, error_status *status);
+
+// Requires: status != NULL
+// Return true if the input opened by lexer_open has been read
+// (so far) and closed without failing, otherwise fill in *status
+// and return false
+extern bool lexer_input_status(error_status *status);
+
+// Requires: buf != NULL
+// Initialize the lexer and start it reading the len chars at buf,
+// which are the text starting at the given line and byte offset
+// of the file named fname
+extern void lexer_init_buffer(const char *fname, const char *buf, size_t len,
+			      unsigned int line, size_t offset);
+
+// Set whether the lexer sets yylval for each token;
+// the parser needs these values, but tools that only look at
+// the token codes and text do not.
+extern void lexer_set_token_values(bool on);
+
+// Does the lexer set yylval for each token?
+extern bool lexer_token_values();
+
+// Identifiers and numbers longer than the lexeme limit are not kept
+// in full: each is reported as an error and returned as a token
+// whose text is its first LEXER_LEXEME_PREFIX chars,
+// so memory use does not depend on the length of a lexeme
+#define LEXER_LEXEME_PREFIX 64
+#define LEXER_DEFAULT_LEXEME_LIMIT 1024
+#define LEXER_MIN_LEXEME_LIMIT 16
+#define LEXER_MAX_LEXEME_LIMIT 8192
+
+// Set the length above which identifiers and numbers are not kept
+// in full, which is forced into the range from
+// LEXER_MIN_LEXEME_LIMIT to LEXER_MAX_LEXEME_LIMIT
+extern void lexer_set_lexeme_limit(size_t limit);
+
+// Return the length above which identifiers and numbers are not kept
+extern size_t lexer_lexeme_limit();
+
 // Return the name of the current file
 extern const char *lexer_filename();
 
 // Return the line number of the next token
 extern unsigned int lexer_line();
 
+// Return the location of the next token
+// (interning the current file's name in the file table)
+extern file_location lexer_location();
+
+// Return the byte offset in the input of the last token read
+extern size_t lexer_token_offset();
+
+// Return the length in bytes of the last token read
+extern size_t lexer_token_length();
+
+// Return the text of the last token read,
+// which is only valid until the next token is read
+extern const char *lexer_token_text();
+
+// Was the text of the last token read truncated
+// (because it was longer than the lexeme limit)?
+extern bool lexer_token_truncated();
+
+// Return a hash of the (whole) text of the last token read
+extern uint64_t lexer_token_hash();
+
+// Requires: tok != NULL
+// Read the next token into *tok, returning false at the end of the input
+extern bool lexer_next_token(lexer_token *tok);
+
+// A function told the line and message of each error the lexer reports
+typedef void (*lexer_error_hook)(unsigned int line, const char *msg);
+
+// Set the function to call with the line and message of each error
+// that is reported (NULL for none)
+extern void lexer_set_error_hook(lexer_error_hook hook);
+
+// Report an error at the given line of the current file
+// (and the offset of the last token read), as yyerror does
+extern void lexer_report_error(unsigned int line, const char *msg);
+
 // On standard output:
 // Print a message about the file name of the lexer's input
 // and then print a heading for the lexer's output.
@@ -1,9 +1,238 @@
 #include "lexer.h"
+#include "ast.h"
+#include "compressor.h"
+#include "diagnostics.h"
+#include "formatter.h"
+#include "minifier.h"
+#include "pl0tok.h"
+#include "semantic_tokens.h"
+#include "token_cache.h"
+#include "token_writer.h"
+#include "utilities.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Print the error in *status after the output so far
+static void report_failure(const error_status *status) {
+  token_writer_flush();
+  print_error(status);
+}
+
+// Print a usage message for the program named cmd and exit.
+// In every mode, the exit status is a failure if some input cannot be
+// read or has lexical errors (or, for format-check, is not formatted).
+static void usage(const char *cmd) {
+  bail_with_error("Usage: %s [-l lexeme-limit]"
+                  " [-f text|jsonl|csv|minify|minify-lines|format|format-check"
+                  "|semantic [-r first-line:end-line]]"
+                  " [-z gzip-level] [-d max=N,dedup,sort] [-e text|sarif|json]"
+                  " [-b tokens.pl0tok] [-c cache-dir [-C max-cache-bytes]]"
+                  " file.pl0 ...\n"
+                  "Exits with a failure status if some file cannot be read"
+                  " or has lexical errors\n"
+                  "(or, with format-check, is not formatted).", cmd);
+}
 
 int main(int argc, char *argv[]) {
-  lexer_init(argv[1]);
-  lexer_output();
-  printf("\n");
-  return 0;
+  const char *format = "text";
+  const char *binary_name = NULL;
+  const char *cache_dir = NULL;
+  size_t cache_bytes = TOKEN_CACHE_DEFAULT_MAX_BYTES;
+  unsigned int first_line = 0;
+  unsigned int end_line = SEMANTIC_END_LINE;
+  int gzip_level = -1;
+  bool text_errors = true;
+  int i = 1;
+  while (i < argc - 1 && argv[i][0] == '-') {
+    if (i + 1 >= argc - 1) {
+      usage(argv[0]);
+    } else if (strcmp(argv[i], "-l") == 0) {
+      lexer_set_lexeme_limit(strtoul(argv[i+1], NULL, 10));
+    } else if (strcmp(argv[i], "-f") == 0) {
+      format = argv[i+1];
+      if (strcmp(format, "text") != 0 && strcmp(format, "jsonl") != 0
+          && strcmp(format, "csv") != 0
+          && strcmp(format, "minify") != 0
+          && strcmp(format, "minify-lines") != 0
+          && strcmp(format, "format") != 0
+          && strcmp(format, "format-check") != 0
+          && strcmp(format, "semantic") != 0) {
+        usage(argv[0]);
+      }
+    } else if (strcmp(argv[i], "-r") == 0) {
+      // a range of lines, numbered from 0 as in the LSP
+      char *colon;
+      first_line = strtoul(argv[i+1], &colon, 10);
+      if (*colon != ':' || *(colon+1) == '\0') {
+        usage(argv[0]);
+      }
+      end_line = strtoul(colon+1, NULL, 10);
+      if (end_line < first_line) {
+        usage(argv[0]);
+      }
+    } else if (strcmp(argv[i], "-z") == 0) {
+      char *end;
+      long level = strtol(argv[i+1], &end, 10);
+      if (*end != '\0' || level < COMPRESSOR_MIN_LEVEL
+          || level > COMPRESSOR_MAX_LEVEL) {
+        usage(argv[0]);
+      }
+      gzip_level = (int) level;
+    } else if (strcmp(argv[i], "-d") == 0) {
+      // how error messages are reported: a comma-separated list
+      size_t max_errors = 0;
+      bool dedup = false;
+      bool sort = false;
+      for (char *opt = strtok(argv[i+1], ","); opt != NULL;
+           opt = strtok(NULL, ",")) {
+        if (strncmp(opt, "max=", 4) == 0) {
+          max_errors = strtoul(opt + 4, NULL, 10);
+        } else if (strcmp(opt, "dedup") == 0) {
+          dedup = true;
+        } else if (strcmp(opt, "sort") == 0) {
+          sort = true;
+        } else {
+          usage(argv[0]);
+        }
+      }
+      diagnostics_configure(max_errors, dedup, sort);
+    } else if (strcmp(argv[i], "-e") == 0) {
+      // how error messages are written
+      if (strcmp(argv[i+1], "sarif") == 0) {
+        diagnostics_set_format(diagnostics_sarif);
+      } else if (strcmp(argv[i+1], "json") == 0) {
+        diagnostics_set_format(diagnostics_json);
+      } else if (strcmp(argv[i+1], "text") != 0) {
+        usage(argv[0]);
+      }
+      text_errors = strcmp(argv[i+1], "text") == 0;
+    } else if (strcmp(argv[i], "-b") == 0) {
+      binary_name = argv[i+1];
+    } else if (strcmp(argv[i], "-c") == 0) {
+      cache_dir = argv[i+1];
+    } else if (strcmp(argv[i], "-C") == 0) {
+      cache_bytes = strtoull(argv[i+1], NULL, 10);
+    } else {
+      usage(argv[0]);
+    }
+    i += 2;
+  }
+  // only the text output can hold the tokens of several files
+  // (and checking the format of several files writes no tokens)
+  bool several = strcmp(format, "text") == 0
+    || strcmp(format, "format-check") == 0;
+  if (i >= argc || (i != argc - 1 && (!several || binary_name != NULL))) {
+    usage(argv[0]);
+  }
+  if (gzip_level >= 0) {
+    // the output is compressed on another thread
+    token_writer_compress(gzip_level);
+  }
+  if (cache_dir != NULL && binary_name == NULL
+      && strcmp(format, "text") == 0 && text_errors) {
+    // the cache reads (or lexes) each file itself
+    token_cache cache;
+    token_cache_init(&cache, cache_dir, cache_bytes);
+    bool failed = false;
+    for (; i < argc; i++) {
+      error_status status;
+      if (!token_cache_lexer_output(&cache, argv[i], &status)) {
+        report_failure(&status);
+        failed = true;
+        continue;
+      }
+      failed = failed || errors_noted;
+      token_writer_puts("\n");
+      ast_release_unit();  // each file is a compilation unit
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+  if (strncmp(format, "minify", 6) == 0 && binary_name == NULL) {
+    // reads the file itself, to write each token's text from it
+    error_status status;
+    if (!minifier_output(argv[i], strcmp(format, "minify-lines") == 0,
+                         &status)) {
+      exit_with_error(&status);
+    }
+    return errors_noted ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+  if (strcmp(format, "format-check") == 0 && binary_name == NULL) {
+    // print the name of each file that is not formatted
+    bool failed = false;
+    for (; i < argc; i++) {
+      error_status status;
+      bool formatted;
+      if (!formatter_check(argv[i], &formatted, &status)) {
+        report_failure(&status);
+        failed = true;
+      } else if (!formatted) {
+        token_writer_puts(argv[i]);
+        token_writer_puts("\n");
+        failed = true;
+      }
+      failed = failed || errors_noted;
+    }
+    token_writer_flush();
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+  if (strcmp(format, "format") == 0 && binary_name == NULL) {
+    error_status status;
+    if (!formatter_output(argv[i], &status)) {
+      exit_with_error(&status);
+    }
+    return errors_noted ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+  if (strcmp(format, "semantic") == 0 && binary_name == NULL) {
+    // lexes only the requested lines of the file itself
+    semantic_tokens_output(argv[i], first_line, end_line);
+    return errors_noted ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+  if (binary_name != NULL || strcmp(format, "text") != 0) {
+    lexer_init(argv[i]);
+  }
+  if (binary_name != NULL) {
+    // write the tokens in binary form instead of printing them
+    FILE *out = fopen(binary_name, "wb");
+    if (out == NULL) {
+      bail_with_error("Cannot open %s", binary_name);
+    }
+    pl0tok_writer w;
+    pl0tok_writer_init(&w, out);
+    lexer_set_token_values(false);
+    pl0tok_write_lexer_tokens(&w);
+    pl0tok_writer_finish(&w);
+    if (fclose(out) == EOF) {
+      bail_with_error("Cannot close %s", binary_name);
+    }
+    return errors_noted ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+  if (strcmp(format, "jsonl") == 0) {
+    lexer_set_token_values(false);
+    token_writer_output_jsonl();
+    return errors_noted ? EXIT_FAILURE : EXIT_SUCCESS;
+  } else if (strcmp(format, "csv") == 0) {
+    lexer_set_token_values(false);
+    token_writer_output_csv();
+    return errors_noted ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+  // a file that cannot be read is reported and skipped
+  bool failed = false;
+  for (; i < argc; i++) {
+    error_status status;
+    if (!lexer_open(argv[i], &status)) {
+      report_failure(&status);
+      failed = true;
+      continue;
+    }
+    lexer_output();
+    failed = failed || errors_noted;
+    if (!lexer_input_status(&status)) {
+      report_failure(&status);
+      failed = true;
+    }
+    token_writer_puts("\n");
+    ast_release_unit();  // each file is a compilation unit
+  }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -0,0 +1,178 @@
+// A benchmark of building the long lists in ASTs: for each kind of list
+// it makes lists of doubling lengths, calling the AST constructors in
+// the order that the parser's left-recursive rules reduce them
+// (e.g., ast_stmts for each statement in a begin ... end), and checks
+// that the time per element stays about the same, i.e., that building
+// a list takes time linear in its length. It fails if that time grows
+// by more than a factor of LIST_BENCH_MAX_GROWTH (quadratic building
+// would make it grow by a factor of 16).
+//
+// Usage: list_bench [max_length]
+#define _POSIX_C_SOURCE 200809L  // for clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ast.h"
+#include "pl0.tab.h"
+
+#define LIST_BENCH_MIN_LENGTH 25000
+#define LIST_BENCH_DEFAULT_MAX_LENGTH 400000
+#define LIST_BENCH_RUNS 3
+#define LIST_BENCH_MAX_GROWTH 3.0
+
+// the location of all the ASTs built
+static file_location loc;
+
+static ident_t ident()
+{
+    return ast_ident(loc, "x");
+}
+
+static number_t number()
+{
+    return ast_number(ast_token(loc, "+", plussym), 1);
+}
+
+static block_t empty_block()
+{
+    empty_t e = ast_empty(loc);
+    return ast_block(ast_const_decls_empty(e), ast_var_decls_empty(e),
+		     ast_proc_decls_empty(e),
+		     ast_stmt_skip(ast_skip_stmt(loc)));
+}
+
+// Return the length of the list lst (linked as in generic_t)
+static size_t length(void *lst)
+{
+    size_t n = 0;
+    for (; lst != NULL; lst = ((generic_t *) lst)->next) {
+	n++;
+    }
+    return n;
+}
+
+// Build each kind of list with n elements, returning its length
+
+static size_t stmts(size_t n)
+{
+    stmts_t l = ast_stmts_singleton(ast_stmt_skip(ast_skip_stmt(loc)));
+    for (size_t i = 1; i < n; i++) {
+	l = ast_stmts(l, ast_stmt_skip(ast_skip_stmt(loc)));
+    }
+    stmt_t s = ast_stmt_begin(ast_begin_stmt(l));
+    return length(s.stmt.begin_stmt.stmts.stmts);
+}
+
+static size_t idents(size_t n)
+{
+    idents_t l = ast_idents_singleton(ident());
+    for (size_t i = 1; i < n; i++) {
+	l = ast_idents(l, ident());
+    }
+    return length(ast_var_decl(l).idents.idents);
+}
+
+static size_t const_defs(size_t n)
+{
+    const_defs_t l = ast_const_defs_singleton(ast_const_def(ident(),
+							   number()));
+    for (size_t i = 1; i < n; i++) {
+	l = ast_const_defs(l, ast_const_def(ident(), number()));
+    }
+    return length(ast_const_decl(l).const_defs.const_defs);
+}
+
+static size_t const_decls(size_t n)
+{
+    const_decls_t l = ast_const_decls_empty(ast_empty(loc));
+    for (size_t i = 0; i < n; i++) {
+	const_defs_t d = ast_const_defs_singleton(ast_const_def(ident(),
+							       number()));
+	l = ast_const_decls(l, ast_const_decl(d));
+    }
+    return length(l.const_decls);
+}
+
+static size_t var_decls(size_t n)
+{
+    var_decls_t l = ast_var_decls_empty(ast_empty(loc));
+    for (size_t i = 0; i < n; i++) {
+	l = ast_var_decls(l, ast_var_decl(ast_idents_singleton(ident())));
+    }
+    return length(l.var_decls);
+}
+
+static size_t proc_decls(size_t n)
+{
+    proc_decls_t l = ast_proc_decls_empty(ast_empty(loc));
+    block_t b = empty_block();
+    for (size_t i = 0; i < n; i++) {
+	l = ast_proc_decls(l, ast_proc_decl(ident(), b));
+    }
+    return length(l.proc_decls);
+}
+
+static const struct {
+    const char *name;
+    size_t (*build)(size_t n);
+} lists[] = {
+    { "stmts", stmts }, { "idents", idents }, { "const-defs", const_defs },
+    { "const-decls", const_decls }, { "var-decls", var_decls },
+    { "proc-decls", proc_decls }
+};
+
+// Return the best time, in nanoseconds per element, of building
+// the list made by build with n elements
+static double time_build(size_t (*build)(size_t n), size_t n,
+			 const char *name)
+{
+    double best = 0.0;
+    for (int run = 0; run < LIST_BENCH_RUNS; run++) {
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	size_t len = build(n);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (len != n) {
+	    fprintf(stderr, "list_bench: %s list of %zu has length %zu!\n",
+		    name, n, len);
+	    exit(EXIT_FAILURE);
+	}
+	ast_release_unit();
+	double ns = ((end.tv_sec - start.tv_sec) * 1e9
+		     + (end.tv_nsec - start.tv_nsec)) / (double) n;
+	if (run == 0 || ns < best) {
+	    best = ns;
+	}
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t max = LIST_BENCH_DEFAULT_MAX_LENGTH;
+    if (argc > 1) {
+	max = strtoul(argv[1], NULL, 10);
+    }
+    if (max < 2 * LIST_BENCH_MIN_LENGTH) {
+	max = 2 * LIST_BENCH_MIN_LENGTH;
+    }
+    loc = file_location_make("list_bench", 1);
+    bool linear = true;
+    printf("%-12s %10s %12s\n", "list", "length", "ns/element");
+    for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); i++) {
+	double first = 0.0, last = 0.0;
+	for (size_t n = LIST_BENCH_MIN_LENGTH; n <= max; n *= 2) {
+	    last = time_build(lists[i].build, n, lists[i].name);
+	    if (n == LIST_BENCH_MIN_LENGTH) {
+		first = last;
+	    }
+	    printf("%-12s %10zu %12.1f\n", lists[i].name, n, last);
+	}
+	if (last > LIST_BENCH_MAX_GROWTH * first) {
+	    printf("%s: building is not linear in the list's length!\n",
+		   lists[i].name);
+	    linear = false;
+	}
+    }
+    return linear ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,104 @@
+#include <stdbool.h>
+#include "utilities.h"
+#include "lexer.h"
+#include "input_file.h"
+#include "token_info.h"
+#include "token_writer.h"
+#include "minifier.h"
+
+// Does a token of the given kind run together with an adjacent
+// token of the same sort (identifiers, numbers and reserved words)?
+static bool is_word(int code)
+{
+    token_category k = token_category_of(code);
+    return k == token_keyword || k == token_identifier || k == token_number;
+}
+
+// Would an operator ending with the char last followed by one
+// starting with the char first be read as a different token?
+// (as "<" then "=" would be read as "<=", and "<" then ">" as "<>")
+static bool joins(char last, char first)
+{
+    return (last == '<' && (first == '=' || first == '>'))
+	|| (last == '>' && first == '=');
+}
+
+// Is there text other than whitespace and comments in s[0..len),
+// which holds no tokens (so the lexer reported errors for that text)?
+static bool has_error_text(const char *s, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+	switch (s[i]) {
+	case ' ': case '\t': case '\v': case '\f': case '\r': case '\n':
+	    break;
+	case '#':
+	    while (i + 1 < len && s[i+1] != '\n') {
+		i++;
+	    }
+	    break;
+	default:
+	    return true;
+	}
+    }
+    return false;
+}
+
+// Print the minified text of the file named fname on standard output
+// (followed by a newline), keeping its line structure if keep_lines
+// is true, and return true; but if the file cannot be read,
+// fill in *status and return false
+bool minifier_output(const char *fname, bool keep_lines,
+		     error_status *status)
+{
+    input_file f;
+    if (!input_file_map(fname, &f, status)) {
+	return false;
+    }
+    bool values = lexer_token_values();
+    lexer_set_token_values(false);
+    lexer_init_buffer(fname, f.text, f.len, 1, 0);
+    // tokens are written from their spans in the mapped file
+    // (so long lexemes are written in full), and a run of tokens
+    // that were already adjacent in the file is written at once
+    size_t run_start = 0;
+    size_t run_end = 0;
+    unsigned int line = 1;
+    bool word = false;  // was the last token a word?
+    char last = '\0';   // the last char of the last token ('\0' if none)
+    lexer_token tok;
+    while (lexer_next_token(&tok)) {
+	const char *s = f.text + tok.offset;
+	bool w = is_word(tok.code);
+	// a gap with text the lexer rejected is kept as it is
+	bool gap = tok.offset != run_end;
+	bool kept = gap && has_error_text(f.text + run_end,
+					  tok.offset - run_end);
+	bool newline = !kept && keep_lines && tok.line > line;
+	bool space = !kept && !newline && ((word && w) || joins(last, s[0]));
+	if ((gap && !kept) || newline || space) {
+	    token_writer_put(f.text + run_start, run_end - run_start);
+	    for (; newline && line < tok.line; line++) {
+		token_writer_put("\n", 1);
+	    }
+	    if (space) {
+		token_writer_put(" ", 1);
+	    }
+	    run_start = tok.offset;
+	}
+	if (kept) {
+	    line = tok.line;
+	}
+	run_end = tok.offset + tok.length;
+	word = w;
+	last = s[tok.length - 1];
+    }
+    if (has_error_text(f.text + run_end, f.len - run_end)) {
+	run_end = f.len;
+    }
+    token_writer_put(f.text + run_start, run_end - run_start);
+    token_writer_put("\n", 1);
+    token_writer_flush();
+    lexer_set_token_values(values);
+    input_file_unmap(&f);
+    return true;
+}
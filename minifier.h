@@ -0,0 +1,25 @@
+#ifndef _MINIFIER_H
+#define _MINIFIER_H
+#include <stdbool.h>
+#include "utilities.h"
+
+// The minifier writes out a PL/0 program with its comments and
+// whitespace removed: tokens are written one after another, with a
+// single space only where two tokens would otherwise run together
+// (such as two identifiers, or "<" before "=").
+// If lines are kept, each token is instead written on the line where
+// it was in the input, so error messages about the minified program
+// give the same line numbers as for the original.
+// Text between tokens that is not whitespace or a comment (which the
+// lexer reports as an error) is written unchanged, with the whitespace
+// and comments around it, so the output is never a different program.
+
+// Requires: fname != NULL and status != NULL
+// Print the minified text of the file named fname on standard output
+// (followed by a newline), keeping its line structure if keep_lines
+// is true, and return true; but if the file cannot be read,
+// fill in *status and return false
+extern bool minifier_output(const char *fname, bool keep_lines,
+			    error_status *status);
+
+#endif
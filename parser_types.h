@@ -4,8 +4,21 @@
 
 #include "ast.h"
 
-// The type of Bison's parser stack elements (parse values)
-typedef AST YYSTYPE;
+// The type of Bison's parser stack elements (parse values).
+// Each is a pointer to an AST in the AST arena (see ast_arena),
+// with the same members as AST, so the parser's stack slots and
+// the copies its actions make are the size of a pointer,
+// not of the largest AST (a block_t).
+#define PARSE_VALUE_MEMBER(T, M) T *M;
+typedef union {
+    AST_MEMBERS(PARSE_VALUE_MEMBER)
+} YYSTYPE;
 #define YYSTYPE_IS_DECLARED 1
 
+// Adapts the result t of an ast_ constructor, which is the member
+// MEMBER of AST, into a parse value (a copy in the AST arena);
+// the constructors' arguments are the ASTs *$1, *$2, ..., as in
+//     $$ = AST_VALUE(block, ast_block(*$1, *$2, *$3, *$4));
+#define AST_VALUE(MEMBER, t) ast_##MEMBER##_value(t)
+
 #endif
@@ -0,0 +1,253 @@
+// A benchmark of the lexer's token dump written into a pipe, as when
+// the lexer's output is piped into another process. It lexes the given
+// files (repeated until there are megabytes of input) in a child
+// process whose standard output is a pipe, writing each token's line
+//   - with printf (the stdio path that lexer_print_token once used),
+//   - with the token writer copying its buffers into the pipe (write),
+//   - with the token writer splicing full buffers into it (vmsplice),
+// and reports the best time of its runs from the start of the child
+// to the end of the output. The output is read both by a reader that
+// copies it (read) and by one that splices its pages on to another
+// pipe and reads them later (splice), as zero-copy relays do; it fails
+// if any of these see different output.
+//
+// Usage: pipe_bench [-m megabytes] file.pl0 ...
+#define _GNU_SOURCE  // for splice and F_SETPIPE_SZ
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "input_file.h"
+#include "lexer.h"
+#include "token_writer.h"
+#include "utilities.h"
+
+#define PIPE_BENCH_DEFAULT_MEGABYTES 64
+#define PIPE_BENCH_RUNS 3
+#define PIPE_BENCH_CHUNK (1 << 16)
+#define PIPE_BENCH_RELAY_SIZE (1 << 20)
+
+// How the child writes the output
+typedef enum { write_stdio, write_copy, write_splice } writer_kind;
+static const char *writer_names[] = { "printf", "write", "vmsplice" };
+
+// How the parent reads it
+typedef enum { read_copy, read_splice } reader_kind;
+static const char *reader_names[] = { "read", "splice" };
+
+// What the reader saw
+typedef struct {
+    size_t bytes;
+    uint64_t hash;  // FNV-1a of the output
+} seen;
+
+// Return the current time in seconds
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Add the len chars at s to what s has seen
+static void see(seen *sn, const char *s, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+	sn->hash = (sn->hash ^ (unsigned char) s[i]) * 0x100000001B3ULL;
+    }
+    sn->bytes += len;
+}
+
+// Return the text of the files named in names[0..n), repeated
+// until it has at least size chars (setting *len to its length)
+static char *make_input(char *names[], int n, size_t size, size_t *len)
+{
+    input_file files[n];
+    size_t total = 0;
+    for (int i = 0; i < n; i++) {
+	error_status status;
+	if (!input_file_map(names[i], &files[i], &status)) {
+	    exit_with_error(&status);
+	}
+	total += files[i].len + 1;
+    }
+    size_t copies = (size + total - 1) / total;
+    char *text = (char *) malloc(copies * total + 1);
+    if (text == NULL) {
+	bail_with_error("Cannot allocate the input for pipe_bench!");
+    }
+    char *p = text;
+    for (size_t c = 0; c < copies; c++) {
+	for (int i = 0; i < n; i++) {
+	    memcpy(p, files[i].text, files[i].len);
+	    p += files[i].len;
+	    *p++ = '\n';
+	}
+    }
+    for (int i = 0; i < n; i++) {
+	input_file_unmap(&files[i]);
+    }
+    *len = (size_t) (p - text);
+    return text;
+}
+
+// In the child: lex the len chars at text, writing each token's line
+// on standard output as kind says, and exit
+static void write_output(const char *text, size_t len, writer_kind kind)
+{
+    lexer_set_token_values(false);
+    token_writer_use_splice(kind == write_splice);
+    lexer_init_buffer("pipe_bench", text, len, 1, 0);
+    lexer_token tok;
+    while (lexer_next_token(&tok)) {
+	if (kind == write_stdio) {
+	    printf("%-6d %-4d \"%s\"\n", tok.code, tok.line,
+		   lexer_token_text());
+	} else {
+	    lexer_print_token(tok.code, tok.line, lexer_token_text());
+	}
+    }
+    fflush(stdout);
+    token_writer_flush();
+    _exit(EXIT_SUCCESS);
+}
+
+// Read all of in by copying it
+static seen read_copied(int in)
+{
+    static char buf[PIPE_BENCH_CHUNK];
+    seen sn = { 0, 0xCBF29CE484222325ULL };
+    ssize_t n;
+    while ((n = read(in, buf, sizeof(buf))) > 0) {
+	see(&sn, buf, (size_t) n);
+    }
+    return sn;
+}
+
+// Read all of in by splicing its pages on to a relay pipe, which holds
+// up to about half its size before its oldest output is read
+static seen read_spliced(int in)
+{
+    static char buf[PIPE_BENCH_CHUNK];
+    seen sn = { 0, 0xCBF29CE484222325ULL };
+    int relay[2];
+    if (pipe(relay) != 0) {
+	bail_with_error("Cannot create a pipe for pipe_bench");
+    }
+    int size = fcntl(relay[0], F_SETPIPE_SZ, PIPE_BENCH_RELAY_SIZE);
+    if (size < 0) {
+	size = fcntl(relay[0], F_GETPIPE_SZ);
+    }
+    size_t lag = (size > 2 * PIPE_BENCH_CHUNK) ? (size_t) size / 2 : 0;
+    size_t held = 0;
+    for (;;) {
+	ssize_t n = splice(in, NULL, relay[1], NULL, PIPE_BENCH_CHUNK,
+			   SPLICE_F_MOVE);
+	if (n <= 0) {
+	    break;
+	}
+	held += (size_t) n;
+	while (held > lag) {
+	    ssize_t m = read(relay[0], buf, sizeof(buf));
+	    if (m <= 0) {
+		bail_with_error("Cannot read the relay pipe in pipe_bench");
+	    }
+	    see(&sn, buf, (size_t) m);
+	    held -= (size_t) m;
+	}
+    }
+    close(relay[1]);
+    ssize_t m;
+    while ((m = read(relay[0], buf, sizeof(buf))) > 0) {
+	see(&sn, buf, (size_t) m);
+    }
+    close(relay[0]);
+    return sn;
+}
+
+// Run the child writing the output of the len chars at text as writer
+// says and read it as reader says, returning what was read
+// (and setting *secs to the time taken)
+static seen run(const char *text, size_t len, writer_kind writer,
+		reader_kind reader, double *secs)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+	bail_with_error("Cannot create a pipe for pipe_bench");
+    }
+    fflush(stdout);
+    double start = now();
+    pid_t pid = fork();
+    if (pid < 0) {
+	bail_with_error("Cannot start a writer for pipe_bench");
+    } else if (pid == 0) {
+	close(fds[0]);
+	if (dup2(fds[1], STDOUT_FILENO) < 0) {
+	    _exit(EXIT_FAILURE);
+	}
+	close(fds[1]);
+	write_output(text, len, writer);
+    }
+    close(fds[1]);
+    seen sn = (reader == read_copy) ? read_copied(fds[0])
+	: read_spliced(fds[0]);
+    close(fds[0]);
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)
+	|| WEXITSTATUS(status) != EXIT_SUCCESS) {
+	bail_with_error("The writer of pipe_bench failed");
+    }
+    *secs = now() - start;
+    return sn;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t megabytes = PIPE_BENCH_DEFAULT_MEGABYTES;
+    int i = 1;
+    if (i + 1 < argc && strcmp(argv[i], "-m") == 0) {
+	megabytes = strtoul(argv[i+1], NULL, 10);
+	i += 2;
+    }
+    if (i >= argc || megabytes == 0) {
+	bail_with_error("Usage: %s [-m megabytes] file.pl0 ...", argv[0]);
+    }
+    size_t len;
+    char *text = make_input(argv + i, argc - i, megabytes << 20, &len);
+
+    seen expected = { 0, 0 };
+    bool differs = false;
+    printf("%-10s %-8s %12s %10s %10s\n", "writer", "reader", "bytes",
+	   "ms", "MB/s");
+    for (int w = write_stdio; w <= write_splice; w++) {
+	for (int r = read_copy; r <= read_splice; r++) {
+	    double best = 0.0;
+	    seen sn;
+	    for (int run_no = 0; run_no < PIPE_BENCH_RUNS; run_no++) {
+		double t;
+		sn = run(text, len, w, r, &t);
+		if (run_no == 0 || t < best) {
+		    best = t;
+		}
+	    }
+	    if (w == write_stdio && r == read_copy) {
+		expected = sn;
+	    }
+	    bool same = sn.bytes == expected.bytes && sn.hash == expected.hash;
+	    differs = differs || !same;
+	    printf("%-10s %-8s %12zu %10.1f %10.1f%s\n", writer_names[w],
+		   reader_names[r], sn.bytes, best * 1e3,
+		   sn.bytes / best / (1 << 20), same ? "" : "  DIFFERS");
+	}
+    }
+    free(text);
+    if (differs) {
+	fprintf(stderr, "pipe_bench: the output differs between runs!\n");
+	return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
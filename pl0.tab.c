@@ -527,7 +527,7 @@ static const yytype_int8 yytranslate[] =
 /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
 static const yytype_uint8 yyrline[] =
 {
-       0,   115,   115,   117,   121,   123,   125,   127,   134,   137
+       0,   115,   115,   117,   121,   124,   126,   129,   133,   136
 };
 #endif
 
@@ -1686,60 +1686,54 @@ yyreduce:
       {
   case 2: /* program: block "."  */
 #line 115 "pl0.y"
-                    { setProgAST((yyvsp[-1].block)); }
+                    { setProgAST(*(yyvsp[-1].block)); }
 #line 1691 "pl0.tab.c"
     break;
 
   case 3: /* block: constDecls varDecls procDecls stmt  */
 #line 118 "pl0.y"
-        { (yyval.block) = ast_block((yyvsp[-3].const_decls),(yyvsp[-2].var_decls),(yyvsp[-1].proc_decls),(yyvsp[0].stmt)); }
+        { (yyval.block) = AST_VALUE(block, ast_block(*(yyvsp[-3].const_decls), *(yyvsp[-2].var_decls), *(yyvsp[-1].proc_decls), *(yyvsp[0].stmt))); }
 #line 1697 "pl0.tab.c"
     break;
 
   case 4: /* constDecls: empty  */
-#line 121 "pl0.y"
-                   { (yyval.const_decls) = ast_const_decls_empty((yyvsp[0].empty)); }
+#line 122 "pl0.y"
+             { (yyval.const_decls) = AST_VALUE(const_decls, ast_const_decls_empty(*(yyvsp[0].empty))); }
 #line 1703 "pl0.tab.c"
     break;
 
   case 5: /* varDecls: empty  */
-#line 123 "pl0.y"
-                 { (yyval.var_decls) = ast_var_decls_empty((yyvsp[0].empty)); }
+#line 124 "pl0.y"
+                 { (yyval.var_decls) = AST_VALUE(var_decls, ast_var_decls_empty(*(yyvsp[0].empty))); }
 #line 1709 "pl0.tab.c"
     break;
 
   case 6: /* procDecls: empty  */
-#line 125 "pl0.y"
-                  { (yyval.proc_decls) = ast_proc_decls_empty((yyvsp[0].empty)); }
+#line 127 "pl0.y"
+            { (yyval.proc_decls) = AST_VALUE(proc_decls, ast_proc_decls_empty(*(yyvsp[0].empty))); }
 #line 1715 "pl0.tab.c"
     break;
 
   case 7: /* empty: %empty  */
-#line 128 "pl0.y"
-        { file_location *file_loc
-	     = file_location_make(lexer_filename(), lexer_line());
-          (yyval.empty) = ast_empty(file_loc);
-	}
-#line 1724 "pl0.tab.c"
+#line 130 "pl0.y"
+        { (yyval.empty) = AST_VALUE(empty, ast_empty(lexer_location())); }
+#line 1721 "pl0.tab.c"
     break;
 
   case 8: /* stmt: skipStmt  */
-#line 134 "pl0.y"
-                 { (yyval.stmt) = ast_stmt_skip((yyvsp[0].skip_stmt)); }
-#line 1730 "pl0.tab.c"
+#line 133 "pl0.y"
+                 { (yyval.stmt) = AST_VALUE(stmt, ast_stmt_skip(*(yyvsp[0].skip_stmt))); }
+#line 1727 "pl0.tab.c"
     break;
 
   case 9: /* skipStmt: "skip"  */
 #line 137 "pl0.y"
-                  { file_location *file_loc
-	            = file_location_make(lexer_filename(), lexer_line());
-                    (yyval.skip_stmt) = ast_skip_stmt(file_loc);
-                  }
-#line 1739 "pl0.tab.c"
+           { (yyval.skip_stmt) = AST_VALUE(skip_stmt, ast_skip_stmt(lexer_location())); }
+#line 1733 "pl0.tab.c"
     break;
 
 
-#line 1743 "pl0.tab.c"
+#line 1737 "pl0.tab.c"
 
         default: break;
       }
@@ -1979,7 +1973,7 @@ yyreturnlab:
   return yyresult;
 }
 
-#line 143 "pl0.y"
+#line 140 "pl0.y"
 
 
 // Set the program's ast to be t
@@ -112,32 +112,29 @@ extern void setProgAST(block_t t);
 
  /* the context-free grammar is intentionally very incomplete at this stage. */
 
-program : block "." { setProgAST($1); } ;
+program : block "." { setProgAST(*$1); } ;
 
 block : constDecls varDecls procDecls stmt
-        { $$ = ast_block($1,$2,$3,$4); }
+        { $$ = AST_VALUE(block, ast_block(*$1, *$2, *$3, *$4)); }
         ;
 
-constDecls : empty { $$ = ast_const_decls_empty($1); } ;
+constDecls : empty
+             { $$ = AST_VALUE(const_decls, ast_const_decls_empty(*$1)); } ;
 
-varDecls : empty { $$ = ast_var_decls_empty($1); } ;
+varDecls : empty { $$ = AST_VALUE(var_decls, ast_var_decls_empty(*$1)); } ;
 
-procDecls : empty { $$ = ast_proc_decls_empty($1); } ;
+procDecls : empty
+            { $$ = AST_VALUE(proc_decls, ast_proc_decls_empty(*$1)); } ;
 
 empty : %empty
-        { file_location *file_loc
-	     = file_location_make(lexer_filename(), lexer_line());
-          $$ = ast_empty(file_loc);
-	}
+        { $$ = AST_VALUE(empty, ast_empty(lexer_location())); }
         ;
 
-stmt : skipStmt  { $$ = ast_stmt_skip($1); }
+stmt : skipStmt  { $$ = AST_VALUE(stmt, ast_stmt_skip(*$1)); }
      ;
 
-skipStmt : "skip" { file_location *file_loc
-	            = file_location_make(lexer_filename(), lexer_line());
-                    $$ = ast_skip_stmt(file_loc);
-                  }
+skipStmt : "skip"
+           { $$ = AST_VALUE(skip_stmt, ast_skip_stmt(lexer_location())); }
          ;
 
 %%
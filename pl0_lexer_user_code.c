@@ -5,18 +5,160 @@
 /* This code goes in the user code section of the pl0_lexer.l file,
    following the last %% above. */
 
+/* The flex buffer made by lexer_init_buffer (or NULL) */
+static YY_BUFFER_STATE scan_buffer = NULL;
+
+/* Was the input opened by lexer_open, so failures to read it
+   are noted in input_status instead of ending the program? */
+static bool recoverable = false;
+
+/* How reading the input opened by lexer_open has gone */
+static error_status input_status;
+
+// Start reading yyin from the beginning of its current buffer,
+// numbering lines from line and offsets from offset
+static void lexer_restart(unsigned int line, size_t offset)
+{
+    if (scan_buffer != NULL) {
+	yy_delete_buffer(scan_buffer);
+	scan_buffer = NULL;
+    }
+    yyrestart(yyin);
+    input_exhausted = false;
+    yylineno = line;
+    buffer_offset = offset;
+}
+
 // Requires: fname != NULL
 // Requires: fname is the name of a readable file
 // Initialize the lexer and start it reading
 // from the given file name
 void lexer_init(char *fname)
+{
+    if (!lexer_open(fname, &input_status)) {
+	exit_with_error(&input_status);
+    }
+    recoverable = false;
+}
+
+// Requires: fname != NULL and status != NULL
+// Initialize the lexer and start it reading from the given file name,
+// returning true; but if the file cannot be opened,
+// fill in *status and return false.
+// A failure to read or close the file is noted instead of ending
+// the program (see lexer_input_status).
+bool lexer_open(char *fname, error_status *status)
 {
     errors_noted = false;
+    clear_error(&input_status);
+    if (yyin != NULL && yyin != stdin) {
+	fclose(yyin);  // an input that was not read to its end
+    }
+    errno = 0;
     yyin = fopen(fname, "r");
     if (yyin == NULL) {
-	bail_with_error("Cannot open %s", fname);
+	return fail_with_error(status, "Cannot open %s", fname);
     }
+    errno = 0;
+    recoverable = true;
     filename = fname;
+    file_interned = false;
+    diagnostics_begin_file(fname);
+    lexer_restart(1, 0);
+    return true;
+}
+
+// Requires: status != NULL
+// Return true if the input opened by lexer_open has been read
+// (so far) and closed without failing, otherwise fill in *status
+// and return false; a failure to read it ends the input early
+bool lexer_input_status(error_status *status)
+{
+    if (input_status.failed) {
+	*status = input_status;
+	return false;
+    }
+    return true;
+}
+
+// Requires: buf != NULL
+// Initialize the lexer and start it reading the len chars at buf,
+// which are the text starting at the given line and byte offset
+// of the file named fname
+void lexer_init_buffer(const char *fname, const char *buf, size_t len,
+		       unsigned int line, size_t offset)
+{
+    if (YY_CURRENT_BUFFER != NULL) {
+	yy_delete_buffer(YY_CURRENT_BUFFER);
+    }
+    scan_buffer = yy_scan_bytes(buf, (int) len);
+    errors_noted = false;
+    clear_error(&input_status);
+    filename = (char *) fname;
+    file_interned = false;
+    diagnostics_begin_file(fname);
+    input_exhausted = false;
+    yylineno = line;
+    buffer_offset = offset;
+}
+
+// Set whether the lexer sets yylval for each token;
+// the parser needs these values, but tools that only look at
+// the token codes and text do not.
+void lexer_set_token_values(bool on)
+{
+    token_values = on;
+}
+
+// Does the lexer set yylval for each token?
+bool lexer_token_values()
+{
+    return token_values;
+}
+
+#if LEXER_MAX_LEXEME_LIMIT > YY_BUF_SIZE / 2
+#error "LEXER_MAX_LEXEME_LIMIT must leave room in the flex buffer"
+#endif
+
+// Set the length above which identifiers and numbers are not kept
+// in full, which is forced into the range from
+// LEXER_MIN_LEXEME_LIMIT to LEXER_MAX_LEXEME_LIMIT
+void lexer_set_lexeme_limit(size_t limit)
+{
+    if (limit < LEXER_MIN_LEXEME_LIMIT) {
+	limit = LEXER_MIN_LEXEME_LIMIT;
+    } else if (limit > LEXER_MAX_LEXEME_LIMIT) {
+	limit = LEXER_MAX_LEXEME_LIMIT;
+    }
+    lexeme_limit = limit;
+}
+
+// Return the length above which identifiers and numbers are not kept
+size_t lexer_lexeme_limit()
+{
+    return lexeme_limit;
+}
+
+// Read up to max_size bytes from yyin into buf,
+// as flex does by default for a non-interactive file,
+// and return the number of bytes read (0 at the end of the file)
+static size_t read_input(char *buf, size_t max_size)
+{
+    size_t n;
+    errno = 0;
+    while ((n = fread(buf, 1, max_size, yyin)) == 0 && ferror(yyin)) {
+	if (errno != EINTR && recoverable) {
+	    fail_with_error(&input_status, "Cannot read %s", filename);
+	    errno = 0;
+	    break;  // the input ends here
+	} else if (errno != EINTR) {
+	    YY_FATAL_ERROR("input in flex scanner failed");
+	    break;
+	}
+	errno = 0;
+	clearerr(yyin);
+    }
+    return n;
 }
 
 // Close the file yyin
@@ -24,14 +166,422 @@ void lexer_init(char *fname)
 int yywrap() {
     if (yyin != NULL) {
 	int rc = fclose(yyin);
-	if (rc == EOF) {
+	yyin = NULL;
+	if (rc == EOF && recoverable) {
+	    fail_with_error(&input_status, "Cannot close %s!", filename);
+	    errno = 0;
+	} else if (rc == EOF) {
 	    bail_with_error("Cannot close %s!", filename);
 	}
     }
     filename = NULL;
+    input_exhausted = true;
     return 1;  /* no more input */
 }
 
+// Return a pointer to the next unread byte in the current flex buffer,
+// first doing the initialization that the DFA does on its first call
+static char *scan_position()
+{
+    if (!yy_init) {
+	yy_init = 1;
+	if (!yy_start) {
+	    yy_start = 1;
+	}
+	if (!yyin) {
+	    yyin = stdin;
+	}
+	if (!yyout) {
+	    yyout = stdout;
+	}
+	if (!YY_CURRENT_BUFFER) {
+	    yyensure_buffer_stack();
+	    YY_CURRENT_BUFFER_LVALUE = yy_create_buffer(yyin, YY_BUF_SIZE);
+	}
+	yy_load_buffer_state();
+    }
+    // undo the null char that ended the previous yytext
+    *yy_c_buf_p = yy_hold_char;
+    return yy_c_buf_p;
+}
+
+// Return a pointer to the end of the text in the current flex buffer
+static char *buffer_end()
+{
+    return &YY_CURRENT_BUFFER_LVALUE->yy_ch_buf[yy_n_chars];
+}
+
+// Requires: p points into the current flex buffer
+// Return the offset in the input of the char at p
+static size_t input_offset(const char *p)
+{
+    return buffer_offset + (size_t) (p - YY_CURRENT_BUFFER_LVALUE->yy_ch_buf);
+}
+
+// Requires: p == buffer_end()
+// Read more input into the flex buffer, discarding everything before p,
+// and return a pointer to the next unread byte,
+// or NULL if all of the input has been read.
+static char *refill(char *p)
+{
+    // nothing before p needs to be kept, so flex never grows its buffer
+    yytext_ptr = yy_c_buf_p = p;
+    yy_hold_char = *p;
+    int c = input();
+    if (input_exhausted) {
+	return NULL;
+    }
+    // put back the byte that input() consumed
+    *--yy_c_buf_p = (char) c;
+    yy_hold_char = (char) c;
+    if (c == '\n') {
+	yylineno--;
+    }
+    return yy_c_buf_p;
+}
+
+// Requires: *p == '#'
+// Skip over the comment starting at p, and return a pointer
+// to the newline that ends it (or NULL at the end of the input)
+static char *skip_comment(char *p)
+{
+    for (;;) {
+	char *end = buffer_end();
+	char *nl = memchr(p, '\n', end - p);
+	if (nl != NULL) {
+	    return nl;
+	}
+	p = refill(end);
+	if (p == NULL) {
+	    return NULL;
+	}
+    }
+}
+
+// Requires: *p is a non-ASCII byte
+// Skip over the run of non-ASCII bytes starting at p,
+// reporting the whole run as a single error,
+// and return a pointer to the byte following the run
+// (or NULL at the end of the input)
+static char *skip_non_ascii(char *p)
+{
+    // saved now, as reaching the end of the input forgets the file name
+    const char *fname = lexer_filename();
+    unsigned char lead = (unsigned char) *p;
+    error_offset = input_offset(p);
+    utf8_decoder d;
+    utf8_decoder_init(&d);
+    while (p != NULL) {
+	char *end = buffer_end();
+	size_t n = utf8_nonascii_span(p, end - p);
+	utf8_decoder_feed(&d, p, n);
+	p += n;
+	if (p < end) {
+	    break;
+	}
+	p = refill(p);
+    }
+    char msgbuf[512];
+    if (!utf8_decoder_finish(&d)) {
+	sprintf(msgbuf, "invalid UTF-8 sequence of %zu byte(s)"
+		" starting with '\\0%o'", d.bytes, lead);
+	lexical_error(diagnostic_invalid_utf8, fname, NULL, 0, msgbuf);
+    } else {
+	char ch[UTF8_MAX_BYTES+1];
+	utf8_encode(d.first, ch);
+	if (d.count == 1) {
+	    sprintf(msgbuf, "invalid character: '%s' (U+%04X)", ch, d.first);
+	} else {
+	    sprintf(msgbuf, "invalid characters: '%s' (U+%04X) and %u more",
+		    ch, d.first, d.count - 1);
+	}
+	lexical_error(diagnostic_non_ascii, fname, ch, strlen(ch), msgbuf);
+    }
+    return p;
+}
+
+// An operator or punctuation token, as recognized by yylex
+typedef struct {
+    int code;          // 0 if there is no such token
+    const char *text;
+    int len;
+} punct;
+
+// all entries of a row for a one-char token
+#define PUNCT1(code, text) \
+    { { code, text, 1 }, { code, text, 1 }, { code, text, 1 } }
+
+// The operator and punctuation tokens, indexed by the row of their
+// first char (punct_row) and the column of the char after it
+// (punct_col), so a two-char token is found with a single lookup
+static const punct punct_table[][3] = {
+    PUNCT1(0, NULL),
+    PUNCT1(plussym, "+"), PUNCT1(minussym, "-"),
+    PUNCT1(multsym, "*"), PUNCT1(divsym, "/"),
+    PUNCT1(periodsym, "."), PUNCT1(semisym, ";"),
+    PUNCT1(eqsym, "="), PUNCT1(commasym, ","),
+    PUNCT1(lparensym, "("), PUNCT1(rparensym, ")"),
+    { { ltsym, "<", 1 }, { leqsym, "<=", 2 }, { neqsym, "<>", 2 } },
+    { { gtsym, ">", 1 }, { geqsym, ">=", 2 }, { gtsym, ">", 1 } },
+    { { 0, ":", 1 }, { becomessym, ":=", 2 }, { 0, ":", 1 } },
+};
+
+// The row in punct_table for each char (0 if it starts no token there)
+static const unsigned char punct_row[256] = {
+    ['+'] = 1, ['-'] = 2, ['*'] = 3, ['/'] = 4, ['.'] = 5, [';'] = 6,
+    ['='] = 7, [','] = 8, ['('] = 9, [')'] = 10, ['<'] = 11, ['>'] = 12,
+    [':'] = 13,
+};
+
+// The column in punct_table for each char that follows a token's first
+static const unsigned char punct_col[256] = { ['='] = 1, ['>'] = 2 };
+
+// Requires: t->code != 0 and t's text starts at p
+// Return the token t (setting yylval and yytext as the DFA would),
+// without running the DFA
+static int punct_token(char *p, const punct *t)
+{
+    token_truncated = false;
+    token_offset = input_offset(p);
+    error_offset = token_offset;
+    yytext = p;
+    yyleng = t->len;
+    yy_c_buf_p = p + t->len;
+    yy_hold_char = *yy_c_buf_p;
+    *yy_c_buf_p = '\0';
+    punct2ast(t->code, t->text);
+    return t->code;
+}
+
+// Return true just when c is an identifier character
+static bool is_ident_char(unsigned char c)
+{
+    return isalnum(c) || c == '_';
+}
+
+// Return a pointer to the first char at or after p and before end
+// that cannot continue a number (if number is true)
+// or an identifier (otherwise)
+static char *lexeme_end(char *p, char *end, bool number)
+{
+    if (number) {
+	while (p < end && isdigit((unsigned char) *p)) {
+	    p++;
+	}
+    } else {
+	while (p < end && is_ident_char((unsigned char) *p)) {
+	    p++;
+	}
+    }
+    return p;
+}
+
+// Return the 64-bit FNV-1a hash of the len chars at p,
+// continuing from the hash h of the chars before them
+static uint64_t hash_chars(uint64_t h, const char *p, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+	h = (h ^ (unsigned char) p[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// the FNV-1a hash of no chars
+#define HASH_INIT 0xcbf29ce484222325ULL
+
+// Requires: the current flex buffer is read from a file
+// Move the text from p to the end of the flex buffer to the start
+// of the buffer and read more input after it (as flex does when a
+// token reaches the end of the buffer),
+// returning the number of bytes read (0 at the end of the input)
+static size_t shift_buffer(char *p)
+{
+    YY_BUFFER_STATE b = YY_CURRENT_BUFFER_LVALUE;
+    size_t keep = (size_t) (buffer_end() - p);
+    buffer_offset += (size_t) (p - b->yy_ch_buf);
+    memmove(b->yy_ch_buf, p, keep);
+    size_t room = (size_t) b->yy_buf_size - keep - 1;
+    if (room > YY_READ_BUF_SIZE) {
+	room = YY_READ_BUF_SIZE;
+    }
+    size_t n = read_input(b->yy_ch_buf + keep, room);
+    yy_n_chars = (int) (keep + n);
+    b->yy_n_chars = yy_n_chars;
+    b->yy_ch_buf[yy_n_chars] = YY_END_OF_BUFFER_CHAR;
+    b->yy_ch_buf[yy_n_chars + 1] = YY_END_OF_BUFFER_CHAR;
+    yytext_ptr = yy_c_buf_p = b->yy_ch_buf;
+    yy_hold_char = *yy_c_buf_p;
+    return n;
+}
+
+// Requires: the identifier or number (as given by number) starting
+//           at p is longer than the lexeme limit and runs at least to q
+// Consume the identifier or number, keeping only its length, hash and
+// a prefix of it as the token's text, report it as an error,
+// and return its token code (setting yylval to its prefix).
+// Memory use does not depend on its length, as each buffer full of it
+// is discarded once it has been hashed.
+static int long_lexeme(char *p, char *q, bool number)
+{
+    // saved now, as reaching the end of the input forgets the file name
+    const char *fname = lexer_filename();
+    token_offset = input_offset(p);
+    error_offset = token_offset;
+    size_t n = (size_t) (q - p);
+    if (n > LEXER_LEXEME_PREFIX) {
+	n = LEXER_LEXEME_PREFIX;
+    }
+    memcpy(long_text, p, n);
+    long_text[n] = '\0';
+    long_hash = hash_chars(HASH_INIT, p, (size_t) (q - p));
+    long_length = (size_t) (q - p);
+    while (q == buffer_end()) {
+	q = refill(q);
+	if (q == NULL) {
+	    break;
+	}
+	char *e = lexeme_end(q, buffer_end(), number);
+	long_hash = hash_chars(long_hash, q, (size_t) (e - q));
+	long_length += (size_t) (e - q);
+	q = e;
+    }
+    if (q != NULL) {
+	yy_c_buf_p = q;
+	yy_hold_char = *q;
+    }
+    token_truncated = true;
+    yytext = long_text;
+    yyleng = (int) n;
+
+    char msgbuf[512];
+    if (number) {
+	// it is too long, whatever its value (it may have leading zeros)
+	sprintf(msgbuf, "Number (%s...) of %zu digits is longer"
+		" than the limit of %zu", long_text, long_length, lexeme_limit);
+	lexical_error(diagnostic_number_too_long, fname, long_text, n,
+		      msgbuf);
+	number2ast(numbersym);
+	return numbersym;
+    }
+    sprintf(msgbuf, "identifier (%s...) of %zu characters is longer"
+	    " than the limit of %zu", long_text, long_length, lexeme_limit);
+    lexical_error(diagnostic_identifier_too_long, fname, long_text, n,
+		  msgbuf);
+    ident2ast(yytext);
+    return identsym;
+}
+
+// Requires: *p starts an identifier or a number
+// Make sure that all of the identifier or number starting at p
+// is in the flex buffer, so the DFA never has to grow the buffer for it,
+// and return a pointer to its start;
+// but if it is longer than the lexeme limit, return NULL
+// with *code set to the token code returned by long_lexeme.
+static char *whole_lexeme(char *p, int *code)
+{
+    bool number = isdigit((unsigned char) *p);
+    char *q = p;
+    for (;;) {
+	char *end = buffer_end();
+	q = lexeme_end(q, end, number);
+	size_t len = (size_t) (q - p);
+	if (len > lexeme_limit) {
+	    *code = long_lexeme(p, q, number);
+	    return NULL;
+	}
+	if (q < end || !YY_CURRENT_BUFFER_LVALUE->yy_fill_buffer) {
+	    return p;  // no more of it can be in the input
+	}
+	size_t n = shift_buffer(p);
+	p = YY_CURRENT_BUFFER_LVALUE->yy_ch_buf;
+	if (n == 0) {
+	    return p;
+	}
+	q = p + len;
+    }
+}
+
+// Return the next token from the input (setting yylval),
+// or YYEOF at the end of the input.
+// Whitespace, comments and characters that cannot start a token
+// are consumed here, so the DFA (pl0_dfa_lex) only sees tokens;
+// comments are skipped with memchr and a run of non-ASCII bytes
+// (e.g., UTF-8 text) is reported as one error.
+// Operators and punctuation are found by table lookup (punct_token),
+// so the DFA only runs for identifiers, reserved words and numbers
+// (and for the rare token that straddles the end of the flex buffer).
+int yylex(YYSTYPE *lvalp)
+{
+    if (input_exhausted) {
+	return YYEOF;
+    }
+    char *p = scan_position();
+    for (;;) {
+	unsigned char c = (unsigned char) *p;
+	switch (c) {
+	case ' ': case '\t': case '\v': case '\f': case '\r':
+	    p++;
+	    break;
+	case '\n':
+	    yylineno++;
+	    p++;
+	    break;
+	case '#':
+	    p = skip_comment(p);
+	    break;
+	case '\0':
+	    if (p != buffer_end()) {
+		goto dfa;  // a null char in the input
+	    }
+	    p = refill(p);
+	    break;
+	default:
+	    if (punct_row[c] != 0) {
+		if (p + 1 == buffer_end()) {
+		    goto dfa;  // the next char has not been read yet
+		}
+		const punct *t =
+		    &punct_table[punct_row[c]][punct_col[(unsigned char) p[1]]];
+		if (t->code != 0) {
+		    return punct_token(p, t);
+		}
+		error_offset = input_offset(p);
+		invalid_char(c);  // a ':' not followed by '='
+		p++;
+	    } else if (c >= 0x80) {
+		p = skip_non_ascii(p);
+	    } else if (is_ident_char(c)) {
+		int code;
+		p = whole_lexeme(p, &code);
+		if (p == NULL) {
+		    return code;
+		}
+		goto dfa;
+	    } else {
+		error_offset = input_offset(p);
+		invalid_char(c);
+		p++;
+	    }
+	    break;
+	}
+	if (p == NULL) {
+	    return YYEOF;
+	}
+    }
+ dfa:
+    token_truncated = false;
+    // errors found by the DFA are about the text starting at p
+    error_offset = input_offset(p);
+    yy_c_buf_p = p;
+    yy_hold_char = *p;
+    int t = pl0_dfa_lex(lvalp);
+    if (t != YYEOF) {
+	token_offset = input_offset(yytext);
+	error_offset = token_offset;
+    }
+    return t;
+}
+
 // Return the name of the current input file
 const char *lexer_filename() {
     return filename;
@@ -42,29 +592,123 @@ unsigned int lexer_line() {
     return yylineno;
 }
 
+// Return the location of the next token
+// (interning the current file's name in the file table)
+file_location lexer_location() {
+    if (!file_interned) {
+	file_number = file_table_intern((filename == NULL) ? "" : filename);
+	file_interned = true;
+    }
+    return (file_location) { file_number, yylineno };
+}
+
+// Return the byte offset in the input of the last token read
+size_t lexer_token_offset() {
+    return token_offset;
+}
+
+// Return the length in bytes of the last token read
+size_t lexer_token_length() {
+    return token_truncated ? long_length : (size_t) yyleng;
+}
+
+// Was the text of the last token read truncated?
+bool lexer_token_truncated() {
+    return token_truncated;
+}
+
+// Return a hash of the (whole) text of the last token read
+uint64_t lexer_token_hash() {
+    if (token_truncated) {
+	return long_hash;
+    }
+    return hash_chars(HASH_INIT, yytext, (size_t) yyleng);
+}
+
+// Return the text of the last token read,
+// which is only valid until the next token is read
+const char *lexer_token_text() {
+    return yytext;
+}
+
+// Requires: tok != NULL
+// Read the next token into *tok, returning false at the end of the input
+bool lexer_next_token(lexer_token *tok)
+{
+    YYSTYPE dummy;
+    int t = yylex(&dummy);
+    if (t == YYEOF) {
+	return false;
+    }
+    tok->code = t;
+    tok->line = yylineno;
+    tok->offset = token_offset;
+    tok->length = lexer_token_length();
+    return true;
+}
+
+/* The function told about each error reported (or NULL) */
+static lexer_error_hook error_hook = NULL;
+
+// Set the function to call with the line and message of each error
+// that is reported (NULL for none)
+void lexer_set_error_hook(lexer_error_hook hook)
+{
+    error_hook = hook;
+}
+
+/* Report an error at the given line and offset of the named file
+   (through the diagnostics sink, which writes it with the output) */
+static void report_error(diagnostic_kind kind, const char *filename,
+			 unsigned int line, size_t offset,
+			 const char *text, size_t len, const char *msg)
+{
+    diagnostics_report(kind, filename, line, offset, text, len, msg);
+    errors_noted = true;
+    if (error_hook != NULL) {
+	error_hook(line, msg);
+    }
+}
+
+// Report an error at the given line of the current file,
+// as yyerror does
+void lexer_report_error(unsigned int line, const char *msg)
+{
+    report_error(diagnostic_other, lexer_filename(), line, token_offset,
+		 NULL, 0, msg);
+}
+
 /* Report an error to the user on stderr */
 void yyerror(const char *filename, const char *msg)
 {
-    fflush(stdout);
-    fprintf(stderr, "%s:%d: %s\n", filename, lexer_line(), msg);
-    errors_noted = true;
+    report_error(diagnostic_other, filename, lexer_line(), error_offset,
+		 NULL, 0, msg);
+}
+
+/* Report an error of the given kind about the len chars at text,
+   at error_offset in the file named fname */
+static void lexical_error(diagnostic_kind kind, const char *fname,
+			  const char *text, size_t len, const char *msg)
+{
+    report_error(kind, fname, lexer_line(), error_offset, text, len, msg);
 }
 
-// On standard output:
+// On standard output (through the token writer):
 // Print a message about the file name of the lexer's input
 // and then print a heading for the lexer's output.
 void lexer_print_output_header()
 {
-    printf("Tokens from file %s\n", lexer_filename());
-    printf("%-6s %-4s  %s\n", "Number", "Line", "Text");
+    token_writer_puts("Tokens from file ");
+    token_writer_puts(lexer_filename());
+    token_writer_puts("\nNumber Line  Text\n");
 }
 
 // Print information about the token t to stdout
-// followed by a newline
+// (through the token writer) followed by a newline
 void lexer_print_token(enum yytokentype t, unsigned int tline,
 		       const char *txt)
 {
-    printf("%-6d %-4d \"%s\"\n", t, tline, txt);
+    token_writer_put_token(t, tline, txt);
 }
 
 
@@ -74,7 +718,10 @@ void lexer_print_token(enum yytokentype t, unsigned int tline,
 void lexer_output()
 {
     lexer_print_output_header();
-    AST dummy;
+    // only the text of each token is printed, so yylval is not needed
+    bool values = token_values;
+    token_values = false;
+    YYSTYPE dummy;
     yytoken_kind_t t;
     do {
 	t = yylex(&dummy);
@@ -83,4 +730,6 @@ void lexer_output()
         }
         lexer_print_token(t, yylineno, yytext);
     } while (t != YYEOF);
+    token_values = values;
+    token_writer_flush();
 }
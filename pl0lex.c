@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+#include "utilities.h"
+#include "lexer.h"
+#include "diagnostics.h"
+#include "token_info.h"
+#include "pl0lex.h"
+
+#if PL0LEX_LEXEME_PREFIX != LEXER_LEXEME_PREFIX
+#error "PL0LEX_LEXEME_PREFIX must be LEXER_LEXEME_PREFIX"
+#endif
+
+// A scanner's settings and last failure
+struct pl0lex_scanner {
+    size_t lexeme_limit;
+    error_status status;
+};
+
+// The handler of the scan that is running (for the lexer's error hook)
+static const pl0lex_handler *running = NULL;
+
+// Return the version of the library that is linked in
+int pl0lex_version(void)
+{
+    return PL0LEX_VERSION_MAJOR * 1000 + PL0LEX_VERSION_MINOR;
+}
+
+// Return a new scanner with the default settings (NULL if out of memory)
+pl0lex_scanner *pl0lex_create(void)
+{
+    pl0lex_scanner *s = malloc(sizeof(pl0lex_scanner));
+    if (s != NULL) {
+	s->lexeme_limit = LEXER_DEFAULT_LEXEME_LIMIT;
+	clear_error(&s->status);
+    }
+    return s;
+}
+
+// Free the scanner s (which may be NULL)
+void pl0lex_destroy(pl0lex_scanner *s)
+{
+    free(s);
+}
+
+// Set the length above which s does not keep identifiers and numbers
+// in full
+void pl0lex_set_lexeme_limit(pl0lex_scanner *s, size_t limit)
+{
+    s->lexeme_limit = limit;
+}
+
+// Return the message for the last failure of a scan by s
+const char *pl0lex_last_error(const pl0lex_scanner *s)
+{
+    return s->status.failed ? s->status.message : "";
+}
+
+// Return the symbolic name of the token code
+const char *pl0lex_token_name(int code)
+{
+    return token_name(code);
+}
+
+// Pass an error the lexer reports to the running scan's handler
+static void pass_error(unsigned int line, const char *msg)
+{
+    if (running != NULL && running->error != NULL) {
+	running->error(running->arg, line, msg);
+    }
+}
+
+// Set up the lexer for a scan by s with the handler h
+static void start_scan(pl0lex_scanner *s, const pl0lex_handler *h)
+{
+    // errors go only to the handler, and no ASTs are built for tokens
+    diagnostics_set_format(diagnostics_none);
+    lexer_set_error_hook(pass_error);
+    lexer_set_token_values(false);
+    lexer_set_lexeme_limit(s->lexeme_limit);
+    clear_error(&s->status);
+    running = h;
+}
+
+// Pass each token of the lexer's input to h's token function,
+// returning pl0lex_stopped if it stops the scan
+static pl0lex_status pass_tokens(const pl0lex_handler *h)
+{
+    lexer_token tok;
+    while (lexer_next_token(&tok)) {
+	if (h == NULL || h->token == NULL) {
+	    continue;
+	}
+	pl0lex_token t = { tok.code, tok.line, tok.offset, tok.length };
+	if (h->token(h->arg, &t, lexer_token_text()) != 0) {
+	    return pl0lex_stopped;
+	}
+    }
+    return pl0lex_ok;
+}
+
+// Lex the len bytes at buf, whose name is name, calling h's functions
+pl0lex_status pl0lex_scan_buffer(pl0lex_scanner *s, const char *name,
+				 const char *buf, size_t len,
+				 const pl0lex_handler *h)
+{
+    if (s == NULL || name == NULL || (buf == NULL && len > 0)) {
+	return pl0lex_bad_argument;
+    }
+    start_scan(s, h);
+    lexer_init_buffer(name, (buf == NULL) ? "" : buf, len, 1, 0);
+    pl0lex_status ret = pass_tokens(h);
+    running = NULL;
+    return ret;
+}
+
+// Lex the file named fname with s, calling h's functions
+static pl0lex_status scan_file(pl0lex_scanner *s, const char *fname,
+			       const pl0lex_handler *h)
+{
+    if (!lexer_open((char *) fname, &s->status)) {
+	return pl0lex_io_error;
+    }
+    pl0lex_status ret = pass_tokens(h);
+    if (ret == pl0lex_ok && !lexer_input_status(&s->status)) {
+	ret = pl0lex_io_error;
+    }
+    return ret;
+}
+
+// Lex the file named fname, calling h's functions
+pl0lex_status pl0lex_scan_file(pl0lex_scanner *s, const char *fname,
+			       const pl0lex_handler *h)
+{
+    if (s == NULL || fname == NULL) {
+	return pl0lex_bad_argument;
+    }
+    start_scan(s, h);
+    pl0lex_status ret = scan_file(s, fname, h);
+    running = NULL;
+    return ret;
+}
+
+// Lex the n files named in fnames in turn, calling h's functions
+pl0lex_status pl0lex_scan_files(pl0lex_scanner *s,
+				const char *const fnames[], size_t n,
+				const pl0lex_handler *h)
+{
+    if (s == NULL || (fnames == NULL && n > 0)) {
+	return pl0lex_bad_argument;
+    }
+    start_scan(s, h);
+    pl0lex_status ret = pl0lex_ok;
+    error_status failure;
+    clear_error(&failure);
+    for (size_t i = 0; i < n; i++) {
+	pl0lex_status st = (fnames[i] == NULL) ? pl0lex_bad_argument
+	    : scan_file(s, fnames[i], h);
+	if (st == pl0lex_io_error) {
+	    ret = pl0lex_io_error;
+	    failure = s->status;
+	}
+	if (h != NULL && h->file_done != NULL) {
+	    h->file_done(h->arg, i, st);
+	}
+    }
+    s->status = failure;
+    running = NULL;
+    return ret;
+}
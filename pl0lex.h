@@ -0,0 +1,106 @@
+#ifndef _PL0LEX_H
+#define _PL0LEX_H
+#include <stddef.h>
+
+// The embedding API of the PL/0 lexer, exported by liblexer.a and
+// liblexer.so. Programs that lex many files can call it in-process
+// instead of starting the lexer for each file. Only the names declared
+// here are exported from liblexer.so, with the symbol version PL0LEX_1;
+// later minor versions only add to this API.
+//
+// The lexer itself keeps global state, so the API is not thread-safe:
+// a program may create several scanners (each with its own settings),
+// but only one scan can be running at a time. Errors are not printed;
+// they are passed to the handler's error function.
+
+#define PL0LEX_VERSION_MAJOR 1
+#define PL0LEX_VERSION_MINOR 0
+
+#if defined(__GNUC__)
+#define PL0LEX_API __attribute__((visibility("default")))
+#else
+#define PL0LEX_API
+#endif
+
+// A scanner: the settings for lexing, and the last failure
+typedef struct pl0lex_scanner pl0lex_scanner;
+
+// A token, as found in the input
+typedef struct {
+    int code;            // token code (see pl0lex_token_name)
+    unsigned int line;   // line number of the token
+    size_t offset;       // byte offset of the token's text in the input
+    size_t length;       // length of the token's text in bytes
+} pl0lex_token;
+
+// The results of a scan
+typedef enum {
+    pl0lex_ok = 0,       // the input was lexed (it may have lexical errors)
+    pl0lex_stopped,      // the handler's token function stopped the scan
+    pl0lex_io_error,     // the input could not be read
+    pl0lex_bad_argument  // a required argument was NULL
+} pl0lex_status;
+
+// The functions called during a scan (any can be NULL), each passed arg
+typedef struct {
+    void *arg;
+    // Called for each token, whose text (null-terminated, valid only
+    // during the call) is its first PL0LEX_LEXEME_PREFIX chars if its
+    // length is over the lexeme limit; return nonzero to stop the scan
+    int (*token)(void *arg, const pl0lex_token *tok, const char *text);
+    // Called for each lexical error, with its line and message
+    void (*error)(void *arg, unsigned int line, const char *msg);
+    // Called (by pl0lex_scan_files) after each file, with its number
+    // in the batch and how its scan ended
+    void (*file_done)(void *arg, size_t index, pl0lex_status status);
+} pl0lex_handler;
+
+// The length of the text given for a token longer than the lexeme limit
+#define PL0LEX_LEXEME_PREFIX 64
+
+// Return the version of the library that is linked in,
+// as PL0LEX_VERSION_MAJOR * 1000 + PL0LEX_VERSION_MINOR
+PL0LEX_API int pl0lex_version(void);
+
+// Return a new scanner with the default settings (NULL if out of memory)
+PL0LEX_API pl0lex_scanner *pl0lex_create(void);
+
+// Free the scanner s (which may be NULL)
+PL0LEX_API void pl0lex_destroy(pl0lex_scanner *s);
+
+// Requires: s != NULL
+// Set the length above which s does not keep identifiers and numbers
+// in full (and reports them as errors); it is forced into the range
+// the lexer supports
+PL0LEX_API void pl0lex_set_lexeme_limit(pl0lex_scanner *s, size_t limit);
+
+// Requires: s != NULL
+// Return the message for the last failure of a scan by s
+// (the empty string if there has been none)
+PL0LEX_API const char *pl0lex_last_error(const pl0lex_scanner *s);
+
+// Return the symbolic name of the token code (e.g., "identsym")
+PL0LEX_API const char *pl0lex_token_name(int code);
+
+// Lex the len bytes at buf, whose name (for messages) is name,
+// calling h's functions (h may be NULL to only check the input)
+PL0LEX_API pl0lex_status pl0lex_scan_buffer(pl0lex_scanner *s,
+					    const char *name,
+					    const char *buf, size_t len,
+					    const pl0lex_handler *h);
+
+// Lex the file named fname, calling h's functions
+PL0LEX_API pl0lex_status pl0lex_scan_file(pl0lex_scanner *s,
+					  const char *fname,
+					  const pl0lex_handler *h);
+
+// Lex the n files named in fnames in turn, calling h's functions;
+// a file that cannot be read is skipped (its file_done call says so,
+// and pl0lex_last_error gives the message for the last such file)
+// and a stopped scan stops only its file; return pl0lex_io_error
+// if some file could not be read, otherwise pl0lex_ok
+PL0LEX_API pl0lex_status pl0lex_scan_files(pl0lex_scanner *s,
+					   const char *const fnames[],
+					   size_t n, const pl0lex_handler *h);
+
+#endif
@@ -0,0 +1,508 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "utilities.h"
+#include "lexer.h"
+#include "pl0.tab.h"
+#include "pl0tok.h"
+
+// the magic bytes at the start and near the end of a .pl0tok file
+static const char magic[6] = { 'P', 'L', '0', 'T', 'O', 'K' };
+
+// token codes are written relative to this, so each takes one byte
+#define CODE_BASE YYerror
+
+// the initial sizes of the writer's tables
+#define INITIAL_CHARS 4096
+#define INITIAL_STRINGS 256
+#define INITIAL_FILES 4
+
+// Requires: size > 0
+// Return a pointer to fresh storage for size bytes, bailing if none
+static void *alloc(void *p, size_t size)
+{
+    void *ret = realloc(p, size);
+    if (ret == NULL) {
+	bail_with_error("Cannot allocate %zu bytes for a .pl0tok file!", size);
+    }
+    return ret;
+}
+
+// Write the buffered output of w
+static void flush_output(pl0tok_writer *w)
+{
+    if (fwrite(w->buf, 1, w->used, w->out) != w->used) {
+	bail_with_error("Cannot write a .pl0tok file!");
+    }
+    w->used = 0;
+}
+
+// Add the len bytes at p to the output of w
+static void put_bytes(pl0tok_writer *w, const void *p, size_t len)
+{
+    if (len > PL0TOK_BUFSIZE - w->used) {
+	flush_output(w);
+    }
+    if (len > PL0TOK_BUFSIZE) {
+	if (fwrite(p, 1, len, w->out) != len) {
+	    bail_with_error("Cannot write a .pl0tok file!");
+	}
+    } else {
+	memcpy(w->buf + w->used, p, len);
+	w->used += len;
+    }
+    w->pos += len;
+}
+
+// Add v to the output of w as an unsigned varint
+static void put_varint(pl0tok_writer *w, uint64_t v)
+{
+    unsigned char bytes[10];
+    size_t n = 0;
+    while (v >= 0x80) {
+	bytes[n++] = (unsigned char) (v | 0x80);
+	v >>= 7;
+    }
+    bytes[n++] = (unsigned char) v;
+    put_bytes(w, bytes, n);
+}
+
+// Put v at p as a little-endian number of len bytes
+static void store_le(unsigned char *p, uint64_t v, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+	p[i] = (unsigned char) (v >> (8 * i));
+    }
+}
+
+// Add v to the output of w as 8 little-endian bytes
+static void put_u64(pl0tok_writer *w, uint64_t v)
+{
+    unsigned char bytes[8];
+    store_le(bytes, v, 8);
+    put_bytes(w, bytes, 8);
+}
+
+// Return the 64-bit FNV-1a hash of the len chars at s
+static uint64_t hash_text(const char *s, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+	h = (h ^ (unsigned char) s[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Return the slot of w's hash table for the text s of length len:
+// either the slot holding its string, or the empty slot for it
+static size_t find_slot(const pl0tok_writer *w, const char *s, size_t len)
+{
+    size_t mask = w->slot_count - 1;
+    size_t i = (size_t) hash_text(s, len) & mask;
+    while (w->slots[i] != 0) {
+	const char *t = w->chars + w->offsets[w->slots[i] - 1];
+	if (strncmp(t, s, len) == 0 && t[len] == '\0') {
+	    break;
+	}
+	i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Double the size of w's hash table
+static void grow_slots(pl0tok_writer *w)
+{
+    size_t count = w->slot_count * 2;
+    free(w->slots);
+    w->slots = (size_t *) calloc(count, sizeof(size_t));
+    if (w->slots == NULL) {
+	bail_with_error("Cannot allocate space for a .pl0tok file's strings!");
+    }
+    w->slot_count = count;
+    for (size_t s = 0; s < w->string_count; s++) {
+	const char *t = w->chars + w->offsets[s];
+	w->slots[find_slot(w, t, strlen(t))] = s + 1;
+    }
+}
+
+// Return the number of the string s (of length len) in w,
+// adding it to w's strings if it is not there yet
+static uint64_t intern(pl0tok_writer *w, const char *s, size_t len)
+{
+    size_t i = find_slot(w, s, len);
+    if (w->slots[i] != 0) {
+	return w->slots[i] - 1;
+    }
+    if (w->chars_used + len + 1 > w->chars_capacity) {
+	while (w->chars_used + len + 1 > w->chars_capacity) {
+	    w->chars_capacity *= 2;
+	}
+	w->chars = (char *) alloc(w->chars, w->chars_capacity);
+    }
+    if (w->string_count == w->string_capacity) {
+	w->string_capacity *= 2;
+	w->offsets = (uint64_t *)
+	    alloc(w->offsets, w->string_capacity * sizeof(uint64_t));
+    }
+    memcpy(w->chars + w->chars_used, s, len);
+    w->chars[w->chars_used + len] = '\0';
+    w->offsets[w->string_count] = w->chars_used;
+    w->chars_used += len + 1;
+    w->slots[i] = ++w->string_count;
+    // keep the table at most half full
+    if (2 * w->string_count > w->slot_count) {
+	grow_slots(w);
+    }
+    return w->string_count - 1;
+}
+
+// Initialize w to write a .pl0tok file to out, writing its header
+void pl0tok_writer_init(pl0tok_writer *w, FILE *out)
+{
+    memset(w, 0, sizeof(pl0tok_writer));
+    w->out = out;
+    w->buf = (unsigned char *) alloc(NULL, PL0TOK_BUFSIZE);
+    w->chars_capacity = INITIAL_CHARS;
+    w->chars = (char *) alloc(NULL, w->chars_capacity);
+    w->string_capacity = INITIAL_STRINGS;
+    w->offsets = (uint64_t *) alloc(NULL, INITIAL_STRINGS * sizeof(uint64_t));
+    w->slot_count = 2 * INITIAL_STRINGS;
+    w->slots = (size_t *) calloc(w->slot_count, sizeof(size_t));
+    if (w->slots == NULL) {
+	bail_with_error("Cannot allocate space for a .pl0tok file's strings!");
+    }
+    w->file_capacity = INITIAL_FILES;
+    w->files = (uint64_t *) alloc(NULL, INITIAL_FILES * sizeof(uint64_t));
+
+    unsigned char header[PL0TOK_HEADER_SIZE] = { 0 };
+    memcpy(header, magic, sizeof(magic));
+    store_le(header + 6, PL0TOK_VERSION, 2);
+    store_le(header + 8, CODE_BASE, 4);
+    put_bytes(w, header, PL0TOK_HEADER_SIZE);
+}
+
+// Note that the following tokens come from the file named fname
+void pl0tok_write_file(pl0tok_writer *w, const char *fname)
+{
+    if (w->file_count == w->file_capacity) {
+	w->file_capacity *= 2;
+	w->files = (uint64_t *)
+	    alloc(w->files, w->file_capacity * sizeof(uint64_t));
+    }
+    w->files[w->file_count] = intern(w, fname, strlen(fname));
+    put_varint(w, 0);
+    put_varint(w, w->file_count++);
+    w->line = 0;
+}
+
+// Write a token with the given code, line and text
+void pl0tok_write_token(pl0tok_writer *w, int code, unsigned int line,
+			const char *text, size_t len)
+{
+    unsigned char rec[3];
+    uint64_t s = intern(w, text, len);
+    uint64_t c = (uint64_t) (code - CODE_BASE) + 1;
+    uint64_t d = line - w->line;
+    w->line = line;
+    w->token_count++;
+    if (c < 0x80 && d < 0x80 && s < 0x80) {
+	// the usual case: three one-byte varints
+	rec[0] = (unsigned char) c;
+	rec[1] = (unsigned char) d;
+	rec[2] = (unsigned char) s;
+	put_bytes(w, rec, 3);
+	return;
+    }
+    put_varint(w, c);
+    put_varint(w, d);
+    put_varint(w, s);
+}
+
+// Write a file record and all the remaining tokens from the lexer
+void pl0tok_write_lexer_tokens(pl0tok_writer *w)
+{
+    pl0tok_write_file(w, lexer_filename());
+    lexer_token tok;
+    while (lexer_next_token(&tok)) {
+	const char *text = lexer_token_text();
+	pl0tok_write_token(w, tok.code, tok.line, text, strlen(text));
+    }
+}
+
+// Write the tables and trailer, flush the output (without closing it)
+// and free the storage used by w
+void pl0tok_writer_finish(pl0tok_writer *w)
+{
+    uint64_t strings_pos = w->pos;
+    put_bytes(w, w->chars, w->chars_used);
+    uint64_t index_pos = w->pos;
+    for (size_t s = 0; s < w->string_count; s++) {
+	put_u64(w, w->offsets[s]);
+    }
+    uint64_t files_pos = w->pos;
+    for (size_t f = 0; f < w->file_count; f++) {
+	put_u64(w, w->files[f]);
+    }
+    put_u64(w, w->token_count);
+    put_u64(w, strings_pos);
+    put_u64(w, w->string_count);
+    put_u64(w, index_pos);
+    put_u64(w, w->file_count);
+    put_u64(w, files_pos);
+    unsigned char end[8];
+    memcpy(end, magic, sizeof(magic));
+    store_le(end + 6, PL0TOK_VERSION, 2);
+    put_bytes(w, end, 8);
+    flush_output(w);
+    if (fflush(w->out) == EOF) {
+	bail_with_error("Cannot write a .pl0tok file!");
+    }
+    free(w->buf);
+    free(w->chars);
+    free(w->offsets);
+    free(w->slots);
+    free(w->files);
+    w->buf = NULL;
+    w->chars = NULL;
+    w->offsets = NULL;
+    w->slots = NULL;
+    w->files = NULL;
+}
+
+// Return the little-endian number of len bytes at p
+static uint64_t load_le(const unsigned char *p, size_t len)
+{
+    uint64_t v = 0;
+    for (size_t i = 0; i < len; i++) {
+	v |= (uint64_t) p[i] << (8 * i);
+    }
+    return v;
+}
+
+// Return the 8-byte little-endian number at p
+// (with a single load on a little-endian host)
+static uint64_t load_u64(const unsigned char *p)
+{
+    static const union { uint16_t u; unsigned char c[2]; } one = { 1 };
+    if (one.c[0] != 1) {
+	return load_le(p, 8);
+    }
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+// Return true just when the table of count 8-byte entries at offset pos
+// lies within the size bytes before the trailer
+static bool table_fits(uint64_t pos, uint64_t count, uint64_t size)
+{
+    return pos <= size && count <= (size - pos) / 8;
+}
+
+// Check the header, trailer and tables of the mapped file in r,
+// setting up r's pointers, and return NULL if they are well formed,
+// otherwise an error message
+static const char *check_layout(pl0tok_reader *r)
+{
+    const unsigned char *b = r->base;
+    if (r->size < PL0TOK_HEADER_SIZE + PL0TOK_TRAILER_SIZE
+	|| memcmp(b, magic, sizeof(magic)) != 0) {
+	return "not a .pl0tok file";
+    }
+    if (load_le(b + 6, 2) != PL0TOK_VERSION) {
+	return "unsupported .pl0tok version";
+    }
+    const unsigned char *t = b + r->size - PL0TOK_TRAILER_SIZE;
+    if (memcmp(t + 48, magic, sizeof(magic)) != 0
+	|| load_le(t + 54, 2) != PL0TOK_VERSION) {
+	return "truncated .pl0tok file";
+    }
+    r->code_base = (int) load_le(b + 8, 4);
+    r->token_count = load_le(t, 8);
+    uint64_t strings_pos = load_le(t + 8, 8);
+    r->string_count = load_le(t + 16, 8);
+    uint64_t index_pos = load_le(t + 24, 8);
+    r->file_count = load_le(t + 32, 8);
+    uint64_t files_pos = load_le(t + 40, 8);
+    uint64_t size = r->size - PL0TOK_TRAILER_SIZE;
+    if (strings_pos < PL0TOK_HEADER_SIZE || strings_pos > index_pos
+	|| !table_fits(index_pos, r->string_count, size)
+	|| files_pos != index_pos + 8 * r->string_count
+	|| !table_fits(files_pos, r->file_count, size)
+	|| files_pos + 8 * r->file_count != size) {
+	return "corrupt .pl0tok tables";
+    }
+    r->tokens = b + PL0TOK_HEADER_SIZE;
+    r->tokens_end = b + strings_pos;
+    r->strings = (const char *) (b + strings_pos);
+    r->strings_size = index_pos - strings_pos;
+    r->index = b + index_pos;
+    r->files = b + files_pos;
+    // each string must start after the previous one and end in a null char
+    uint64_t prev = 0;
+    for (uint64_t s = 0; s < r->string_count; s++) {
+	uint64_t off = load_le(r->index + 8 * s, 8);
+	if ((s > 0 && off <= prev) || off >= r->strings_size) {
+	    return "corrupt .pl0tok string index";
+	}
+	prev = off;
+    }
+    if (r->string_count > 0 && (r->strings[r->strings_size - 1] != '\0'
+				|| load_le(r->index, 8) != 0)) {
+	return "corrupt .pl0tok strings";
+    }
+    for (uint64_t f = 0; f < r->file_count; f++) {
+	if (load_le(r->files + 8 * f, 8) >= r->string_count) {
+	    return "corrupt .pl0tok file table";
+	}
+    }
+    return NULL;
+}
+
+// Map the .pl0tok file named path into memory for reading with r,
+// checking its header, trailer and tables, and return NULL;
+// or return an error message if it cannot be read
+const char *pl0tok_open(pl0tok_reader *r, const char *path)
+{
+    memset(r, 0, sizeof(pl0tok_reader));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+	return "cannot open the .pl0tok file";
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+	close(fd);
+	return "cannot read the .pl0tok file";
+    }
+    void *base = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE,
+		      fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+	return "cannot map the .pl0tok file";
+    }
+    r->base = (const unsigned char *) base;
+    r->size = (size_t) st.st_size;
+    r->mapped = true;
+    const char *msg = check_layout(r);
+    if (msg != NULL) {
+	pl0tok_close(r);
+    }
+    return msg;
+}
+
+// Start reading the .pl0tok data at base with r, checking it as
+// pl0tok_open does, and return NULL or an error message
+const char *pl0tok_open_bytes(pl0tok_reader *r, const void *base, size_t size)
+{
+    memset(r, 0, sizeof(pl0tok_reader));
+    r->base = (const unsigned char *) base;
+    r->size = size;
+    return check_layout(r);
+}
+
+// Unmap r's file (if pl0tok_open mapped it)
+void pl0tok_close(pl0tok_reader *r)
+{
+    if (r->base != NULL && r->mapped) {
+	munmap((void *) r->base, r->size);
+    }
+    r->base = NULL;
+}
+
+// Return string number s of r, setting *len to its length if len != NULL
+const char *pl0tok_string(const pl0tok_reader *r, uint64_t s, size_t *len)
+{
+    uint64_t off = load_u64(r->index + 8 * s);
+    if (len != NULL) {
+	uint64_t next = (s + 1 < r->string_count)
+	    ? load_u64(r->index + 8 * (s + 1)) : r->strings_size;
+	*len = (size_t) (next - off - 1);
+    }
+    return r->strings + off;
+}
+
+// Return the name of file number f of r
+const char *pl0tok_file_name(const pl0tok_reader *r, unsigned int f)
+{
+    return pl0tok_string(r, load_le(r->files + 8 * (uint64_t) f, 8), NULL);
+}
+
+// Start it at the first token of r
+void pl0tok_iter_init(const pl0tok_reader *r, pl0tok_iter *it)
+{
+    it->p = r->tokens;
+    it->file = 0;
+    it->line = 0;
+    it->in_file = false;
+    it->error = NULL;
+}
+
+// Read an unsigned varint at it->p (before end) into *v, advancing it->p;
+// return false if it is malformed
+static bool get_varint(pl0tok_iter *it, const unsigned char *end,
+		       uint64_t *v)
+{
+    uint64_t ret = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+	if (it->p == end) {
+	    return false;
+	}
+	unsigned char b = *it->p++;
+	ret |= (uint64_t) (b & 0x7f) << shift;
+	if (b < 0x80) {
+	    *v = ret;
+	    return true;
+	}
+    }
+    return false;
+}
+
+// Read the next token of r into *tok and return true,
+// or return false at the end of the tokens
+bool pl0tok_next(const pl0tok_reader *r, pl0tok_iter *it, pl0tok_token *tok)
+{
+    const unsigned char *end = r->tokens_end;
+    uint64_t c, d, s;
+    for (;;) {
+	if (it->p == end) {
+	    return false;
+	}
+	// the usual case: a token whose varints are all one byte
+	if (it->in_file && end - it->p >= 3 && it->p[0] - 1u < 0x7f
+	    && (it->p[1] | it->p[2]) < 0x80) {
+	    c = it->p[0];
+	    d = it->p[1];
+	    s = it->p[2];
+	    it->p += 3;
+	} else if (!get_varint(it, end, &c) || !get_varint(it, end, &d)) {
+	    it->error = "malformed .pl0tok token record";
+	    return false;
+	} else if (c == 0) {
+	    if (d >= r->file_count) {
+		it->error = "bad file number in .pl0tok file";
+		return false;
+	    }
+	    it->file = (unsigned int) d;
+	    it->line = 0;
+	    it->in_file = true;
+	    continue;
+	} else if (!it->in_file || !get_varint(it, end, &s)) {
+	    it->error = "malformed .pl0tok token record";
+	    return false;
+	}
+	if (s >= r->string_count) {
+	    it->error = "bad string number in .pl0tok file";
+	    return false;
+	}
+	it->line += (unsigned int) d;
+	tok->code = r->code_base + (int) c - 1;
+	tok->line = it->line;
+	tok->file = it->file;
+	tok->text = pl0tok_string(r, s, &tok->length);
+	return true;
+    }
+}
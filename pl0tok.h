@@ -0,0 +1,158 @@
+#ifndef _PL0TOK_H
+#define _PL0TOK_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// A .pl0tok file is a compact binary form of the lexer's tokens:
+//   header:  "PL0TOK", the version (2 bytes), the code base (4 bytes)
+//            and 4 zero bytes
+//   tokens:  records, each a sequence of unsigned varints (LEB128):
+//              0 f     the following tokens are from file number f
+//              c d s   a token whose code is the code base + c - 1,
+//                      whose line is d more than that of the previous
+//                      token from the same file (lines start at 0),
+//                      and whose text is string number s
+//   strings: the text of each string, with a null char after each
+//   index:   the offset of each string from the start of the strings
+//   files:   the string number of each file's name
+//   trailer: the token count, the offset of the strings, the string
+//            count, the offset of the index, the file count and
+//            the offset of the files, then "PL0TOK" and the version.
+// Each string is stored once, so a token's text is a small number.
+// Fixed size numbers are little-endian; those in the index, files
+// and trailer are 8 bytes long. Offsets are from the start of the file.
+// The tables come after the tokens, so the writer never seeks.
+
+// The version of the format written
+#define PL0TOK_VERSION 1
+
+// The size of the header and the trailer in bytes
+#define PL0TOK_HEADER_SIZE 16
+#define PL0TOK_TRAILER_SIZE (6 * 8 + 8)
+
+// The size of a writer's output buffer
+#define PL0TOK_BUFSIZE (1 << 16)
+
+// A writer of a .pl0tok file, which streams out the tokens
+// and keeps only the (distinct) strings until it finishes
+typedef struct {
+    FILE *out;
+    unsigned char *buf;     // output waiting to be written
+    size_t used;
+    uint64_t pos;           // number of bytes written (including buf)
+    char *chars;            // the strings, each followed by a null char
+    size_t chars_used;
+    size_t chars_capacity;
+    uint64_t *offsets;      // offset of each string in chars
+    size_t string_count;
+    size_t string_capacity;
+    size_t *slots;          // hash table of string numbers + 1 (0: empty)
+    size_t slot_count;      // a power of 2
+    uint64_t *files;        // the string number of each file's name
+    size_t file_count;
+    size_t file_capacity;
+    unsigned int line;      // line of the last token written
+    uint64_t token_count;
+} pl0tok_writer;
+
+// Requires: w != NULL and out is open for writing (in binary)
+// Initialize w to write a .pl0tok file to out, writing its header
+extern void pl0tok_writer_init(pl0tok_writer *w, FILE *out);
+
+// Requires: w != NULL and fname != NULL
+// Note that the following tokens come from the file named fname
+extern void pl0tok_write_file(pl0tok_writer *w, const char *fname);
+
+// Requires: w != NULL and text != NULL has len chars (and no null chars)
+//           and pl0tok_write_file has been called;
+//           line is not less than that of the last token from this file
+// Write a token with the given code, line and text
+extern void pl0tok_write_token(pl0tok_writer *w, int code,
+			       unsigned int line,
+			       const char *text, size_t len);
+
+// Requires: w != NULL and the lexer has been initialized
+// Write a file record and all the remaining tokens from the lexer
+extern void pl0tok_write_lexer_tokens(pl0tok_writer *w);
+
+// Requires: w != NULL
+// Write the tables and trailer, flush the output (without closing it)
+// and free the storage used by w
+extern void pl0tok_writer_finish(pl0tok_writer *w);
+
+// A .pl0tok file mapped into memory for reading;
+// the reader never copies strings out of the mapping
+typedef struct {
+    const unsigned char *base;  // the mapped file
+    size_t size;
+    bool mapped;                // was base mapped by pl0tok_open?
+    int code_base;
+    uint64_t token_count;
+    const unsigned char *tokens;      // the token records
+    const unsigned char *tokens_end;
+    const char *strings;              // the texts of the strings
+    size_t strings_size;
+    const unsigned char *index;       // the offsets of the strings
+    uint64_t string_count;
+    const unsigned char *files;       // the string numbers of file names
+    uint64_t file_count;
+} pl0tok_reader;
+
+// A token read from a .pl0tok file
+typedef struct {
+    int code;
+    unsigned int line;
+    unsigned int file;   // number of the token's file
+    const char *text;    // points into the mapped file
+    size_t length;       // of text
+} pl0tok_token;
+
+// A position in the tokens of a pl0tok_reader
+typedef struct {
+    const unsigned char *p;
+    unsigned int file;
+    unsigned int line;
+    bool in_file;         // has a file record been seen?
+    const char *error;    // why reading stopped early (or NULL)
+} pl0tok_iter;
+
+// Requires: r != NULL and path != NULL
+// Map the .pl0tok file named path into memory for reading with r,
+// checking its header, trailer and tables, and return NULL;
+// or return an error message if it cannot be read
+extern const char *pl0tok_open(pl0tok_reader *r, const char *path);
+
+// Requires: r != NULL and base points to size bytes of memory
+//           that stay valid while r is used
+// Start reading the .pl0tok data at base with r, checking it as
+// pl0tok_open does, and return NULL or an error message
+extern const char *pl0tok_open_bytes(pl0tok_reader *r, const void *base,
+				     size_t size);
+
+// Requires: r was opened by pl0tok_open or pl0tok_open_bytes
+// Unmap r's file (if pl0tok_open mapped it)
+extern void pl0tok_close(pl0tok_reader *r);
+
+// Requires: r != NULL and s < r->string_count
+// Return string number s of r, setting *len to its length if len != NULL
+extern const char *pl0tok_string(const pl0tok_reader *r, uint64_t s,
+				 size_t *len);
+
+// Requires: r != NULL and f < r->file_count
+// Return the name of file number f of r
+extern const char *pl0tok_file_name(const pl0tok_reader *r, unsigned int f);
+
+// Requires: r != NULL and it != NULL
+// Start it at the first token of r
+extern void pl0tok_iter_init(const pl0tok_reader *r, pl0tok_iter *it);
+
+// Requires: it was started on r and tok != NULL
+// Read the next token of r into *tok and return true,
+// or return false at the end of the tokens
+// (with it->error set if the token records are malformed)
+extern bool pl0tok_next(const pl0tok_reader *r, pl0tok_iter *it,
+			pl0tok_token *tok);
+
+#endif
@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <string.h>
+#include "utilities.h"
+#include "relex.h"
+
+// the initial capacity of a relex_tokens
+#define INITIAL_CAPACITY 256
+
+// Initialize rt to hold no tokens
+void relex_init(relex_tokens *rt, const char *filename)
+{
+    rt->tokens = NULL;
+    rt->gap_start = 0;
+    rt->gap_end = 0;
+    rt->capacity = 0;
+    rt->offset_delta = 0;
+    rt->line_delta = 0;
+    rt->filename = filename;
+}
+
+// Free the storage used by rt
+void relex_free(relex_tokens *rt)
+{
+    free(rt->tokens);
+    relex_init(rt, rt->filename);
+}
+
+// Return the number of tokens in rt
+size_t relex_count(const relex_tokens *rt)
+{
+    return rt->gap_start + (rt->capacity - rt->gap_end);
+}
+
+// Return the ith token in rt
+lexer_token relex_token(const relex_tokens *rt, size_t i)
+{
+    if (i < rt->gap_start) {
+	return rt->tokens[i];
+    }
+    lexer_token ret = rt->tokens[rt->gap_end + (i - rt->gap_start)];
+    ret.offset += rt->offset_delta;
+    ret.line += rt->line_delta;
+    return ret;
+}
+
+// Return the (actual) offset of the first token after the gap
+static size_t offset_after_gap(const relex_tokens *rt)
+{
+    return rt->tokens[rt->gap_end].offset + rt->offset_delta;
+}
+
+// Move the gap so that the tokens before it are
+// exactly those that start before offset
+static void move_gap(relex_tokens *rt, size_t offset)
+{
+    while (rt->gap_start > 0
+	   && rt->tokens[rt->gap_start-1].offset >= offset) {
+	lexer_token t = rt->tokens[--rt->gap_start];
+	t.offset -= rt->offset_delta;
+	t.line -= rt->line_delta;
+	rt->tokens[--rt->gap_end] = t;
+    }
+    while (rt->gap_end < rt->capacity && offset_after_gap(rt) < offset) {
+	lexer_token t = rt->tokens[rt->gap_end++];
+	t.offset += rt->offset_delta;
+	t.line += rt->line_delta;
+	rt->tokens[rt->gap_start++] = t;
+    }
+}
+
+// Add tok at the start of the gap, growing rt if needed
+static void insert_token(relex_tokens *rt, lexer_token tok)
+{
+    if (rt->gap_start == rt->gap_end) {
+	size_t cap = rt->capacity == 0 ? INITIAL_CAPACITY : 2 * rt->capacity;
+	lexer_token *toks = (lexer_token *)
+	    realloc(rt->tokens, cap * sizeof(lexer_token));
+	if (toks == NULL) {
+	    bail_with_error("Cannot allocate space for %zu tokens!", cap);
+	}
+	// move the tokens after the gap to the end of the new space
+	size_t after = rt->capacity - rt->gap_end;
+	memmove(toks + cap - after, toks + rt->gap_end,
+		after * sizeof(lexer_token));
+	rt->tokens = toks;
+	rt->gap_end = cap - after;
+	rt->capacity = cap;
+    }
+    rt->tokens[rt->gap_start++] = tok;
+}
+
+// Return the number of newlines in buf[0..len)
+static unsigned int count_newlines(const char *buf, size_t len)
+{
+    unsigned int ret = 0;
+    const char *end = buf + len;
+    const char *p;
+    while ((p = memchr(buf, '\n', end - buf)) != NULL) {
+	ret++;
+	buf = p + 1;
+    }
+    return ret;
+}
+
+// Requires: the gap is at the first token at or after start
+// Return the line number of the byte at offset start in buf,
+// counting lines from the last token before the gap
+static unsigned int line_at(const relex_tokens *rt, const char *buf,
+			    size_t start)
+{
+    if (rt->gap_start == 0) {
+	return 1 + count_newlines(buf, start);
+    }
+    const lexer_token *t = &rt->tokens[rt->gap_start-1];
+    return t->line + count_newlines(buf + t->offset, start - t->offset);
+}
+
+// Lex buf[start..end), which starts on the given line,
+// adding its tokens at the start of the gap
+static void lex_lines(relex_tokens *rt, const char *buf,
+		      size_t start, size_t end, unsigned int line)
+{
+    bool values = lexer_token_values();
+    lexer_set_token_values(false);
+    lexer_init_buffer(rt->filename, buf + start, end - start, line, start);
+    lexer_token tok;
+    while (lexer_next_token(&tok)) {
+	insert_token(rt, tok);
+    }
+    lexer_set_token_values(values);
+}
+
+// Replace the tokens in rt by the tokens of the len chars at buf
+void relex_all(relex_tokens *rt, const char *buf, size_t len)
+{
+    rt->gap_start = 0;
+    rt->gap_end = rt->capacity;
+    rt->offset_delta = 0;
+    rt->line_delta = 0;
+    lex_lines(rt, buf, 0, len, 1);
+}
+
+// Update rt to hold the tokens of buf, relexing only the lines
+// touched by the edit that replaced the removed chars starting at offset
+// by the inserted chars
+void relex_edit(relex_tokens *rt, const char *buf, size_t len,
+		size_t offset, size_t removed, size_t inserted)
+{
+    // Since no token spans lines, relexing can start at the beginning
+    // of the line containing the edit and stop at the end of the line
+    // containing its last inserted char.
+    size_t start = offset;
+    while (start > 0 && buf[start-1] != '\n') {
+	start--;
+    }
+    size_t end = offset + inserted;
+    const char *nl = memchr(buf + end, '\n', len - end);
+    end = (nl == NULL) ? len : (size_t) (nl - buf) + 1;
+    // the end of the relexed lines, before the edit
+    size_t old_end = end - inserted + removed;
+
+    move_gap(rt, start);
+    // drop the old tokens of the relexed lines
+    while (rt->gap_end < rt->capacity && offset_after_gap(rt) < old_end) {
+	rt->gap_end++;
+    }
+    rt->offset_delta += inserted - removed;
+
+    lex_lines(rt, buf, start, end, line_at(rt, buf, start));
+
+    // renumber the lines after the edit by fixing up the first of them
+    if (rt->gap_end < rt->capacity) {
+	lexer_token *next = &rt->tokens[rt->gap_end];
+	size_t next_offset = next->offset + rt->offset_delta;
+	unsigned int next_line = line_at(rt, buf, next_offset);
+	rt->line_delta = next_line - next->line;
+    }
+}
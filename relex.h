@@ -0,0 +1,53 @@
+#ifndef _RELEX_H
+#define _RELEX_H
+#include <stddef.h>
+#include "lexer.h"
+
+// The tokens of a buffer that is being edited, kept up to date by
+// relexing only the lines that each edit touches.
+// The tokens are kept in a gap buffer: tokens[0..gap_start) are
+// before the gap and tokens[gap_end..capacity) are after it.
+// The offset and line of a token after the gap are stored
+// minus offset_delta and line_delta (modulo the size of the type),
+// so an edit shifts all later tokens just by changing the deltas.
+typedef struct {
+    lexer_token *tokens;
+    size_t gap_start;
+    size_t gap_end;
+    size_t capacity;
+    size_t offset_delta;      // added to offsets of tokens after the gap
+    unsigned int line_delta;  // added to lines of tokens after the gap
+    const char *filename;     // name used in error messages
+} relex_tokens;
+
+// Requires: rt != NULL and filename != NULL
+// Initialize rt to hold no tokens
+extern void relex_init(relex_tokens *rt, const char *filename);
+
+// Requires: rt != NULL
+// Free the storage used by rt
+extern void relex_free(relex_tokens *rt);
+
+// Requires: rt != NULL
+// Return the number of tokens in rt
+extern size_t relex_count(const relex_tokens *rt);
+
+// Requires: rt != NULL and i < relex_count(rt)
+// Return the ith token in rt
+extern lexer_token relex_token(const relex_tokens *rt, size_t i);
+
+// Requires: rt != NULL and buf != NULL
+// Replace the tokens in rt by the tokens of the len chars at buf
+extern void relex_all(relex_tokens *rt, const char *buf, size_t len);
+
+// Requires: rt holds the tokens of a buffer before an edit
+//           that replaced the removed chars starting at offset
+//           by inserted chars; buf holds the len chars after the edit
+// Update rt to hold the tokens of buf, relexing only the lines
+// touched by the edit; the offsets and lines of later tokens are
+// shifted without looking at them, so the cost does not depend on
+// the size of the buffer (only on the distance from the last edit)
+extern void relex_edit(relex_tokens *rt, const char *buf, size_t len,
+		       size_t offset, size_t removed, size_t inserted);
+
+#endif
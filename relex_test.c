@@ -0,0 +1,173 @@
+// A test of relexing edited buffers: it lexes each given file with
+// relex_all, then makes a series of pseudo-random edits to its text
+// (inserting and removing tokens, spaces, newlines, comments and
+// characters that are errors), updating the tokens with relex_edit
+// after each edit, and checks that they are the same tokens (codes,
+// lines, offsets and lengths) as a full re-lex (relex_all) of the
+// edited text gives. Only the differences are printed.
+//
+// Usage: relex_test [-n edits] file.pl0 ...
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "diagnostics.h"
+#include "input_file.h"
+#include "lexer.h"
+#include "relex.h"
+#include "utilities.h"
+
+#define RELEX_TEST_DEFAULT_EDITS 500
+
+// the most chars removed by an edit
+#define RELEX_TEST_MAX_REMOVED 12
+
+// The texts that edits insert
+static const char *snippets[] = {
+    " ", "\n", "\r\n", "x", "y1", "42", "0", ":=", ";", ",", "+", "<=",
+    "<>", " begin ", "end", "if ", " then ", "\n  write x;\n",
+    "# a comment\n", "#", "9999999999", "@", "\xc3\xa9", "\xc3", ""
+};
+#define SNIPPETS (sizeof(snippets) / sizeof(snippets[0]))
+
+// a small linear congruential generator, so the edits are the same
+// in every run
+static unsigned long seed = 7;
+
+// Return a pseudo-random number less than n
+static size_t pick(size_t n)
+{
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    return (size_t) ((seed >> 33) % n);
+}
+
+// A growable buffer being edited
+typedef struct {
+    char *chars;
+    size_t len;
+    size_t capacity;
+} buffer;
+
+// Replace the removed chars of b starting at offset by the len chars
+// at ins
+static void replace(buffer *b, size_t offset, size_t removed,
+		    const char *ins, size_t len)
+{
+    if (b->len - removed + len > b->capacity) {
+	b->capacity = 2 * (b->len - removed + len);
+	b->chars = (char *) realloc(b->chars, b->capacity);
+	if (b->chars == NULL) {
+	    bail_with_error("Cannot allocate the buffer for relex_test!");
+	}
+    }
+    memmove(b->chars + offset + len, b->chars + offset + removed,
+	    b->len - offset - removed);
+    memcpy(b->chars + offset, ins, len);
+    b->len = b->len - removed + len;
+}
+
+// Print the ith token of rt and of full (if they have one)
+static void print_tokens(const relex_tokens *rt, const relex_tokens *full,
+			 size_t i)
+{
+    const relex_tokens *sides[] = { rt, full };
+    const char *labels[] = { "relexed", "full" };
+    for (int s = 0; s < 2; s++) {
+	if (i < relex_count(sides[s])) {
+	    lexer_token t = relex_token(sides[s], i);
+	    printf("  %-8s code %d, line %u, offset %zu, length %zu\n",
+		   labels[s], t.code, t.line, t.offset, t.length);
+	} else {
+	    printf("  %-8s (no token)\n", labels[s]);
+	}
+    }
+}
+
+// Return whether rt has the same tokens as full; if not, print
+// the first difference, saying it was found after the given edit
+static bool same_tokens(const relex_tokens *rt, const relex_tokens *full,
+			const char *fname, int edit)
+{
+    size_t n = relex_count(rt);
+    size_t m = relex_count(full);
+    for (size_t i = 0; i < n || i < m; i++) {
+	lexer_token a = (i < n) ? relex_token(rt, i) : (lexer_token) { 0 };
+	lexer_token b = (i < m) ? relex_token(full, i) : (lexer_token) { 0 };
+	if (i >= n || i >= m || a.code != b.code || a.line != b.line
+	    || a.offset != b.offset || a.length != b.length) {
+	    printf("FAILED %s\nafter edit %d, token %zu differs:\n",
+		   fname, edit, i);
+	    print_tokens(rt, full, i);
+	    return false;
+	}
+    }
+    return true;
+}
+
+// Make the given number of edits to the text of the file named fname,
+// relexing after each; return whether every relex was right
+static bool test_file(const char *fname, int edits)
+{
+    input_file f;
+    error_status status;
+    if (!input_file_map(fname, &f, &status)) {
+	exit_with_error(&status);
+    }
+    buffer b = { NULL, 0, 0 };
+    replace(&b, 0, 0, f.text, f.len);
+    input_file_unmap(&f);
+
+    relex_tokens rt, full;
+    relex_init(&rt, fname);
+    relex_init(&full, fname);
+    relex_all(&rt, b.chars, b.len);
+    bool ok = true;
+    for (int e = 1; ok && e <= edits; e++) {
+	size_t offset = pick(b.len + 1);
+	size_t most = b.len - offset;
+	if (most > RELEX_TEST_MAX_REMOVED) {
+	    most = RELEX_TEST_MAX_REMOVED;
+	}
+	// a third of the edits only insert and a third only remove
+	size_t kind = pick(3);
+	size_t removed = (kind == 0) ? 0 : pick(most + 1);
+	const char *ins = (kind == 1) ? "" : snippets[pick(SNIPPETS)];
+	size_t inserted = strlen(ins);
+	replace(&b, offset, removed, ins, inserted);
+	relex_edit(&rt, b.chars, b.len, offset, removed, inserted);
+	relex_all(&full, b.chars, b.len);
+	ok = same_tokens(&rt, &full, fname, e);
+    }
+    relex_free(&rt);
+    relex_free(&full);
+    free(b.chars);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    int edits = RELEX_TEST_DEFAULT_EDITS;
+    int i = 1;
+    if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+	edits = atoi(argv[i+1]);
+	i += 2;
+    }
+    if (i >= argc || edits < 1) {
+	bail_with_error("Usage: %s [-n edits] file.pl0 ...", argv[0]);
+    }
+    // the edits make lexical errors, which are not the point here
+    diagnostics_set_format(diagnostics_none);
+    int failed = 0;
+    int files = argc - i;
+    for (; i < argc; i++) {
+	if (!test_file(argv[i], edits)) {
+	    failed++;
+	}
+    }
+    if (failed > 0) {
+	printf("%d of %d files were relexed wrongly!\n", failed, files);
+	return EXIT_FAILURE;
+    }
+    printf("Relexing agrees with full lexing! (%d edits of %d files)\n",
+	   edits, files);
+    return EXIT_SUCCESS;
+}
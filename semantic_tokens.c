@@ -0,0 +1,174 @@
+#include <stdbool.h>
+#include <string.h>
+#include "utilities.h"
+#include "input_file.h"
+#include "lexer.h"
+#include "pl0.tab.h"
+#include "token_info.h"
+#include "token_writer.h"
+#include "utf8.h"
+#include "semantic_tokens.h"
+
+// The type of each kind of token (-1 if it has no semantic token)
+static const int types[] = {
+    [token_other_category] = -1,
+    [token_keyword] = semantic_keyword,
+    [token_identifier] = semantic_variable,
+    [token_number] = semantic_number,
+    [token_operator] = semantic_operator
+};
+
+// Return the number of UTF-16 code units needed for the code points
+// whose UTF-8 encoding is s[0..len); a code point outside the basic
+// multilingual plane needs 2 units, and each byte that is not part
+// of a well-formed sequence needs 1 (as editors show it as U+FFFD)
+static unsigned int utf16_length(const char *s, size_t len)
+{
+    unsigned int ret = 0;
+    while (len > 0) {
+	size_t ascii = utf8_ascii_span(s, len);
+	ret += (unsigned int) ascii;
+	s += ascii;
+	len -= ascii;
+	if (len == 0) {
+	    break;
+	}
+	unsigned int cp;
+	size_t n = utf8_decode(s, len, &cp);
+	if (n == 0) {
+	    n = 1;  // an invalid byte
+	    cp = 0xFFFD;
+	}
+	ret += (cp >= 0x10000) ? 2 : 1;
+	s += n;
+	len -= n;
+    }
+    return ret;
+}
+
+// The state of the encoding of a file's tokens
+typedef struct {
+    const char *text;       // the whole file
+    size_t pos;             // offset up to which the column is known
+    unsigned int column;    // column at pos
+    unsigned int line;      // line (from 0) of the last token put
+    unsigned int start;     // column of the last token put
+    bool first;             // is no token put yet?
+    int declaring;          // keyword of the declaration being read (or 0)
+    bool name_next;         // is the next identifier a declared name?
+} encoder;
+
+// Requires: tok is after the last token given to e
+// Return the modifiers of the token tok, updating the state
+// of declarations in e
+static unsigned int modifiers(encoder *e, const lexer_token *tok)
+{
+    switch (tok->code) {
+    case constsym: case varsym: case proceduresym:
+	e->declaring = tok->code;
+	e->name_next = true;
+	return 0;
+    case commasym:
+	e->name_next = (e->declaring == constsym || e->declaring == varsym);
+	return 0;
+    case semisym:
+	e->declaring = 0;
+	e->name_next = false;
+	return 0;
+    case identsym:
+	if (e->name_next) {
+	    e->name_next = false;
+	    return SEMANTIC_DECLARATION
+		| ((e->declaring == constsym) ? SEMANTIC_READONLY : 0);
+	}
+	return 0;
+    default:
+	e->name_next = false;
+	return 0;
+    }
+}
+
+// Requires: tok is after the last token given to e
+// Add the 5 integers for the token tok to the output
+static void put_token(encoder *e, const lexer_token *tok)
+{
+    unsigned int mods = modifiers(e, tok);
+    int type = types[token_category_of(tok->code)];
+    if (type < 0) {
+	return;
+    }
+    // find the column of tok, looking only at the chars since pos
+    const char *s = e->text + e->pos;
+    const char *t = e->text + tok->offset;
+    const char *nl;
+    while ((nl = memchr(s, '\n', (size_t) (t - s))) != NULL) {
+	s = nl + 1;
+	e->column = 0;
+    }
+    e->column += utf16_length(s, (size_t) (t - s));
+    e->pos = tok->offset;
+    unsigned int line = tok->line - 1;
+    unsigned int delta_start = e->column;
+    if (!e->first) {
+	token_writer_put(",", 1);
+	if (line == e->line) {
+	    delta_start -= e->start;
+	}
+    }
+    unsigned int vals[5] = {
+	line - e->line, delta_start, utf16_length(t, tok->length),
+	(unsigned int) type, mods
+    };
+    token_writer_put_int_list(vals, 5, ',');
+    e->first = false;
+    e->line = line;
+    e->start = e->column;
+}
+
+// Return the offset in text[0..len) of the start of the given line
+// (numbering lines from 0), or len if it has fewer lines
+static size_t line_start(const char *text, size_t len, unsigned int line)
+{
+    size_t ret = 0;
+    for (unsigned int n = 0; n < line; n++) {
+	const char *nl = memchr(text + ret, '\n', len - ret);
+	if (nl == NULL) {
+	    return len;
+	}
+	ret = (size_t) (nl - text) + 1;
+    }
+    return ret;
+}
+
+// Print the semantic tokens of the lines from first up to end
+// of the file named fname on standard output
+void semantic_tokens_output(const char *fname,
+			    unsigned int first, unsigned int end)
+{
+    input_file f;
+    error_status status;
+    if (!input_file_map(fname, &f, &status)) {
+	exit_with_error(&status);
+    }
+    const char *text = f.text;
+    size_t len = f.len;
+
+    // lex only the requested lines, which start at a token boundary
+    // since no token or comment spans lines
+    size_t start = line_start(text, len, first);
+    size_t stop = (end == SEMANTIC_END_LINE) ? len
+	: start + line_start(text + start, len - start, end - first);
+    bool values = lexer_token_values();
+    lexer_set_token_values(false);
+    lexer_init_buffer(fname, text + start, stop - start, first + 1, start);
+    encoder e = { text, start, 0, 0, 0, true, 0, false };
+    token_writer_puts("{\"data\":[");
+    lexer_token tok;
+    while (lexer_next_token(&tok)) {
+	put_token(&e, &tok);
+    }
+    token_writer_puts("]}\n");
+    token_writer_flush();
+    lexer_set_token_values(values);
+    input_file_unmap(&f);
+}
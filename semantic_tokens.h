@@ -0,0 +1,44 @@
+#ifndef _SEMANTIC_TOKENS_H
+#define _SEMANTIC_TOKENS_H
+#include <limits.h>
+
+// The Language Server Protocol encodes a document's semantic tokens
+// as an array of integers, 5 for each token:
+//   deltaLine       the token's line minus that of the previous token
+//                   (lines start at 0)
+//   deltaStartChar  the token's column minus that of the previous token
+//                   if they are on the same line, otherwise its column
+//                   (in UTF-16 code units, starting at 0)
+//   length          the length of the token (in UTF-16 code units)
+//   tokenType       an index into SEMANTIC_TOKEN_TYPES
+//   tokenModifiers  a set of bits for SEMANTIC_TOKEN_MODIFIERS
+// The first token's deltas are from line 0 and column 0.
+
+// The legend a server should declare for this encoding, as JSON arrays
+#define SEMANTIC_TOKEN_TYPES \
+    "[\"keyword\",\"variable\",\"number\",\"operator\"]"
+#define SEMANTIC_TOKEN_MODIFIERS "[\"declaration\",\"readonly\"]"
+
+// The token types, indexes into SEMANTIC_TOKEN_TYPES
+typedef enum {
+    semantic_keyword, semantic_variable, semantic_number, semantic_operator
+} semantic_token_type;
+
+// The token modifier bits: a name declared by a constant, variable
+// or procedure declaration is a declaration, and a constant's is readonly
+#define SEMANTIC_DECLARATION 1
+#define SEMANTIC_READONLY 2
+
+// A line past the end of every file, to end a range at the end of a file
+#define SEMANTIC_END_LINE UINT_MAX
+
+// Requires: fname is the name of a readable file and first <= end
+// Print the semantic tokens of the lines from first up to (but not
+// including) end of the file named fname, numbering lines from 0,
+// on standard output as a JSON object {"data":[...]},
+// lexing only those lines; names declared in a declaration that
+// starts before line first are not marked as declarations
+extern void semantic_tokens_output(const char *fname,
+				   unsigned int first, unsigned int end);
+
+#endif
@@ -0,0 +1,591 @@
+// Run the lexer's golden-file tests in this process: each test's
+// input (a .pl0 file) is lexed and the output (with the error messages)
+// is compared to the expected output in the .out file of the same name,
+// ignoring whitespace and blank lines (as diff -w -B does).
+// The flex scanner keeps its state in globals, so the tests are shared
+// among a pool of forked worker processes rather than threads;
+// each worker lexes many tests and never runs ./lexer.
+// Only the failures are printed, each with a compact diff.
+// Each failure is written to the main process as soon as it is found,
+// so the failures a worker found before it crashed are still printed.
+// (For testing the runner itself, if the environment variable
+// TEST_RUNNER_CRASH names a test's input, a worker aborts
+// when it starts that test, as if the lexer had crashed.)
+#define _GNU_SOURCE  // for memfd_create
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "utilities.h"
+#include "ast.h"
+#include "lexer.h"
+#include "token_writer.h"
+
+// the most lines of each side of a difference that are printed
+#define MAX_DIFF_LINES 6
+
+// the most worker processes
+#define MAX_JOBS 256
+
+// A test: the file lexed and the file with the expected output
+typedef struct {
+    char *input;
+    char *expected;
+} test_case;
+
+static test_case *cases = NULL;
+static size_t case_count = 0;
+static size_t case_capacity = 0;
+
+// the input of the test whose worker aborts (or NULL), for testing
+static const char *crash_input = NULL;
+
+// A growable array of chars
+typedef struct {
+    char *chars;
+    size_t len;
+    size_t capacity;
+} text;
+
+// Make t have room for at least n more chars
+static void text_reserve(text *t, size_t n)
+{
+    if (t->len + n <= t->capacity) {
+	return;
+    }
+    size_t cap = (t->capacity == 0) ? 4096 : 2 * t->capacity;
+    while (cap < t->len + n) {
+	cap *= 2;
+    }
+    t->chars = realloc(t->chars, cap);
+    if (t->chars == NULL) {
+	bail_with_error("Cannot allocate space for test output!");
+    }
+    t->capacity = cap;
+}
+
+// Add the formatted string to the end of t
+static void text_printf(text *t, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    text_reserve(t, (size_t) n + 1);
+    va_start(args, fmt);
+    vsnprintf(t->chars + t->len, (size_t) n + 1, fmt, args);
+    va_end(args);
+    t->len += (size_t) n;
+}
+
+// Replace the contents of t by the len bytes read from fd
+// starting at offset 0, and return whether they could be read
+static bool read_fd(int fd, size_t len, text *t)
+{
+    t->len = 0;
+    text_reserve(t, len + 1);
+    while (t->len < len) {
+	ssize_t n = pread(fd, t->chars + t->len, len - t->len,
+			  (off_t) t->len);
+	if (n <= 0) {
+	    return false;
+	}
+	t->len += (size_t) n;
+    }
+    return true;
+}
+
+// Replace the contents of t by the contents of the file named fname,
+// and return whether it could be read
+static bool read_file(const char *fname, text *t)
+{
+    int fd = open(fname, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+	if (fd >= 0) {
+	    close(fd);
+	}
+	return false;
+    }
+    bool ret = read_fd(fd, (size_t) st.st_size, t);
+    close(fd);
+    return ret;
+}
+
+// Does name end with suffix?
+static bool ends_with(const char *name, const char *suffix)
+{
+    size_t n = strlen(name);
+    size_t s = strlen(suffix);
+    return n >= s && strcmp(name + n - s, suffix) == 0;
+}
+
+// Requires: input ends with ".pl0"
+// Add the test whose input is the file named input
+static void add_case(const char *input)
+{
+    if (case_count == case_capacity) {
+	case_capacity = (case_capacity == 0) ? 64 : 2 * case_capacity;
+	cases = realloc(cases, case_capacity * sizeof(test_case));
+	if (cases == NULL) {
+	    bail_with_error("Cannot allocate space for the tests!");
+	}
+    }
+    size_t len = strlen(input);
+    char *expected = malloc(len + 1);
+    char *in = strdup(input);
+    if (expected == NULL || in == NULL) {
+	bail_with_error("Cannot allocate space for the tests!");
+    }
+    memcpy(expected, input, len - 4);
+    strcpy(expected + len - 4, ".out");
+    cases[case_count].input = in;
+    cases[case_count].expected = expected;
+    case_count++;
+}
+
+// Compare the strings pointed to by a and b (for qsort)
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+// Add the tests named by path: the file itself if it is not a directory,
+// otherwise each .pl0 file in the directory (in order of their names)
+static void add_cases(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+	bail_with_error("Cannot find %s", path);
+    }
+    if (!S_ISDIR(st.st_mode)) {
+	if (!ends_with(path, ".pl0")) {
+	    bail_with_error("Test input %s does not end in .pl0", path);
+	}
+	add_case(path);
+	return;
+    }
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+	bail_with_error("Cannot open directory %s", path);
+    }
+    char **names = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+	if (!ends_with(ent->d_name, ".pl0")) {
+	    continue;
+	}
+	if (count == capacity) {
+	    capacity = (capacity == 0) ? 64 : 2 * capacity;
+	    names = realloc(names, capacity * sizeof(char *));
+	}
+	size_t len = strlen(path) + strlen(ent->d_name) + 2;
+	char *name = malloc(len);
+	if (names == NULL || name == NULL) {
+	    bail_with_error("Cannot allocate space for the tests!");
+	}
+	snprintf(name, len, "%s/%s", path, ent->d_name);
+	names[count++] = name;
+    }
+    closedir(dir);
+    qsort(names, count, sizeof(char *), compare_names);
+    for (size_t i = 0; i < count; i++) {
+	add_case(names[i]);
+	free(names[i]);
+    }
+    free(names);
+}
+
+// A line of output that is not blank, without its newline
+typedef struct {
+    const char *start;
+    size_t len;
+    unsigned int number;  // counting from 1
+} line;
+
+// A growable array of lines
+typedef struct {
+    line *lines;
+    size_t count;
+    size_t capacity;
+} line_list;
+
+// Is c a whitespace char, as diff -w sees it?
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Replace the contents of ll by the lines of s[0..len)
+// that have chars other than whitespace
+static void split_lines(const char *s, size_t len, line_list *ll)
+{
+    ll->count = 0;
+    const char *end = s + len;
+    unsigned int number = 1;
+    while (s < end) {
+	const char *nl = memchr(s, '\n', (size_t) (end - s));
+	const char *stop = (nl == NULL) ? end : nl;
+	const char *p = s;
+	while (p < stop && is_space(*p)) {
+	    p++;
+	}
+	if (p < stop) {
+	    if (ll->count == ll->capacity) {
+		ll->capacity = (ll->capacity == 0) ? 256 : 2 * ll->capacity;
+		ll->lines = realloc(ll->lines, ll->capacity * sizeof(line));
+		if (ll->lines == NULL) {
+		    bail_with_error("Cannot allocate space for test output!");
+		}
+	    }
+	    ll->lines[ll->count++] = (line) { s, (size_t) (stop - s), number };
+	}
+	number++;
+	s = stop + 1;
+    }
+}
+
+// Are the lines a and b the same, ignoring whitespace?
+static bool same_line(const line *a, const line *b)
+{
+    const char *p = a->start, *pend = a->start + a->len;
+    const char *q = b->start, *qend = b->start + b->len;
+    for (;;) {
+	while (p < pend && is_space(*p)) {
+	    p++;
+	}
+	while (q < qend && is_space(*q)) {
+	    q++;
+	}
+	if (p == pend || q == qend) {
+	    return p == pend && q == qend;
+	}
+	if (*p++ != *q++) {
+	    return false;
+	}
+    }
+}
+
+// Add the lines from..to of ll to the report r, each after the marker
+static void report_lines(text *r, char marker, const line_list *ll,
+			 size_t from, size_t to)
+{
+    for (size_t i = from; i < to; i++) {
+	if (i - from == MAX_DIFF_LINES) {
+	    text_printf(r, "%c ... (%zu more lines)\n", marker, to - i);
+	    break;
+	}
+	text_printf(r, "%c %.*s\n", marker, (int) ll->lines[i].len,
+		    ll->lines[i].start);
+    }
+}
+
+// Compare the expected lines exp with the lines got of test number i,
+// and add a report of their difference to r if they differ;
+// the report shows the lines between their common beginning and end
+static bool compare_lines(size_t i, const line_list *exp,
+			  const line_list *got, text *r)
+{
+    size_t prefix = 0;
+    while (prefix < exp->count && prefix < got->count
+	   && same_line(&exp->lines[prefix], &got->lines[prefix])) {
+	prefix++;
+    }
+    if (prefix == exp->count && prefix == got->count) {
+	return true;
+    }
+    size_t e = exp->count, g = got->count;
+    while (e > prefix && g > prefix
+	   && same_line(&exp->lines[e-1], &got->lines[g-1])) {
+	e--;
+	g--;
+    }
+    unsigned int eline = (prefix < exp->count)
+	? exp->lines[prefix].number : exp->lines[exp->count-1].number + 1;
+    unsigned int gline = (prefix < got->count)
+	? got->lines[prefix].number : got->lines[got->count-1].number + 1;
+    text_printf(r, "FAILED %s\n@@ %s line %u, output line %u @@\n",
+		cases[i].input, cases[i].expected, eline, gline);
+    report_lines(r, '-', exp, prefix, e);
+    report_lines(r, '+', got, prefix, g);
+    return false;
+}
+
+// The memory shared by the workers and the main process
+typedef struct {
+    atomic_size_t next;             // the next test to run
+    size_t running[MAX_JOBS];       // test each worker is running + 1
+} shared_state;
+
+// Return a file descriptor of a file to hold a test's output,
+// kept in memory if possible
+static int output_file()
+{
+#ifdef __linux__
+    int fd = memfd_create("test_runner", 0);
+    if (fd >= 0) {
+	return fd;
+    }
+#endif
+    FILE *f = tmpfile();
+    if (f == NULL) {
+	bail_with_error("Cannot create a file for test output");
+    }
+    return fileno(f);
+}
+
+// Write to the file descriptor fd a record of the failure of test i,
+// whose report is r: the test's number and the report's length
+// (as two size_t values), then the report, all in one write if possible
+// (the record is written at once, not buffered, so it is not lost
+// if the worker crashes later)
+static void write_record(int fd, size_t i, text *r)
+{
+    size_t len = r->len;
+    text_reserve(r, 2 * sizeof(size_t));
+    memmove(r->chars + 2 * sizeof(size_t), r->chars, len);
+    memcpy(r->chars, &i, sizeof(size_t));
+    memcpy(r->chars + sizeof(size_t), &len, sizeof(size_t));
+    size_t total = len + 2 * sizeof(size_t);
+    size_t done = 0;
+    while (done < total) {
+	ssize_t n = write(fd, r->chars + done, total - done);
+	if (n <= 0) {
+	    bail_with_error("Cannot write a test report");
+	}
+	done += (size_t) n;
+    }
+}
+
+// Requires: report is a file descriptor open for writing
+// Run tests as worker number w until none are left, writing a record
+// to report for each failure (see write_record)
+static void run_worker(int w, shared_state *sh, int report)
+{
+    int fd = output_file();
+    // the lexer's output and error messages go to the file, as 2>&1 does
+    if (dup2(fd, STDOUT_FILENO) < 0 || dup2(fd, STDERR_FILENO) < 0) {
+	bail_with_error("Cannot redirect the lexer's output");
+    }
+    text out = { NULL, 0, 0 };
+    text expected = { NULL, 0, 0 };
+    text r = { NULL, 0, 0 };
+    line_list got_lines = { NULL, 0, 0 };
+    line_list exp_lines = { NULL, 0, 0 };
+    for (;;) {
+	size_t i = atomic_fetch_add(&sh->next, 1);
+	if (i >= case_count) {
+	    break;
+	}
+	sh->running[w] = i + 1;
+	if (crash_input != NULL && strcmp(cases[i].input, crash_input) == 0) {
+	    abort();
+	}
+	if (ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) != 0) {
+	    bail_with_error("Cannot reset the test output file");
+	}
+	r.len = 0;
+	error_status status;
+	clear_error(&status);
+	if (lexer_open(cases[i].input, &status)) {
+	    lexer_output();
+	    token_writer_puts("\n");
+	    token_writer_flush();
+	    ast_release_unit();  // each test is a compilation unit
+	}
+	off_t len = lseek(fd, 0, SEEK_CUR);
+	if (status.failed || !lexer_input_status(&status)) {
+	    text_printf(&r, "FAILED %s\n%s\n", cases[i].input, status.message);
+	} else if (len < 0 || !read_fd(fd, (size_t) len, &out)) {
+	    text_printf(&r, "FAILED %s\ncannot read the lexer's output\n",
+			cases[i].input);
+	} else if (!read_file(cases[i].expected, &expected)) {
+	    text_printf(&r, "FAILED %s\ncannot read %s\n",
+			cases[i].input, cases[i].expected);
+	} else {
+	    split_lines(out.chars, out.len, &got_lines);
+	    split_lines(expected.chars, expected.len, &exp_lines);
+	    compare_lines(i, &exp_lines, &got_lines, &r);
+	}
+	if (r.len > 0) {
+	    write_record(report, i, &r);
+	}
+    }
+    sh->running[w] = 0;
+}
+
+// A failure report: the test's number and what to print
+typedef struct {
+    size_t test;
+    char *report;
+} failure;
+
+static failure *failures = NULL;
+static size_t failure_count = 0;
+static size_t failure_capacity = 0;
+
+// Add a failure of the given test, whose report is r (from malloc)
+static void add_failure(size_t test, char *r)
+{
+    if (failure_count == failure_capacity) {
+	failure_capacity = (failure_capacity == 0) ? 16 : 2 * failure_capacity;
+	failures = realloc(failures, failure_capacity * sizeof(failure));
+	if (failures == NULL) {
+	    bail_with_error("Cannot allocate space for test reports!");
+	}
+    }
+    failures[failure_count].test = test;
+    failures[failure_count].report = r;
+    failure_count++;
+}
+
+// Add the failures in the records written to report by workers
+static void read_failures(FILE *report)
+{
+    rewind(report);
+    size_t test, len;
+    while (fread(&test, sizeof(size_t), 1, report) == 1
+	   && fread(&len, sizeof(size_t), 1, report) == 1) {
+	char *r = malloc(len + 1);
+	if (r == NULL || fread(r, 1, len, report) != len) {
+	    bail_with_error("Cannot read a test report");
+	}
+	r[len] = '\0';
+	add_failure(test, r);
+    }
+}
+
+// Compare the failures pointed to by a and b by test number (for qsort)
+static int compare_failures(const void *a, const void *b)
+{
+    size_t x = ((const failure *) a)->test;
+    size_t y = ((const failure *) b)->test;
+    return (x > y) - (x < y);
+}
+
+// Start worker number w, which writes its failures to report,
+// and return its process id
+static pid_t start_worker(int w, shared_state *sh, int report)
+{
+    fflush(stdout);
+    sh->running[w] = 0;
+    pid_t pid = fork();
+    if (pid < 0) {
+	bail_with_error("Cannot start a test worker");
+    } else if (pid == 0) {
+	run_worker(w, sh, report);
+	_exit(EXIT_SUCCESS);
+    }
+    return pid;
+}
+
+// Print a usage message for the program named cmd and exit
+static void usage(const char *cmd)
+{
+    bail_with_error("Usage: %s [-j jobs] (test.pl0 | directory)...", cmd);
+}
+
+int main(int argc, char *argv[])
+{
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int i = 1;
+    if (i + 1 < argc && strcmp(argv[i], "-j") == 0) {
+	jobs = strtol(argv[i+1], NULL, 10);
+	i += 2;
+    }
+    if (i >= argc || jobs < 1) {
+	usage(argv[0]);
+    }
+    crash_input = getenv("TEST_RUNNER_CRASH");
+    for (; i < argc; i++) {
+	add_cases(argv[i]);
+    }
+    if (jobs > MAX_JOBS) {
+	jobs = MAX_JOBS;
+    }
+    if ((size_t) jobs > case_count) {
+	jobs = (case_count == 0) ? 1 : (long) case_count;
+    }
+
+    shared_state *sh = mmap(NULL, sizeof(shared_state),
+			    PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (sh == MAP_FAILED) {
+	bail_with_error("Cannot allocate memory shared by the workers");
+    }
+    atomic_init(&sh->next, 0);
+    FILE *reports[MAX_JOBS];
+    pid_t pids[MAX_JOBS];
+    for (int w = 0; w < jobs; w++) {
+	reports[w] = tmpfile();
+	if (reports[w] == NULL) {
+	    bail_with_error("Cannot create a file for test reports");
+	}
+	pids[w] = start_worker(w, sh, fileno(reports[w]));
+    }
+
+    // a worker that dies (say, in bail_with_error) fails the test
+    // it was running and is replaced if tests are left
+    long live = jobs;
+    while (live > 0) {
+	int status;
+	pid_t pid = wait(&status);
+	if (pid < 0) {
+	    bail_with_error("Cannot wait for a test worker");
+	}
+	int w = 0;
+	while (w < jobs && pids[w] != pid) {
+	    w++;
+	}
+	if (w == jobs) {
+	    continue;
+	}
+	size_t running = sh->running[w];
+	if (running != 0) {
+	    text r = { NULL, 0, 0 };
+	    if (WIFSIGNALED(status)) {
+		text_printf(&r, "FAILED %s\nthe lexer crashed (signal %d)\n",
+			    cases[running-1].input, WTERMSIG(status));
+	    } else {
+		text_printf(&r, "FAILED %s\nthe lexer exited (status %d)\n",
+			    cases[running-1].input, WEXITSTATUS(status));
+	    }
+	    add_failure(running - 1, r.chars);
+	    if (atomic_load(&sh->next) < case_count) {
+		pids[w] = start_worker(w, sh, fileno(reports[w]));
+		continue;
+	    }
+	}
+	live--;
+    }
+    for (int w = 0; w < jobs; w++) {
+	read_failures(reports[w]);
+	fclose(reports[w]);
+    }
+
+    if (failure_count > 0) {
+	qsort(failures, failure_count, sizeof(failure), compare_failures);
+    }
+    for (size_t f = 0; f < failure_count; f++) {
+	fputs(failures[f].report, stdout);
+	free(failures[f].report);
+    }
+    free(failures);
+    if (failure_count == 0) {
+	printf("All lexer tests passed! (%zu tests)\n", case_count);
+	return EXIT_SUCCESS;
+    }
+    printf("%zu of %zu tests failed!\n", failure_count, case_count);
+    printf("Some lexer test(s) failed!\n");
+    return EXIT_FAILURE;
+}
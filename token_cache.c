@@ -0,0 +1,557 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "utilities.h"
+#include "lexer.h"
+#include "token_writer.h"
+#include "pl0tok.h"
+#include "token_cache.h"
+
+// An entry of the cache is a file named by its key in hex
+// with the suffix ENTRY_SUFFIX, which holds:
+//   ENTRY_MAGIC (8 bytes)
+//   the tokens, as a .pl0tok file
+//   for each error: the number of tokens before it and its line
+//     (8 and 4 bytes), the length of its message (4 bytes)
+//     and the message
+//   a trailer: the size of the .pl0tok data and the number of errors
+//     (8 bytes each), then ENTRY_MAGIC
+// All numbers are little-endian.
+static const char entry_magic[8] = { 'P', 'L', '0', 'T', 'C', 0, 0, 1 };
+#define ENTRY_SUFFIX ".tc"
+#define ENTRY_TRAILER_SIZE 24
+
+// the name of the file of hit and miss counts in the cache directory
+#define STATS_NAME "stats"
+
+// XXH64's primes
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+#define PRIME4 0x85EBCA77C2B2AE63ULL
+#define PRIME5 0x27D4EB2F165667C5ULL
+
+// Return x rotated left by r bits
+static uint64_t rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+// Return the little-endian number of len bytes at p
+static uint64_t load_le(const unsigned char *p, size_t len)
+{
+    uint64_t v = 0;
+    for (size_t i = 0; i < len; i++) {
+	v |= (uint64_t) p[i] << (8 * i);
+    }
+    return v;
+}
+
+// Put v at p as a little-endian number of len bytes
+static void store_le(unsigned char *p, uint64_t v, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+	p[i] = (unsigned char) (v >> (8 * i));
+    }
+}
+
+// Return the 8 bytes at p as a number (in the host's byte order)
+static uint64_t load64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+// Mix the 8 bytes of input into the accumulator acc
+static uint64_t hash_round(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME2;
+    return rotl(acc, 31) * PRIME1;
+}
+
+// Merge the accumulator val into the hash h
+static uint64_t merge_round(uint64_t h, uint64_t val)
+{
+    h ^= hash_round(0, val);
+    return h * PRIME1 + PRIME4;
+}
+
+// Return a 64-bit hash (in the style of XXH64) of the len bytes at p,
+// starting from the given seed
+uint64_t token_cache_hash(const void *p, size_t len, uint64_t seed)
+{
+    const unsigned char *b = (const unsigned char *) p;
+    const unsigned char *end = b + len;
+    uint64_t h;
+    if (len >= 32) {
+	// four independent lanes, 32 bytes at a time
+	uint64_t v1 = seed + PRIME1 + PRIME2;
+	uint64_t v2 = seed + PRIME2;
+	uint64_t v3 = seed;
+	uint64_t v4 = seed - PRIME1;
+	do {
+	    v1 = hash_round(v1, load64(b));
+	    v2 = hash_round(v2, load64(b + 8));
+	    v3 = hash_round(v3, load64(b + 16));
+	    v4 = hash_round(v4, load64(b + 24));
+	    b += 32;
+	} while (end - b >= 32);
+	h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+	h = merge_round(h, v1);
+	h = merge_round(h, v2);
+	h = merge_round(h, v3);
+	h = merge_round(h, v4);
+    } else {
+	h = seed + PRIME5;
+    }
+    h += (uint64_t) len;
+    while (end - b >= 8) {
+	h ^= hash_round(0, load64(b));
+	h = rotl(h, 27) * PRIME1 + PRIME4;
+	b += 8;
+    }
+    while (b < end) {
+	h ^= *b++ * PRIME5;
+	h = rotl(h, 11) * PRIME1;
+    }
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+// Initialize c to use the cache directory dir (creating it if needed),
+// whose entries should total at most max_bytes
+void token_cache_init(token_cache *c, const char *dir, size_t max_bytes)
+{
+    c->dir = dir;
+    c->max_bytes = max_bytes;
+    c->bytes = 0;
+    c->bytes_counted = false;
+    c->hits = 0;
+    c->misses = 0;
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+	bail_with_error("Cannot create the cache directory %s", dir);
+    }
+    errno = 0;
+}
+
+// Return a fresh string holding the path of the file name in c's directory
+static char *cache_path(const token_cache *c, const char *name)
+{
+    size_t len = strlen(c->dir) + strlen(name) + 2;
+    char *ret = (char *) malloc(len);
+    if (ret == NULL) {
+	bail_with_error("Cannot allocate space for a file name!");
+    }
+    snprintf(ret, len, "%s/%s", c->dir, name);
+    return ret;
+}
+
+// Add the given numbers of hits and misses to the counts
+// in the stats file of c's directory, locking it while doing so
+static void count_lookup(const token_cache *c, unsigned long hits,
+			 unsigned long misses)
+{
+    char *path = cache_path(c, STATS_NAME);
+    int fd = open(path, O_RDWR | O_CREAT, 0666);
+    free(path);
+    if (fd < 0) {
+	errno = 0;
+	return;  // the counts are only advisory
+    }
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    if (fcntl(fd, F_SETLKW, &lock) == 0) {
+	char buf[128];
+	ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+	unsigned long old_hits = 0, old_misses = 0;
+	if (n > 0) {
+	    buf[n] = '\0';
+	    sscanf(buf, "hits %lu misses %lu", &old_hits, &old_misses);
+	}
+	int len = snprintf(buf, sizeof(buf), "hits %lu\nmisses %lu\n",
+			   old_hits + hits, old_misses + misses);
+	if (pwrite(fd, buf, (size_t) len, 0) == len) {
+	    if (ftruncate(fd, len) != 0) {
+		// a longer old count is left at the end; ignore it
+	    }
+	}
+    }
+    close(fd);  // also releases the lock
+    errno = 0;
+}
+
+// Return the key of the len bytes of input at p:
+// a hash of them, the scanner's version and the lexer's settings
+static uint64_t input_key(const char *p, size_t len)
+{
+    char settings[128];
+    int n = snprintf(settings, sizeof(settings), "%s limit %zu",
+		     LEXER_SCANNER_VERSION, lexer_lexeme_limit());
+    uint64_t seed = token_cache_hash(settings, (size_t) n, 0);
+    return token_cache_hash(p, len, seed);
+}
+
+// Return a fresh string holding the name of the entry for key
+static char *entry_path(const token_cache *c, uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx" ENTRY_SUFFIX,
+	     (unsigned long long) key);
+    return cache_path(c, name);
+}
+
+// Read all of the file named fname into fresh storage,
+// setting *len to its length; but if it cannot be read,
+// fill in *status and return NULL
+static char *read_file(const char *fname, size_t *len,
+		       error_status *status)
+{
+    errno = 0;
+    FILE *f = fopen(fname, "rb");
+    if (f == NULL) {
+	fail_with_error(status, "Cannot open %s", fname);
+	return NULL;
+    }
+    size_t cap = 1 << 16;
+    size_t used = 0;
+    char *buf = (char *) malloc(cap);
+    for (;;) {
+	if (buf == NULL) {
+	    bail_with_error("Cannot allocate space to read %s!", fname);
+	}
+	used += fread(buf + used, 1, cap - used, f);
+	if (used < cap) {
+	    break;
+	}
+	cap *= 2;
+	buf = (char *) realloc(buf, cap);
+    }
+    if (ferror(f)) {
+	fail_with_error(status, "Cannot read %s", fname);
+	fclose(f);
+	free(buf);
+	return NULL;
+    }
+    fclose(f);
+    *len = used;
+    return buf;
+}
+
+// Requires: the lexer has been initialized
+// Print the output stored in the entry of size bytes at base
+// and return true, or return false if the entry is malformed
+// (before printing anything)
+static bool replay_entry(const unsigned char *base, size_t size)
+{
+    if (size < sizeof(entry_magic) + ENTRY_TRAILER_SIZE
+	|| memcmp(base, entry_magic, sizeof(entry_magic)) != 0
+	|| memcmp(base + size - 8, entry_magic, sizeof(entry_magic)) != 0) {
+	return false;
+    }
+    const unsigned char *trailer = base + size - ENTRY_TRAILER_SIZE;
+    uint64_t tok_size = load_le(trailer, 8);
+    uint64_t error_count = load_le(trailer + 8, 8);
+    size_t tok_space = size - ENTRY_TRAILER_SIZE - sizeof(entry_magic);
+    if (tok_size > tok_space) {
+	return false;
+    }
+    pl0tok_reader r;
+    if (pl0tok_open_bytes(&r, base + sizeof(entry_magic), tok_size) != NULL) {
+	return false;
+    }
+    // check the errors before printing anything
+    const unsigned char *errors = base + sizeof(entry_magic) + tok_size;
+    const unsigned char *errors_end = trailer;
+    const unsigned char *e = errors;
+    for (uint64_t i = 0; i < error_count; i++) {
+	if (errors_end - e < 16
+	    || (uint64_t) (errors_end - e - 16) < load_le(e + 12, 4)) {
+	    return false;
+	}
+	e += 16 + load_le(e + 12, 4);
+    }
+
+    lexer_print_output_header();
+    e = errors;
+    uint64_t tokens = 0;
+    pl0tok_iter it;
+    pl0tok_iter_init(&r, &it);
+    pl0tok_token tok;
+    for (;;) {
+	// each error is printed before the token that followed it
+	while (e < errors_end && load_le(e, 8) <= tokens) {
+	    size_t len = (size_t) load_le(e + 12, 4);
+	    char *msg = (char *) malloc(len + 1);
+	    if (msg == NULL) {
+		bail_with_error("Cannot allocate space for an error message!");
+	    }
+	    memcpy(msg, e + 16, len);
+	    msg[len] = '\0';
+	    lexer_report_error((unsigned int) load_le(e + 8, 4), msg);
+	    free(msg);
+	    e += 16 + len;
+	}
+	if (!pl0tok_next(&r, &it, &tok)) {
+	    break;
+	}
+	lexer_print_token(tok.code, tok.line, tok.text);
+	tokens++;
+    }
+    token_writer_flush();
+    if (it.error != NULL) {
+	bail_with_error("Corrupt token cache entry: %s", it.error);
+    }
+    return true;
+}
+
+// Requires: the lexer has been initialized
+// Print the output stored in the entry at path and return true,
+// or return false if there is no such entry (or it is malformed)
+static bool try_entry(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+	errno = 0;
+	return false;
+    }
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+	base = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+	errno = 0;
+	return false;
+    }
+    bool ret = replay_entry((const unsigned char *) base, (size_t) st.st_size);
+    munmap(base, (size_t) st.st_size);
+    if (ret) {
+	// mark the entry as recently used
+	utimensat(AT_FDCWD, path, NULL, 0);
+	errno = 0;
+    }
+    return ret;
+}
+
+// The errors reported while lexing an input to store in the cache
+static struct {
+    unsigned char *bytes;  // in the entry's format
+    size_t used;
+    size_t capacity;
+    uint64_t count;
+    uint64_t tokens;       // number of tokens read so far
+} errors;
+
+// Add an error reported by the lexer to errors
+static void note_error(unsigned int line, const char *msg)
+{
+    size_t len = strlen(msg);
+    if (errors.used + 16 + len > errors.capacity) {
+	size_t cap = errors.capacity == 0 ? 1024 : 2 * errors.capacity;
+	while (errors.used + 16 + len > cap) {
+	    cap *= 2;
+	}
+	errors.bytes = (unsigned char *) realloc(errors.bytes, cap);
+	if (errors.bytes == NULL) {
+	    bail_with_error("Cannot allocate space for error messages!");
+	}
+	errors.capacity = cap;
+    }
+    unsigned char *p = errors.bytes + errors.used;
+    store_le(p, errors.tokens, 8);
+    store_le(p + 8, line, 4);
+    store_le(p + 12, len, 4);
+    memcpy(p + 16, msg, len);
+    errors.used += 16 + len;
+    errors.count++;
+}
+
+// An entry of the cache directory, for eviction
+typedef struct {
+    char *name;
+    off_t size;
+    struct timespec used;  // last modification time
+} entry_info;
+
+// Compare entries by their time of last use, oldest first
+static int compare_use(const void *a, const void *b)
+{
+    const struct timespec *x = &((const entry_info *) a)->used;
+    const struct timespec *y = &((const entry_info *) b)->used;
+    if (x->tv_sec != y->tv_sec) {
+	return (x->tv_sec < y->tv_sec) ? -1 : 1;
+    }
+    return (x->tv_nsec < y->tv_nsec) ? -1 : (x->tv_nsec > y->tv_nsec);
+}
+
+// Remove the least recently used entries of c's directory
+// until their total size is at most c->max_bytes,
+// and set c->bytes to the total size of those left
+static void evict(token_cache *c)
+{
+    DIR *d = opendir(c->dir);
+    if (d == NULL) {
+	errno = 0;
+	return;
+    }
+    entry_info *entries = NULL;
+    size_t count = 0, capacity = 0;
+    uint64_t total = 0;
+    size_t suffix_len = strlen(ENTRY_SUFFIX);
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+	size_t len = strlen(de->d_name);
+	if (len <= suffix_len
+	    || strcmp(de->d_name + len - suffix_len, ENTRY_SUFFIX) != 0) {
+	    continue;
+	}
+	char *path = cache_path(c, de->d_name);
+	struct stat st;
+	if (stat(path, &st) == 0) {
+	    if (count == capacity) {
+		capacity = capacity == 0 ? 64 : 2 * capacity;
+		entries = (entry_info *)
+		    realloc(entries, capacity * sizeof(entry_info));
+		if (entries == NULL) {
+		    bail_with_error("Cannot allocate space for cache entries!");
+		}
+	    }
+	    entries[count].name = path;
+	    entries[count].size = st.st_size;
+	    entries[count].used = st.st_mtim;
+	    count++;
+	    total += (uint64_t) st.st_size;
+	} else {
+	    free(path);
+	}
+    }
+    closedir(d);
+    qsort(entries, count, sizeof(entry_info), compare_use);
+    for (size_t i = 0; i < count; i++) {
+	if (total > c->max_bytes && unlink(entries[i].name) == 0) {
+	    total -= (uint64_t) entries[i].size;
+	}
+	free(entries[i].name);
+    }
+    free(entries);
+    c->bytes = total;
+    c->bytes_counted = true;
+    errno = 0;
+}
+
+// Requires: the lexer has been initialized on the contents of the file
+//           fname that were hashed for path
+// Print the lexer's output for its input (as lexer_output does),
+// and store it in c's directory as the entry at path
+static void lex_and_store(token_cache *c, const char *fname, const char *path)
+{
+    char *tmp = cache_path(c, "tmp.XXXXXX");
+    int fd = mkstemp(tmp);
+    FILE *out = (fd < 0) ? NULL : fdopen(fd, "wb");
+    if (out == NULL && fd >= 0) {
+	close(fd);
+    }
+    errno = 0;
+    pl0tok_writer w;
+    if (out != NULL) {
+	fwrite(entry_magic, 1, sizeof(entry_magic), out);
+	pl0tok_writer_init(&w, out);
+	pl0tok_write_file(&w, fname);
+    }
+    errors.used = 0;
+    errors.count = 0;
+    errors.tokens = 0;
+    lexer_set_error_hook(note_error);
+    bool values = lexer_token_values();
+    lexer_set_token_values(false);
+
+    lexer_print_output_header();
+    lexer_token tok;
+    while (lexer_next_token(&tok)) {
+	const char *text = lexer_token_text();
+	lexer_print_token(tok.code, tok.line, text);
+	if (out != NULL) {
+	    pl0tok_write_token(&w, tok.code, tok.line, text, strlen(text));
+	}
+	errors.tokens++;
+    }
+    token_writer_flush();
+    lexer_set_error_hook(NULL);
+    lexer_set_token_values(values);
+    if (out == NULL) {
+	free(tmp);
+	return;  // the output just is not cached
+    }
+
+    pl0tok_writer_finish(&w);
+    unsigned char trailer[ENTRY_TRAILER_SIZE];
+    store_le(trailer, w.pos, 8);
+    store_le(trailer + 8, errors.count, 8);
+    memcpy(trailer + 16, entry_magic, sizeof(entry_magic));
+    if (errors.used > 0) {
+	fwrite(errors.bytes, 1, errors.used, out);
+    }
+    fwrite(trailer, 1, ENTRY_TRAILER_SIZE, out);
+    long size = ftell(out);
+    error_status status;
+    bool ok = !ferror(out) && size >= 0 && lexer_input_status(&status);
+    ok = (fclose(out) == 0) && ok;
+    // the rename makes the finished entry appear all at once
+    if (!ok || rename(tmp, path) != 0) {
+	unlink(tmp);
+	size = 0;
+    }
+    free(tmp);
+    errno = 0;
+    c->bytes += (uint64_t) size;
+    if (!c->bytes_counted || c->bytes > c->max_bytes) {
+	evict(c);
+    }
+}
+
+// Print the lexer's output for the file named fname (as lexer_output
+// does, including error messages), taking it from the cache if the
+// file's contents are there, otherwise lexing the file and storing
+// the result in the cache; return true, but if the file cannot be
+// read, fill in *status and return false.
+// The file is read once: the contents hashed for the cache's key are
+// the ones lexed, so an entry never holds the output for other
+// contents (as it could if the file changed between two reads).
+bool token_cache_lexer_output(token_cache *c, char *fname,
+			      error_status *status)
+{
+    size_t len;
+    char *input = read_file(fname, &len, status);
+    if (input == NULL) {
+	return false;
+    }
+    lexer_init_buffer(fname, input, len, 1, 0);
+    char *path = entry_path(c, input_key(input, len));
+    free(input);  // the lexer has its own copy
+    if (try_entry(path)) {
+	c->hits++;
+	count_lookup(c, 1, 0);
+    } else {
+	c->misses++;
+	count_lookup(c, 0, 1);
+	lex_and_store(c, fname, path);
+    }
+    free(path);
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef _TOKEN_CACHE_H
+#define _TOKEN_CACHE_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "utilities.h"
+
+// The default bound on the total size of a cache directory's entries
+#define TOKEN_CACHE_DEFAULT_MAX_BYTES ((size_t) 256 << 20)
+
+// An on-disk cache of the lexer's output, kept in a directory.
+// Each entry holds the tokens (in .pl0tok form) and the error messages
+// for one input, and is named by a hash of the input's bytes,
+// the scanner's version and the lexer's settings.
+// Entries are written to a temporary file and renamed into place,
+// so readers never see a partial entry; when the entries' total size
+// exceeds the bound, the least recently used ones are removed.
+// The directory is only scanned for that when a running total of the
+// entries' sizes exceeds the bound (or to count it the first time).
+// The directory's "stats" file counts hits and misses over all runs.
+typedef struct {
+    const char *dir;
+    size_t max_bytes;     // bound on the total size of the entries
+    uint64_t bytes;       // their total size when last counted,
+                          // plus the sizes of the entries stored since
+    bool bytes_counted;   // has that total been counted?
+    unsigned long hits;   // in this process
+    unsigned long misses;
+} token_cache;
+
+// Requires: c != NULL and dir != NULL
+// Initialize c to use the cache directory dir (creating it if needed),
+// whose entries should total at most max_bytes
+extern void token_cache_init(token_cache *c, const char *dir,
+			     size_t max_bytes);
+
+// Return a 64-bit hash (in the style of XXH64) of the len bytes at p,
+// starting from the given seed
+extern uint64_t token_cache_hash(const void *p, size_t len, uint64_t seed);
+
+// Requires: c != NULL and fname != NULL and status != NULL
+// Print the lexer's output for the file named fname (as lexer_output
+// does, including error messages), taking it from the cache if the
+// file's contents are there, otherwise lexing the file and storing
+// the result in the cache; return true, but if the file cannot be
+// read, fill in *status and return false (after printing
+// whatever output was lexed before the failure)
+extern bool token_cache_lexer_output(token_cache *c, char *fname,
+				     error_status *status);
+
+#endif
@@ -0,0 +1,65 @@
+#include "pl0.tab.h"
+#include "token_info.h"
+
+// the first and last token codes of pl0.tab.h
+#define FIRST_CODE identsym
+#define LAST_CODE rparensym
+
+// The name and kind of each token code, indexed by code - FIRST_CODE
+static const struct {
+    const char *name;
+    token_category category;
+} info[LAST_CODE - FIRST_CODE + 1] = {
+    [identsym - FIRST_CODE] = { "identsym", token_identifier },
+    [numbersym - FIRST_CODE] = { "numbersym", token_number },
+    [plussym - FIRST_CODE] = { "plussym", token_operator },
+    [minussym - FIRST_CODE] = { "minussym", token_operator },
+    [multsym - FIRST_CODE] = { "multsym", token_operator },
+    [divsym - FIRST_CODE] = { "divsym", token_operator },
+    [periodsym - FIRST_CODE] = { "periodsym", token_operator },
+    [semisym - FIRST_CODE] = { "semisym", token_operator },
+    [eqsym - FIRST_CODE] = { "eqsym", token_operator },
+    [commasym - FIRST_CODE] = { "commasym", token_operator },
+    [becomessym - FIRST_CODE] = { "becomessym", token_operator },
+    [constsym - FIRST_CODE] = { "constsym", token_keyword },
+    [varsym - FIRST_CODE] = { "varsym", token_keyword },
+    [proceduresym - FIRST_CODE] = { "proceduresym", token_keyword },
+    [callsym - FIRST_CODE] = { "callsym", token_keyword },
+    [beginsym - FIRST_CODE] = { "beginsym", token_keyword },
+    [endsym - FIRST_CODE] = { "endsym", token_keyword },
+    [ifsym - FIRST_CODE] = { "ifsym", token_keyword },
+    [thensym - FIRST_CODE] = { "thensym", token_keyword },
+    [elsesym - FIRST_CODE] = { "elsesym", token_keyword },
+    [whilesym - FIRST_CODE] = { "whilesym", token_keyword },
+    [dosym - FIRST_CODE] = { "dosym", token_keyword },
+    [readsym - FIRST_CODE] = { "readsym", token_keyword },
+    [writesym - FIRST_CODE] = { "writesym", token_keyword },
+    [skipsym - FIRST_CODE] = { "skipsym", token_keyword },
+    [oddsym - FIRST_CODE] = { "oddsym", token_keyword },
+    [neqsym - FIRST_CODE] = { "neqsym", token_operator },
+    [ltsym - FIRST_CODE] = { "ltsym", token_operator },
+    [leqsym - FIRST_CODE] = { "leqsym", token_operator },
+    [gtsym - FIRST_CODE] = { "gtsym", token_operator },
+    [geqsym - FIRST_CODE] = { "geqsym", token_operator },
+    [lparensym - FIRST_CODE] = { "lparensym", token_operator },
+    [rparensym - FIRST_CODE] = { "rparensym", token_operator },
+};
+
+// Return the symbolic name of the token code (as in pl0.tab.h,
+// e.g., "identsym"), or "YYUNDEF" if code is not a token code
+const char *token_name(int code)
+{
+    if (code < FIRST_CODE || code > LAST_CODE) {
+	return "YYUNDEF";
+    }
+    return info[code - FIRST_CODE].name;
+}
+
+// Return the kind of token that code is
+token_category token_category_of(int code)
+{
+    if (code < FIRST_CODE || code > LAST_CODE) {
+	return token_other_category;
+    }
+    return info[code - FIRST_CODE].category;
+}
@@ -0,0 +1,20 @@
+#ifndef _TOKEN_INFO_H
+#define _TOKEN_INFO_H
+
+// The kinds of tokens, as grouped in pl0.tab.h's yytokentype
+typedef enum {
+    token_other_category,  // not a token code
+    token_keyword,         // reserved words, from constsym to oddsym
+    token_identifier,      // identsym
+    token_number,          // numbersym
+    token_operator         // operators and punctuation
+} token_category;
+
+// Return the symbolic name of the token code (as in pl0.tab.h,
+// e.g., "identsym"), or "YYUNDEF" if code is not a token code
+extern const char *token_name(int code);
+
+// Return the kind of token that code is
+extern token_category token_category_of(int code);
+
+#endif
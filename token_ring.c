@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <string.h>
+#include "utilities.h"
+#include "pl0.tab.h"
+#include "token_ring.h"
+
+// mask that reduces an index to a slot number
+#define RING_MASK (TOKEN_RING_CAPACITY - 1)
+
+#if (TOKEN_RING_CAPACITY & RING_MASK) != 0
+#error "TOKEN_RING_CAPACITY must be a power of 2"
+#endif
+
+// Initialize r to read tokens from the lexer,
+// keeping each token's value (yylval) if values is true
+void token_ring_init(token_ring *r, bool values)
+{
+    memset(r, 0, sizeof(token_ring));
+    r->values = values;
+    r->end.tok.code = YYEOF;
+    r->end.text = "";
+}
+
+// Free the storage used for long token texts by r
+void token_ring_free(token_ring *r)
+{
+    for (int i = 0; i < TOKEN_RING_CAPACITY; i++) {
+	free(r->slots[i].long_text);
+	r->slots[i].long_text = NULL;
+	r->slots[i].long_capacity = 0;
+    }
+}
+
+// Copy the text txt, of length len, into the slot s
+static void set_text(ring_token *s, const char *txt, size_t len)
+{
+    char *dest = s->inline_text;
+    if (len >= TOKEN_RING_INLINE_TEXT) {
+	if (len >= s->long_capacity) {
+	    size_t cap = 2 * len;
+	    free(s->long_text);
+	    s->long_text = (char *) malloc(cap);
+	    if (s->long_text == NULL) {
+		bail_with_error("Cannot allocate space for a token's text!");
+	    }
+	    s->long_capacity = cap;
+	}
+	dest = s->long_text;
+    }
+    memcpy(dest, txt, len + 1);
+    s->text = dest;
+}
+
+// Read tokens from the lexer into r, at most a batch of them,
+// without overwriting the current token or the mark
+// (the lexer makes token values only if r keeps them, and its
+// setting for its other callers is restored afterwards)
+static void fill(token_ring *r)
+{
+    unsigned long keep = r->marked ? r->mark : r->head;
+    unsigned long stop = r->tail + TOKEN_RING_BATCH;
+    if (stop > keep + TOKEN_RING_CAPACITY) {
+	stop = keep + TOKEN_RING_CAPACITY;
+    }
+    if (r->tail == stop) {
+	bail_with_error("Cannot look more than %d tokens ahead!",
+			TOKEN_RING_CAPACITY);
+    }
+    bool values = lexer_token_values();
+    lexer_set_token_values(r->values);
+    while (r->tail < stop) {
+	ring_token *s = &r->slots[r->tail & RING_MASK];
+	if (!lexer_next_token(&s->tok)) {
+	    r->eof = true;
+	    r->end.tok.line = lexer_line();
+	    break;
+	}
+	const char *txt = lexer_token_text();
+	set_text(s, txt, strlen(txt));
+	if (r->values) {
+	    // the lexer's values are pointers, like the members of token_value
+	    memcpy(&s->value, &yylval, sizeof(token_value));
+	}
+	r->tail++;
+    }
+    lexer_set_token_values(values);
+}
+
+// Return the token k tokens past the current one (k == 0 is the
+// current token); past the end of the input this is a token whose
+// code is YYEOF.
+const ring_token *token_ring_peek(token_ring *r, unsigned int k)
+{
+    unsigned long i = r->head + k;
+    while (i >= r->tail) {
+	if (r->eof) {
+	    return &r->end;
+	}
+	fill(r);
+    }
+    return &r->slots[i & RING_MASK];
+}
+
+// Make the token after the current one the current token
+void token_ring_advance(token_ring *r)
+{
+    if (r->head == r->tail && !r->eof) {
+	fill(r);
+    }
+    if (r->head < r->tail) {
+	r->head++;
+    }
+}
+
+// Remember the position of the current token,
+// so that token_ring_reset can return to it
+void token_ring_mark(token_ring *r)
+{
+    r->mark = r->head;
+    r->marked = true;
+}
+
+// Make the token at the mark the current token again
+void token_ring_reset(token_ring *r)
+{
+    r->head = r->mark;
+}
+
+// Forget the mark, if any, so its tokens can be reused
+void token_ring_release(token_ring *r)
+{
+    r->marked = false;
+}
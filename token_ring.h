@@ -0,0 +1,84 @@
+#ifndef _TOKEN_RING_H
+#define _TOKEN_RING_H
+#include <stdbool.h>
+#include "ast.h"
+#include "lexer.h"
+
+// Number of tokens a token_ring holds (must be a power of 2);
+// this bounds how far ahead of a mark a client can look
+#define TOKEN_RING_CAPACITY 64
+
+// Maximum number of tokens read from the lexer at a time
+#define TOKEN_RING_BATCH 16
+
+// Token texts up to this length (including the null char)
+// are stored in the ring's slots themselves
+#define TOKEN_RING_INLINE_TEXT 32
+
+// The value of a token, which is (a pointer to) one of the
+// alternatives of AST that the lexer makes for tokens
+typedef union {
+    token_t *token;
+    ident_t *ident;
+    number_t *number;
+} token_value;
+
+// A token held in a token_ring
+typedef struct {
+    lexer_token tok;
+    token_value value;  // only set if the ring was made with values
+    const char *text;   // the token's text (null terminated)
+    char inline_text[TOKEN_RING_INLINE_TEXT];
+    char *long_text;    // space for a longer text, reused by later tokens
+    size_t long_capacity;
+} ring_token;
+
+// A fixed capacity buffer of tokens read ahead from the lexer.
+// Indexes are absolute token numbers, reduced to slots by masking.
+typedef struct {
+    ring_token slots[TOKEN_RING_CAPACITY];
+    unsigned long head;  // index of the current token
+    unsigned long tail;  // index one past the last token read
+    unsigned long mark;  // index saved by token_ring_mark
+    bool marked;         // is there a mark?
+    bool values;         // are token values (yylval) kept?
+    bool eof;            // has the lexer reached the end of the input?
+    ring_token end;      // returned for positions past the end of input
+} token_ring;
+
+// Requires: r != NULL and the lexer has been initialized
+// Initialize r to read tokens from the lexer,
+// keeping each token's value (yylval) if values is true
+extern void token_ring_init(token_ring *r, bool values);
+
+// Requires: r != NULL
+// Free the storage used for long token texts by r
+extern void token_ring_free(token_ring *r);
+
+// Requires: r != NULL and k < TOKEN_RING_CAPACITY
+//           (less the number of tokens since the mark, if any)
+// Return the token k tokens past the current one (k == 0 is the
+// current token); past the end of the input this is a token whose
+// code is YYEOF.
+// The result is valid until the ring is advanced past it.
+extern const ring_token *token_ring_peek(token_ring *r, unsigned int k);
+
+// Requires: r != NULL
+// Make the token after the current one the current token
+extern void token_ring_advance(token_ring *r);
+
+// Requires: r != NULL
+// Remember the position of the current token,
+// so that token_ring_reset can return to it
+extern void token_ring_mark(token_ring *r);
+
+// Requires: r != NULL and r has a mark
+// Make the token at the mark the current token again
+// (the mark stays in place)
+extern void token_ring_reset(token_ring *r);
+
+// Requires: r != NULL
+// Forget the mark, if any, so its tokens can be reused
+extern void token_ring_release(token_ring *r);
+
+#endif
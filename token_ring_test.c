@@ -0,0 +1,211 @@
+// A test of the token ring: it lexes each given file token by token
+// with lexer_next_token, then lexes it again through a token_ring,
+// making a pseudo-random series of lookaheads (token_ring_peek),
+// advances, marks, resets and releases until it is past the end of
+// the input, and checks that each token seen through the ring is the
+// same (code, line, offset, length and text) as the one lexed directly,
+// and that positions at or past the end give a YYEOF token on the last
+// line. It does this with and without token values, checking that
+// the ring leaves the lexer's token values setting as it found it.
+// Only the differences are printed.
+//
+// Usage: token_ring_test file.pl0 ...
+#define _POSIX_C_SOURCE 200809L  // for strdup
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ast.h"
+#include "diagnostics.h"
+#include "lexer.h"
+#include "pl0.tab.h"
+#include "token_ring.h"
+#include "utilities.h"
+
+// the number of operations on the ring per token of the input
+#define RING_TEST_OPS_PER_TOKEN 8
+
+// a small linear congruential generator, so the operations are the same
+// in every run
+static unsigned long seed = 11;
+
+// Return a pseudo-random number less than n
+static unsigned long pick(unsigned long n)
+{
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    return (seed >> 33) % n;
+}
+
+// A token lexed directly, with a copy of its text
+typedef struct {
+    lexer_token tok;
+    char *text;
+} expected_token;
+
+static expected_token *expected = NULL;
+static unsigned long expected_count = 0;
+static unsigned long expected_capacity = 0;
+static unsigned int eof_line = 0;  // the line the input ends on
+
+// Lex the file named fname directly into expected (and eof_line)
+static void lex_expected(char *fname)
+{
+    for (unsigned long i = 0; i < expected_count; i++) {
+	free(expected[i].text);
+    }
+    expected_count = 0;
+    error_status status;
+    if (!lexer_open(fname, &status)) {
+	exit_with_error(&status);
+    }
+    lexer_token tok;
+    while (lexer_next_token(&tok)) {
+	if (expected_count == expected_capacity) {
+	    expected_capacity = (expected_capacity == 0)
+		? 1024 : 2 * expected_capacity;
+	    expected = realloc(expected,
+			       expected_capacity * sizeof(expected_token));
+	    if (expected == NULL) {
+		bail_with_error("Cannot allocate space for the tokens!");
+	    }
+	}
+	expected[expected_count].tok = tok;
+	expected[expected_count].text = strdup(lexer_token_text());
+	if (expected[expected_count].text == NULL) {
+	    bail_with_error("Cannot allocate space for the tokens!");
+	}
+	expected_count++;
+    }
+    eof_line = lexer_line();
+}
+
+// Return whether the token t, seen through the ring at index i,
+// is the expected one; if not, print the difference
+static bool check_token(const char *fname, const char *what,
+			unsigned long i, const ring_token *t, bool values)
+{
+    bool ok;
+    if (i < expected_count) {
+	const expected_token *e = &expected[i];
+	ok = t->tok.code == e->tok.code && t->tok.line == e->tok.line
+	    && t->tok.offset == e->tok.offset
+	    && t->tok.length == e->tok.length
+	    && strcmp(t->text, e->text) == 0
+	    && (!values || t->value.token != NULL);
+	if (!ok) {
+	    printf("FAILED %s\n%s token %lu: expected %d \"%s\" on line %u,"
+		   " got %d \"%s\" on line %u\n", fname, what, i,
+		   e->tok.code, e->text, e->tok.line,
+		   t->tok.code, t->text, t->tok.line);
+	}
+    } else {
+	ok = t->tok.code == YYEOF && t->tok.line == eof_line
+	    && strcmp(t->text, "") == 0;
+	if (!ok) {
+	    printf("FAILED %s\n%s token %lu: expected the end of the input"
+		   " on line %u, got %d \"%s\" on line %u\n", fname, what, i,
+		   eof_line, t->tok.code, t->text, t->tok.line);
+	}
+    }
+    return ok;
+}
+
+// Read the file named fname through a ring (keeping token values
+// if values is true), checking what it gives against expected;
+// return whether all was as expected
+static bool test_ring(char *fname, bool values)
+{
+    // the setting that the ring must leave as it is
+    bool setting = !values;
+    lexer_set_token_values(setting);
+    error_status status;
+    if (!lexer_open(fname, &status)) {
+	exit_with_error(&status);
+    }
+    token_ring r;
+    token_ring_init(&r, values);
+    const char *what = values ? "with values," : "without values,";
+    unsigned long pos = 0;   // the index of the current token
+    unsigned long mark = 0;
+    bool marked = false;
+    unsigned long ops = RING_TEST_OPS_PER_TOKEN * (expected_count + 8);
+    bool ok = true;
+    for (unsigned long op = 0; ok && op < ops; op++) {
+	// how far ahead of the current token the ring can look
+	unsigned long room = TOKEN_RING_CAPACITY - (marked ? pos - mark : 0);
+	switch (pick(8)) {
+	case 0: case 1: case 2: {
+	    unsigned long k = pick(room);
+	    ok = check_token(fname, what, pos + k,
+			     token_ring_peek(&r, (unsigned int) k), values);
+	    break;
+	}
+	case 3: case 4: case 5:
+	    if (room > 1) {
+		token_ring_advance(&r);
+		if (pos < expected_count) {
+		    pos++;
+		}
+	    }
+	    break;
+	case 6:
+	    if (marked && pick(2) == 0) {
+		token_ring_reset(&r);
+		pos = mark;
+	    } else {
+		token_ring_mark(&r);
+		mark = pos;
+		marked = true;
+	    }
+	    break;
+	default:
+	    token_ring_release(&r);
+	    marked = false;
+	    break;
+	}
+	if (lexer_token_values() != setting) {
+	    printf("FAILED %s\n%s the ring changed the lexer's token values"
+		   " setting\n", fname, what);
+	    ok = false;
+	}
+    }
+    // then read to the end, which must stay there
+    token_ring_release(&r);
+    while (ok && pos <= expected_count + 1) {
+	ok = check_token(fname, what, pos, token_ring_peek(&r, 0), values);
+	token_ring_advance(&r);
+	pos++;
+    }
+    token_ring_free(&r);
+    ast_release_unit();
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+	bail_with_error("Usage: %s file.pl0 ...", argv[0]);
+    }
+    // the tests' lexical errors are not the point here
+    diagnostics_set_format(diagnostics_none);
+    int failed = 0;
+    for (int i = 1; i < argc; i++) {
+	lex_expected(argv[i]);
+	bool ok = test_ring(argv[i], false);
+	ok = test_ring(argv[i], true) && ok;
+	if (!ok) {
+	    failed++;
+	}
+	ast_release_unit();
+    }
+    for (unsigned long i = 0; i < expected_count; i++) {
+	free(expected[i].text);
+    }
+    free(expected);
+    if (failed > 0) {
+	printf("%d of %d files were read wrongly through the ring!\n",
+	       failed, argc - 1);
+	return EXIT_FAILURE;
+    }
+    printf("The token ring agrees with the lexer! (%d files)\n", argc - 1);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,651 @@
+#define _GNU_SOURCE  // for vmsplice and SPLICE_F_GIFT
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "utilities.h"
+#include "compressor.h"
+#include "diagnostics.h"
+#include "token_info.h"
+#include "token_writer.h"
+
+// the size of a page of memory (and of a slot of a pipe)
+#define PAGE_SIZE 4096
+
+// the output waiting to be written, which is one of two buffers,
+// so one can be filled while the compressor holds the other
+// (or, when full buffers are spliced into a pipe, a fresh mapping;
+// see splice_all)
+static _Alignas(PAGE_SIZE) char buffers[2][TOKEN_WRITER_BUFSIZE];
+static char *buffer = buffers[0];
+static size_t used = 0;
+
+// the number of chars of output that have left the buffer
+static size_t flushed = 0;
+
+// How standard output is written
+static enum {
+    output_unknown,  // not decided yet
+    output_write,    // with write(2)
+    output_splice    // by giving a pipe full buffers' pages with vmsplice(2)
+} output_mode = output_unknown;
+
+// may full buffers be spliced into a pipe?
+static bool splice_allowed = true;
+
+// is the output compressed?
+static bool compressed = false;
+
+// Where error messages go, decided at the first flush with errors
+static enum {
+    errors_unknown,
+    errors_to_stdout,  // stderr is the same file as stdout
+    errors_to_stderr
+} errors_mode = errors_unknown;
+
+// has token_writer_flush been registered with atexit?
+static bool registered = false;
+
+// Write the len chars at s to standard output, retrying after
+// partial writes and interrupts
+static void write_all(const char *s, size_t len)
+{
+    while (len > 0) {
+	ssize_t n = write(STDOUT_FILENO, s, len);
+	if (n < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    bail_with_error("Cannot write the lexer's output!");
+	}
+	s += n;
+	len -= (size_t) n;
+    }
+}
+
+// Decide how to write standard output: full buffers are spliced
+// only into a pipe (and only if that is allowed)
+static void choose_output_mode()
+{
+    output_mode = output_write;
+#ifdef SPLICE_F_GIFT
+    struct stat st;
+    if (splice_allowed && sysconf(_SC_PAGESIZE) == PAGE_SIZE
+	&& fstat(STDOUT_FILENO, &st) == 0 && S_ISFIFO(st.st_mode)) {
+	output_mode = output_splice;
+    }
+    errno = 0;
+#endif
+}
+
+// Return a fresh page-aligned buffer of TOKEN_WRITER_BUFSIZE chars
+// (whose pages are in no pipe)
+static char *fresh_buffer()
+{
+    void *p = mmap(NULL, TOKEN_WRITER_BUFSIZE, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+	bail_with_error("Cannot allocate an output buffer!");
+    }
+    return (char *) p;
+}
+
+// Requires: output_mode == output_splice and s is a buffer
+//           returned by fresh_buffer holding len chars
+// Put the len chars at s into the pipe on standard output by giving it
+// their pages, returning only when all of them are in the pipe, and
+// unmap s. The pipe (and any pipe that its reader splices them on to)
+// refers to the pages themselves, so they must never be written again:
+// each full buffer is given away, and the next is a fresh mapping.
+static void splice_all(char *s, size_t len)
+{
+#ifdef SPLICE_F_GIFT
+    struct iovec iov = { s, len };
+    while (iov.iov_len > 0) {
+	ssize_t n = vmsplice(STDOUT_FILENO, &iov, 1, SPLICE_F_GIFT);
+	if (n < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    bail_with_error("Cannot write the lexer's output!");
+	}
+	iov.iov_base = (char *) iov.iov_base + n;
+	iov.iov_len -= (size_t) n;
+    }
+    munmap(s, TOKEN_WRITER_BUFSIZE);
+#endif
+}
+
+// Decide where error messages go: into the output if stderr
+// is the same file as stdout (so their order is seen), else to stderr
+static void choose_errors_mode()
+{
+    struct stat out, err;
+    errors_mode = errors_to_stderr;
+    if (!compressed
+	&& fstat(STDOUT_FILENO, &out) == 0 && fstat(STDERR_FILENO, &err) == 0
+	&& out.st_dev == err.st_dev && out.st_ino == err.st_ino) {
+	errors_mode = errors_to_stdout;
+    }
+    errno = 0;
+}
+
+// the most parts of the output written by one call of writev
+#define MERGE_PARTS 64
+
+// Write the n parts in iov to fd, retrying after
+// partial writes and interrupts
+static void writev_all(int fd, struct iovec *iov, int n)
+{
+    while (n > 0) {
+	ssize_t w = writev(fd, iov, n);
+	if (w < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    bail_with_error("Cannot write the lexer's output!");
+	}
+	while (n > 0 && (size_t) w >= iov->iov_len) {
+	    w -= (ssize_t) iov->iov_len;
+	    iov++;
+	    n--;
+	}
+	if (n > 0) {
+	    iov->iov_base = (char *) iov->iov_base + w;
+	    iov->iov_len -= (size_t) w;
+	}
+    }
+}
+
+// Write the buffer to standard output with each waiting error message
+// at its position in the output, using as few system calls as possible
+static void write_merged()
+{
+    struct iovec iov[MERGE_PARTS];
+    int n = 0;
+    size_t from = 0;  // offset in buffer of the output not yet in iov
+    size_t count = diagnostics_pending();
+    for (size_t i = 0; i < count; i++) {
+	size_t len, position;
+	const char *msg = diagnostics_pending_message(i, &len, &position);
+	size_t at = position - flushed;
+	if (at > from) {
+	    iov[n++] = (struct iovec) { buffer + from, at - from };
+	    from = at;
+	}
+	iov[n++] = (struct iovec) { (void *) msg, len };
+	if (n > MERGE_PARTS - 2) {
+	    writev_all(STDOUT_FILENO, iov, n);
+	    n = 0;
+	}
+    }
+    if (used > from) {
+	iov[n++] = (struct iovec) { buffer + from, used - from };
+    }
+    writev_all(STDOUT_FILENO, iov, n);
+}
+
+// Write all the waiting error messages to stderr at once
+static void write_errors()
+{
+    size_t len;
+    const char *s = diagnostics_pending_text(&len);
+    while (len > 0) {
+	ssize_t n = write(STDERR_FILENO, s, len);
+	if (n < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    return;  // there is nowhere to report this
+	}
+	s += n;
+	len -= (size_t) n;
+    }
+}
+
+// Write all buffered output to standard output
+// (or give it to the compressor), with the error messages
+// reported since the last flush
+void token_writer_flush()
+{
+    fflush(stdout);
+    bool errors = diagnostics_pending() > 0;
+    if (errors && errors_mode == errors_unknown) {
+	choose_errors_mode();
+    }
+    if (compressed) {
+	// (if the compressor has stopped, the output is dropped)
+	if (used > 0 && compressor_running()) {
+	    compressor_submit(buffer, used);
+	    buffer = (buffer == buffers[0]) ? buffers[1] : buffers[0];
+	}
+    } else if (errors && errors_mode == errors_to_stdout) {
+	write_merged();
+    } else {
+	if (output_mode == output_unknown) {
+	    choose_output_mode();
+	}
+	if (output_mode == output_splice
+	    && used > TOKEN_WRITER_BUFSIZE - PAGE_SIZE) {
+	    // a full buffer is given away (but the first, static, buffer
+	    // is copied) and the output goes on in a fresh buffer
+	    if (buffer == buffers[0]) {
+		write_all(buffer, used);
+	    } else {
+		splice_all(buffer, used);
+	    }
+	    buffer = fresh_buffer();
+	} else {
+	    // a partly full buffer is copied, so it can be reused at once
+	    write_all(buffer, used);
+	}
+    }
+    if (errors) {
+	if (errors_mode == errors_to_stderr) {
+	    write_errors();
+	}
+	diagnostics_clear_pending();
+    }
+    flushed += used;
+    used = 0;
+}
+
+// Set whether a full buffer may be given to a pipe on standard output
+// with vmsplice(2) instead of being copied into it with write(2)
+void token_writer_use_splice(bool on)
+{
+    splice_allowed = on;
+}
+
+// Return the number of chars put in the output so far
+size_t token_writer_position()
+{
+    return flushed + used;
+}
+
+// Write the rest of the output and end the compressed stream
+static void finish_compression()
+{
+    if (compressor_running()) {
+	token_writer_flush();
+	compressor_finish();
+    }
+}
+
+// Compress the output with gzip at the given level from now on
+void token_writer_compress(int level)
+{
+    token_writer_flush();
+    compressor_start(STDOUT_FILENO, level);
+    compressed = true;
+    atexit(finish_compression);
+}
+
+// Make sure there is room for len more chars in the buffer
+// (if len is not more than its size)
+static void reserve(size_t len)
+{
+    if (!registered) {
+	atexit(token_writer_flush);
+	registered = true;
+    }
+    if (len > TOKEN_WRITER_BUFSIZE - used) {
+	token_writer_flush();
+    }
+}
+
+// Add the len chars at s to the output
+void token_writer_put(const char *s, size_t len)
+{
+    reserve(len);
+    if (len > TOKEN_WRITER_BUFSIZE && !compressed) {
+	write_all(s, len);
+	flushed += len;
+	return;
+    }
+    while (len > TOKEN_WRITER_BUFSIZE - used) {
+	// the compressor only takes whole buffers
+	size_t n = TOKEN_WRITER_BUFSIZE - used;
+	memcpy(buffer + used, s, n);
+	used += n;
+	token_writer_flush();
+	s += n;
+	len -= n;
+    }
+    memcpy(buffer + used, s, len);
+    used += len;
+}
+
+// Add the null-terminated string s to the output
+void token_writer_puts(const char *s)
+{
+    token_writer_put(s, strlen(s));
+}
+
+// room for the digits and sign of a long
+#define INT_SPACE 24
+
+// numbers below SMALL_INTS are formatted by copying from small_ints
+#define SMALL_INTS 10000
+#define SMALL_WIDTH 4
+
+// the digits of each small number followed by spaces to SMALL_WIDTH chars,
+// filled in the first time a number is formatted
+static char small_ints[SMALL_INTS][SMALL_WIDTH];
+static bool small_ints_ready = false;
+
+// Fill in small_ints
+static void make_small_ints()
+{
+    for (int i = 0; i < SMALL_INTS; i++) {
+	char tmp[SMALL_WIDTH + 1];
+	snprintf(tmp, sizeof(tmp), "%-*d", SMALL_WIDTH, i);
+	memcpy(small_ints[i], tmp, SMALL_WIDTH);
+    }
+    small_ints_ready = true;
+}
+
+// the number of digits of each small number's entry in small_ints
+#define SMALL_LEN(n) ((n) < 10 ? 1 : (n) < 100 ? 2 : (n) < 1000 ? 3 : 4)
+
+// Requires: dest has room for INT_SPACE + width chars
+// Put the decimal form of n at dest, followed by spaces to make it
+// at least width chars wide, and return the number of chars put there
+static size_t format_int(char *dest, long n, size_t width)
+{
+    if (n >= 0 && n < SMALL_INTS && width <= 2 * SMALL_WIDTH) {
+	// the usual case: a token's code or line
+	if (!small_ints_ready) {
+	    make_small_ints();
+	}
+	memset(dest + SMALL_WIDTH, ' ', SMALL_WIDTH);
+	memcpy(dest, small_ints[n], SMALL_WIDTH);
+	size_t len = SMALL_LEN(n);
+	return (len < width) ? width : len;
+    }
+    char digits[INT_SPACE];
+    char *end = digits + INT_SPACE;
+    char *p = end;
+    // work with the magnitude as unsigned, so LONG_MIN works
+    unsigned long mag = (n < 0) ? 0UL - (unsigned long) n : (unsigned long) n;
+    do {
+	*--p = (char) ('0' + mag % 10);
+	mag /= 10;
+    } while (mag != 0);
+    if (n < 0) {
+	*--p = '-';
+    }
+    size_t len = (size_t) (end - p);
+    memcpy(dest, p, len);
+    if (len < width) {
+	memset(dest + len, ' ', width - len);
+	len = width;
+    }
+    return len;
+}
+
+// Add the decimal form of n to the output,
+// followed by spaces to make it at least width chars wide
+void token_writer_put_int(long n, int width)
+{
+    char digits[INT_SPACE];
+    size_t len = format_int(digits, n, 0);
+    token_writer_put(digits, len);
+    while (width > 0 && (size_t) width > len) {
+	token_writer_put(" ", 1);
+	width--;
+    }
+}
+
+// Add the decimal forms of the n numbers in vals to the output,
+// with the char sep between each two
+void token_writer_put_int_list(const unsigned int vals[], size_t n,
+			       char sep)
+{
+    reserve(n * (INT_SPACE + 1));
+    char *p = buffer + used;
+    for (size_t i = 0; i < n; i++) {
+	if (i > 0) {
+	    *p++ = sep;
+	}
+	p += format_int(p, (long) vals[i], 0);
+    }
+    used = (size_t) (p - buffer);
+}
+
+// the most chars in a token line other than the token's text
+#define TOKEN_LINE_SPACE (2 * INT_SPACE + 6 + 4 + 4)
+
+// Add a line for the token with the given code, line and text
+// to the output, in the same format as
+// printf("%-6d %-4d \"%s\"\n", code, line, txt)
+void token_writer_put_token(int code, unsigned int line, const char *txt)
+{
+    size_t len = strlen(txt);
+    if (len + TOKEN_LINE_SPACE > TOKEN_WRITER_BUFSIZE) {
+	// too long to format in the buffer
+	token_writer_put_int(code, 6);
+	token_writer_put(" ", 1);
+	token_writer_put_int((int) line, 4);
+	token_writer_put(" \"", 2);
+	token_writer_put(txt, len);
+	token_writer_put("\"\n", 2);
+	return;
+    }
+    reserve(len + TOKEN_LINE_SPACE);
+    char *p = buffer + used;
+    p += format_int(p, code, 6);
+    *p++ = ' ';
+    p += format_int(p, (int) line, 4);
+    *p++ = ' ';
+    *p++ = '"';
+    memcpy(p, txt, len);
+    p += len;
+    *p++ = '"';
+    *p++ = '\n';
+    used = (size_t) (p - buffer);
+}
+
+// How each byte is written inside a JSON string:
+// NULL to copy it, otherwise the escape sequence that replaces it
+static const char *json_escapes[256];
+
+// the \u00XX escape sequences for control chars
+static char json_control[0x20][7];
+
+// How each byte is written inside a (quoted) CSV field
+static const char *csv_escapes[256] = { ['"'] = "\"\"" };
+
+// Requires: there is room for TOKEN_WRITER_MAX_ESCAPE * len chars at dest
+// Put the len chars at s at dest, replacing each char that has
+// an entry in escapes by that entry, and return the end of what was put;
+// runs of chars that need no escaping are copied at once
+static char *escape_into(char *dest, const char *s, size_t len,
+			 const char *const escapes[256])
+{
+    const char *run = s;
+    const char *end = s + len;
+    for (const char *p = s; p < end; p++) {
+	const char *e = escapes[(unsigned char) *p];
+	if (e != NULL) {
+	    memcpy(dest, run, (size_t) (p - run));
+	    dest += p - run;
+	    size_t elen = strlen(e);
+	    memcpy(dest, e, elen);
+	    dest += elen;
+	    run = p + 1;
+	}
+    }
+    memcpy(dest, run, (size_t) (end - run));
+    return dest + (end - run);
+}
+
+// Add the len chars at s to the output, escaped as by escape_into
+static void put_escaped(const char *s, size_t len,
+			const char *const escapes[256])
+{
+    // escape a piece at a time, so each piece fits in the buffer
+    const size_t piece = TOKEN_WRITER_BUFSIZE / (2 * TOKEN_WRITER_MAX_ESCAPE);
+    while (len > 0) {
+	size_t n = (len < piece) ? len : piece;
+	reserve(TOKEN_WRITER_MAX_ESCAPE * n);
+	used = (size_t) (escape_into(buffer + used, s, n, escapes) - buffer);
+	s += n;
+	len -= n;
+    }
+}
+
+// the range of token codes whose record prefixes are precomputed
+#define FIRST_PREFIX 256
+#define PREFIXES 64
+
+// the most chars in a record's prefix
+#define PREFIX_SPACE 64
+
+// The start of each token's JSON object, up to the value of "line",
+// and of its CSV line, up to the line, for codes from FIRST_PREFIX
+static char json_prefixes[PREFIXES][PREFIX_SPACE];
+static char csv_prefixes[PREFIXES][PREFIX_SPACE];
+static bool prefixes_ready = false;
+
+// Fill in json_escapes, json_prefixes and csv_prefixes
+static void make_record_tables()
+{
+    for (int c = 0; c < 0x20; c++) {
+	snprintf(json_control[c], sizeof(json_control[c]), "\\u%04x", c);
+	json_escapes[c] = json_control[c];
+    }
+    json_escapes['\b'] = "\\b";
+    json_escapes['\t'] = "\\t";
+    json_escapes['\n'] = "\\n";
+    json_escapes['\f'] = "\\f";
+    json_escapes['\r'] = "\\r";
+    json_escapes['"'] = "\\\"";
+    json_escapes['\\'] = "\\\\";
+    for (int i = 0; i < PREFIXES; i++) {
+	int code = FIRST_PREFIX + i;
+	snprintf(json_prefixes[i], PREFIX_SPACE,
+		 "{\"code\":%d,\"name\":\"%s\",\"line\":",
+		 code, token_name(code));
+	snprintf(csv_prefixes[i], PREFIX_SPACE, "%d,%s,", code, token_name(code));
+    }
+    prefixes_ready = true;
+}
+
+// Requires: there is room for PREFIX_SPACE + INT_SPACE chars at dest
+// Put the prefix for the token code at dest from the given table
+// (or formatted with fmt if it is not there),
+// and return the end of what was put
+static char *prefix_into(char *dest, int code,
+			 char table[PREFIXES][PREFIX_SPACE], const char *fmt)
+{
+    if (!prefixes_ready) {
+	make_record_tables();
+    }
+    if (code >= FIRST_PREFIX && code < FIRST_PREFIX + PREFIXES) {
+	const char *prefix = table[code - FIRST_PREFIX];
+	size_t len = strlen(prefix);
+	memcpy(dest, prefix, len);
+	return dest + len;
+    }
+    return dest + sprintf(dest, fmt, code, token_name(code));
+}
+
+// Put the len chars at s at dest, escaped for use in a JSON string,
+// and return the end of what was put
+char *token_writer_json_escape(char *dest, const char *s, size_t len)
+{
+    if (!prefixes_ready) {
+	make_record_tables();
+    }
+    return escape_into(dest, s, len, json_escapes);
+}
+
+// the most chars in a JSON or CSV line other than the token's text
+#define RECORD_SPACE (PREFIX_SPACE + 3 * INT_SPACE + 32)
+
+// Requires: there is room for RECORD_SPACE chars in the buffer,
+//           and then for TOKEN_WRITER_MAX_ESCAPE * len more
+// Put the text txt (of length len), escaped with escapes,
+// and the string tail after it, at the end of the buffer
+static void finish_record(char *p, const char *txt, size_t len,
+			  const char *const escapes[256], const char *tail)
+{
+    used = (size_t) (p - buffer);
+    if (TOKEN_WRITER_MAX_ESCAPE * len + strlen(tail)
+	> TOKEN_WRITER_BUFSIZE - used) {
+	put_escaped(txt, len, escapes);  // a very long text
+	token_writer_puts(tail);
+	return;
+    }
+    p = escape_into(p, txt, len, escapes);
+    size_t tlen = strlen(tail);
+    memcpy(p, tail, tlen);
+    used = (size_t) (p + tlen - buffer);
+}
+
+// Add a line with a JSON object describing the token tok,
+// whose text is txt, to the output
+void token_writer_put_json_token(const lexer_token *tok, const char *txt)
+{
+    size_t len = strlen(txt);
+    reserve(RECORD_SPACE + TOKEN_WRITER_MAX_ESCAPE * len);
+    char *p = prefix_into(buffer + used, tok->code, json_prefixes,
+			  "{\"code\":%d,\"name\":\"%s\",\"line\":");
+    p += format_int(p, (long) tok->line, 0);
+    memcpy(p, ",\"offset\":", 10);
+    p += 10;
+    p += format_int(p, (long) tok->offset, 0);
+    memcpy(p, ",\"text\":\"", 9);
+    p += 9;
+    finish_record(p, txt, len, json_escapes, "\"}\n");
+}
+
+// Add the header line of the CSV output
+void token_writer_put_csv_header()
+{
+    token_writer_puts("code,name,line,offset,text\n");
+}
+
+// Add a line of CSV describing the token tok, whose text is txt,
+// to the output
+void token_writer_put_csv_token(const lexer_token *tok, const char *txt)
+{
+    size_t len = strlen(txt);
+    reserve(RECORD_SPACE + TOKEN_WRITER_MAX_ESCAPE * len);
+    char *p = prefix_into(buffer + used, tok->code, csv_prefixes, "%d,%s,");
+    p += format_int(p, (long) tok->line, 0);
+    *p++ = ',';
+    p += format_int(p, (long) tok->offset, 0);
+    *p++ = ',';
+    *p++ = '"';
+    finish_record(p, txt, len, csv_escapes, "\"\n");
+}
+
+// Print all the remaining tokens from the lexer on standard output
+// as JSON Lines (one JSON object per token)
+void token_writer_output_jsonl()
+{
+    lexer_token tok;
+    while (lexer_next_token(&tok)) {
+	token_writer_put_json_token(&tok, lexer_token_text());
+    }
+    token_writer_flush();
+}
+
+// Print all the remaining tokens from the lexer on standard output
+// as CSV, with a header line
+void token_writer_output_csv()
+{
+    token_writer_put_csv_header();
+    lexer_token tok;
+    while (lexer_next_token(&tok)) {
+	token_writer_put_csv_token(&tok, lexer_token_text());
+    }
+    token_writer_flush();
+}
@@ -0,0 +1,95 @@
+#ifndef _TOKEN_WRITER_H
+#define _TOKEN_WRITER_H
+#include <stddef.h>
+#include "lexer.h"
+
+// The size of the token writer's output buffer, in bytes
+#define TOKEN_WRITER_BUFSIZE (1 << 16)
+
+// The most chars that replace a single char when it is escaped
+#define TOKEN_WRITER_MAX_ESCAPE 6
+
+// The token writer buffers the lexer's text output to standard output
+// and writes it with write(2) a buffer full at a time,
+// formatting numbers itself instead of using printf.
+// Its output is written when the buffer fills, by token_writer_flush,
+// and when the program exits.
+
+// Add the len chars at s to the output
+extern void token_writer_put(const char *s, size_t len);
+
+// Requires: s != NULL
+// Add the null-terminated string s to the output
+extern void token_writer_puts(const char *s);
+
+// Add the decimal form of n to the output,
+// followed by spaces to make it at least width chars wide
+// (as printf's %-*d does)
+extern void token_writer_put_int(long n, int width);
+
+// Requires: vals has n elements and n <= TOKEN_WRITER_BUFSIZE / 32
+// Add the decimal forms of the n numbers in vals to the output,
+// with the char sep between each two
+extern void token_writer_put_int_list(const unsigned int vals[], size_t n,
+				      char sep);
+
+// Requires: txt != NULL
+// Add a line for the token with the given code, line and text
+// to the output, in the same format as
+// printf("%-6d %-4d \"%s\"\n", code, line, txt)
+extern void token_writer_put_token(int code, unsigned int line,
+				   const char *txt);
+
+// Requires: dest has room for TOKEN_WRITER_MAX_ESCAPE * len chars
+// Put the len chars at s at dest, escaped for use in a JSON string,
+// and return the end of what was put
+extern char *token_writer_json_escape(char *dest, const char *s, size_t len);
+
+// Requires: tok != NULL and txt != NULL
+// Add a line with a JSON object describing the token tok,
+// whose text is txt, to the output; the object has the members
+// code, name (from pl0.tab.h), line, offset and text
+extern void token_writer_put_json_token(const lexer_token *tok,
+					const char *txt);
+
+// Add the header line of the CSV output
+extern void token_writer_put_csv_header();
+
+// Requires: tok != NULL and txt != NULL
+// Add a line of CSV describing the token tok, whose text is txt,
+// to the output; its fields are as in the header line,
+// with the text always quoted
+extern void token_writer_put_csv_token(const lexer_token *tok,
+				       const char *txt);
+
+// Requires: the lexer has been initialized
+// Print all the remaining tokens from the lexer on standard output
+// as JSON Lines (one JSON object per token)
+extern void token_writer_output_jsonl();
+
+// Requires: the lexer has been initialized
+// Print all the remaining tokens from the lexer on standard output
+// as CSV, with a header line
+extern void token_writer_output_csv();
+
+// Requires: COMPRESSOR_MIN_LEVEL <= level <= COMPRESSOR_MAX_LEVEL
+// From now on, compress the output (as a gzip stream) at the given level
+// on a separate thread, which is given each buffer full as it fills;
+// the stream is ended when the program exits
+extern void token_writer_compress(int level);
+
+// Set whether a full buffer may be given to a pipe on standard output
+// with vmsplice(2) (the default) instead of being copied into it
+// with write(2); this only has an effect before the first flush
+extern void token_writer_use_splice(bool on);
+
+// Return the number of chars put in the output so far
+// (its position, at which error messages are merged into it)
+extern size_t token_writer_position();
+
+// Write all buffered output to standard output (or give it to
+// the compressor), first flushing stdout, so output stays in order,
+// with the error messages reported since the last flush
+extern void token_writer_flush();
+
+#endif
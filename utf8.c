@@ -0,0 +1,226 @@
+#include <string.h>
+#include <stdint.h>
+#include "utf8.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// bit mask with the high bit of every byte in a 64-bit word set
+#define HIGH_BITS 0x8080808080808080ULL
+
+#ifdef __SSE2__
+// Return the number of leading bytes in s[0..n) whose high bit equals hibit,
+// examining 16 bytes at a time
+static size_t vector_span(const char *s, size_t n, int hibit)
+{
+    size_t i = 0;
+    while (i + 16 <= n) {
+	__m128i v = _mm_loadu_si128((const __m128i *) (s + i));
+	// bit k of mask is the high bit of byte k
+	unsigned int mask = (unsigned int) _mm_movemask_epi8(v);
+	if (hibit) {
+	    mask = ~mask & 0xFFFF;
+	}
+	if (mask != 0) {
+	    return i + __builtin_ctz(mask);
+	}
+	i += 16;
+    }
+    return i;
+}
+#else
+// Return the number of leading bytes in s[0..n) whose high bit equals hibit,
+// examining 8 bytes at a time
+static size_t vector_span(const char *s, size_t n, int hibit)
+{
+    size_t i = 0;
+    while (i + 8 <= n) {
+	uint64_t w;
+	memcpy(&w, s + i, sizeof(w));
+	uint64_t differ = (hibit ? ~w : w) & HIGH_BITS;
+	if (differ != 0) {
+	    break;
+	}
+	i += 8;
+    }
+    return i;
+}
+#endif
+
+// Return the length of the longest prefix of s[0..n)
+// that consists only of ASCII bytes (bytes below 0x80)
+size_t utf8_ascii_span(const char *s, size_t n)
+{
+    size_t i = vector_span(s, n, 0);
+    while (i < n && (unsigned char) s[i] < 0x80) {
+	i++;
+    }
+    return i;
+}
+
+// Return the length of the longest prefix of s[0..n)
+// that consists only of non-ASCII bytes (bytes of 0x80 and above)
+size_t utf8_nonascii_span(const char *s, size_t n)
+{
+    size_t i = vector_span(s, n, 1);
+    while (i < n && (unsigned char) s[i] >= 0x80) {
+	i++;
+    }
+    return i;
+}
+
+// Initialize d to start decoding a new byte sequence
+void utf8_decoder_init(utf8_decoder *d)
+{
+    d->code_point = 0;
+    d->need = 0;
+    d->lo = 0x80;
+    d->hi = 0xBF;
+    d->first = 0;
+    d->count = 0;
+    d->bytes = 0;
+    d->valid = true;
+}
+
+// Record that the code point cp was completely decoded by d
+static void decoder_emit(utf8_decoder *d, unsigned int cp)
+{
+    if (d->count == 0) {
+	d->first = cp;
+    }
+    d->count++;
+}
+
+// Start decoding a sequence with the lead byte b
+static void decoder_lead(utf8_decoder *d, unsigned char b)
+{
+    d->lo = 0x80;
+    d->hi = 0xBF;
+    if (b < 0x80) {
+	decoder_emit(d, b);
+    } else if (b >= 0xC2 && b <= 0xDF) {
+	d->need = 1;
+	d->code_point = b & 0x1F;
+    } else if (b >= 0xE0 && b <= 0xEF) {
+	// reject overlong forms and UTF-16 surrogates
+	d->need = 2;
+	d->code_point = b & 0x0F;
+	if (b == 0xE0) {
+	    d->lo = 0xA0;
+	} else if (b == 0xED) {
+	    d->hi = 0x9F;
+	}
+    } else if (b >= 0xF0 && b <= 0xF4) {
+	// reject overlong forms and code points above U+10FFFF
+	d->need = 3;
+	d->code_point = b & 0x07;
+	if (b == 0xF0) {
+	    d->lo = 0x90;
+	} else if (b == 0xF4) {
+	    d->hi = 0x8F;
+	}
+    } else {
+	d->valid = false;
+    }
+}
+
+// Decode the bytes s[0..n), continuing from the state in d
+void utf8_decoder_feed(utf8_decoder *d, const char *s, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+	unsigned char b = (unsigned char) s[i];
+	if (d->need == 0) {
+	    decoder_lead(d, b);
+	} else if (b < d->lo || b > d->hi) {
+	    // a truncated sequence; b may start the next one
+	    d->valid = false;
+	    d->need = 0;
+	    decoder_lead(d, b);
+	} else {
+	    d->code_point = (d->code_point << 6) | (b & 0x3F);
+	    d->lo = 0x80;
+	    d->hi = 0xBF;
+	    if (--d->need == 0) {
+		decoder_emit(d, d->code_point);
+	    }
+	}
+    }
+    d->bytes += n;
+}
+
+// Finish decoding, noting a truncated final sequence as invalid,
+// and return whether the whole sequence fed to d was well-formed
+bool utf8_decoder_finish(utf8_decoder *d)
+{
+    if (d->need != 0) {
+	d->valid = false;
+	d->need = 0;
+    }
+    return d->valid;
+}
+
+// Return the length of the well-formed UTF-8 sequence that s[0..n)
+// starts with, setting *cp to its code point;
+// but return 0 if s[0..n) does not start with one
+size_t utf8_decode(const char *s, size_t n, unsigned int *cp)
+{
+    utf8_decoder d;
+    utf8_decoder_init(&d);
+    for (size_t i = 0; i < n && i < UTF8_MAX_BYTES; i++) {
+	utf8_decoder_feed(&d, s + i, 1);
+	if (!d.valid) {
+	    return 0;
+	} else if (d.count > 0) {
+	    *cp = d.first;
+	    return i + 1;
+	}
+    }
+    return 0;
+}
+
+// Return whether s[0..n) is well-formed UTF-8
+bool utf8_valid(const char *s, size_t n)
+{
+    utf8_decoder d;
+    utf8_decoder_init(&d);
+    size_t i = 0;
+    while (i < n) {
+	// only the non-ASCII stretches need to be decoded
+	i += utf8_ascii_span(s + i, n - i);
+	size_t len = utf8_nonascii_span(s + i, n - i);
+	utf8_decoder_feed(&d, s + i, len);
+	if (!utf8_decoder_finish(&d)) {
+	    return false;
+	}
+	i += len;
+    }
+    return true;
+}
+
+// Write the UTF-8 encoding of cp into buf, followed by a null char,
+// and return the number of bytes written (not counting the null char)
+int utf8_encode(unsigned int cp, char *buf)
+{
+    int len;
+    if (cp < 0x80) {
+	buf[0] = (char) cp;
+	len = 1;
+    } else if (cp < 0x800) {
+	buf[0] = (char) (0xC0 | (cp >> 6));
+	buf[1] = (char) (0x80 | (cp & 0x3F));
+	len = 2;
+    } else if (cp < 0x10000) {
+	buf[0] = (char) (0xE0 | (cp >> 12));
+	buf[1] = (char) (0x80 | ((cp >> 6) & 0x3F));
+	buf[2] = (char) (0x80 | (cp & 0x3F));
+	len = 3;
+    } else {
+	buf[0] = (char) (0xF0 | (cp >> 18));
+	buf[1] = (char) (0x80 | ((cp >> 12) & 0x3F));
+	buf[2] = (char) (0x80 | ((cp >> 6) & 0x3F));
+	buf[3] = (char) (0x80 | (cp & 0x3F));
+	len = 4;
+    }
+    buf[len] = '\0';
+    return len;
+}
@@ -0,0 +1,59 @@
+#ifndef _UTF8_H
+#define _UTF8_H
+#include <stddef.h>
+#include <stdbool.h>
+
+// The largest number of bytes in the UTF-8 encoding of a code point
+#define UTF8_MAX_BYTES 4
+
+// State of an incremental UTF-8 decoder,
+// which can be fed a byte sequence in several pieces
+typedef struct {
+    unsigned int code_point; // code point being decoded
+    unsigned int need;       // continuation bytes still needed
+    unsigned char lo, hi;    // allowed range of the next continuation byte
+    unsigned int first;      // first code point decoded (if count > 0)
+    unsigned int count;      // number of complete code points decoded
+    size_t bytes;            // number of bytes fed to the decoder
+    bool valid;              // is everything fed so far well-formed?
+} utf8_decoder;
+
+// Requires: s != NULL
+// Return the length of the longest prefix of s[0..n)
+// that consists only of ASCII bytes (bytes below 0x80)
+extern size_t utf8_ascii_span(const char *s, size_t n);
+
+// Requires: s != NULL
+// Return the length of the longest prefix of s[0..n)
+// that consists only of non-ASCII bytes (bytes of 0x80 and above)
+extern size_t utf8_nonascii_span(const char *s, size_t n);
+
+// Requires: d != NULL
+// Initialize d to start decoding a new byte sequence
+extern void utf8_decoder_init(utf8_decoder *d);
+
+// Requires: d != NULL and d has been initialized
+// Decode the bytes s[0..n), continuing from the state in d
+extern void utf8_decoder_feed(utf8_decoder *d, const char *s, size_t n);
+
+// Requires: d != NULL and d has been initialized
+// Finish decoding, noting a truncated final sequence as invalid,
+// and return whether the whole sequence fed to d was well-formed
+extern bool utf8_decoder_finish(utf8_decoder *d);
+
+// Requires: s != NULL and cp != NULL
+// Return the length of the well-formed UTF-8 sequence that s[0..n)
+// starts with, setting *cp to its code point;
+// but return 0 if s[0..n) does not start with one
+extern size_t utf8_decode(const char *s, size_t n, unsigned int *cp);
+
+// Requires: s != NULL
+// Return whether s[0..n) is well-formed UTF-8
+extern bool utf8_valid(const char *s, size_t n);
+
+// Requires: buf has room for UTF8_MAX_BYTES+1 chars
+// Write the UTF-8 encoding of cp into buf, followed by a null char,
+// and return the number of bytes written (not counting the null char)
+extern int utf8_encode(unsigned int cp, char *buf);
+
+#endif
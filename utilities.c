@@ -2,30 +2,70 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include "utilities.h"
 
-static void vbail_with_error(const char* fmt, va_list args);
+static void vfail_with_error(error_status *status, const char *fmt,
+			     va_list args);
 
 // Format a string error message and print it followed by a newline on stderr
 // using perror (for an OS error, if the errno is not 0)
 // then exit with a failure code, so a call to this does not return.
 void bail_with_error(const char *fmt, ...){
     fflush(stdout); // flush so output comes after what has happened already
+    error_status status;
     va_list(args);
     va_start(args, fmt);
-    vbail_with_error(fmt, args);
+    vfail_with_error(&status, fmt, args);
+    va_end(args);
+    exit_with_error(&status);
 }
 
-// The variadic version of bail_with_error
-static void vbail_with_error(const char* fmt, va_list args){
-    extern int errno;
-    char buff[2048];
-    vsprintf(buff, fmt, args);
-    if (errno != 0){
-	perror(buff);
-    } else {
-	fprintf(stderr, "%s\n", buff);
+// Note that nothing has failed in *status
+void clear_error(error_status *status)
+{
+    status->failed = false;
+    status->err = 0;
+    status->message[0] = '\0';
+}
+
+// Record in *status the error message formatted from fmt
+// (followed, for an OS error, by the text of errno, as perror does)
+// and return false
+bool fail_with_error(error_status *status, const char *fmt, ...)
+{
+    va_list(args);
+    va_start(args, fmt);
+    vfail_with_error(status, fmt, args);
+    va_end(args);
+    return false;
+}
+
+// The variadic version of fail_with_error
+static void vfail_with_error(error_status *status, const char *fmt,
+			     va_list args)
+{
+    int err = errno;
+    int n = vsnprintf(status->message, ERROR_MESSAGE_SIZE, fmt, args);
+    if (err != 0 && n >= 0 && n < ERROR_MESSAGE_SIZE) {
+	snprintf(status->message + n, (size_t) (ERROR_MESSAGE_SIZE - n),
+		 ": %s", strerror(err));
     }
+    status->failed = true;
+    status->err = err;
+}
+
+// Print the error message in *status, followed by a newline, on stderr
+void print_error(const error_status *status)
+{
+    fprintf(stderr, "%s\n", status->message);
+}
+
+// Print the error message in *status (as print_error does)
+// then exit with a failure code, so a call to this does not return.
+void exit_with_error(const error_status *status)
+{
+    print_error(status);
     exit(EXIT_FAILURE);
 }
@@ -1,8 +1,41 @@
 /* $Id: utilities.h,v 1.3 2023/10/06 10:20:09 leavens Exp $ */
 #ifndef _UTILITIES_H
 #define _UTILITIES_H
+#include <stdbool.h>
 
 // Format a string error message and print it using perror (for an OS error)
 // then exit with a failure code, so a call to this does not return.
 extern void bail_with_error(const char *fmt, ...);
+
+// The most chars in an error message
+#define ERROR_MESSAGE_SIZE 2048
+
+// A failure that stops work on one input (such as a file that
+// cannot be opened) but need not end the program;
+// functions that can fail this way fill one in and return false,
+// leaving it to their caller to report the error and go on
+typedef struct {
+    bool failed;
+    int err;  // the errno value of an OS error (0 if none)
+    char message[ERROR_MESSAGE_SIZE];  // as bail_with_error prints it
+} error_status;
+
+// Requires: status != NULL
+// Note that nothing has failed in *status
+extern void clear_error(error_status *status);
+
+// Requires: status != NULL
+// Record in *status the error message formatted from fmt
+// (followed, for an OS error, by the text of errno, as perror does)
+// and return false
+extern bool fail_with_error(error_status *status, const char *fmt, ...);
+
+// Requires: status != NULL and status->failed
+// Print the error message in *status, followed by a newline, on stderr
+extern void print_error(const error_status *status);
+
+// Requires: status != NULL and status->failed
+// Print the error message in *status (as print_error does)
+// then exit with a failure code, so a call to this does not return.
+extern void exit_with_error(const error_status *status);
 #endif